@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <iostream>
@@ -5,8 +6,11 @@
 
 #include <FlatMesher/FloorPlan.h>
 #include <FlatMesher/FlatMesh.h>
-#include <FlatMesher/BemgenMeshFormatter.h>
-#include <FlatMesher/VTUMeshFormatter.h>
+#include <FlatMesher/IndexTriangle.h>
+#include <FlatMesher/MeshCache.h>
+#include <FlatMesher/BemgenMeshSink.h>
+#include <FlatMesher/FMeshSink.h>
+#include <FlatMesher/VTUMeshSink.h>
 
 enum class RunMode {
   ERROR = -1,
@@ -18,13 +22,22 @@ enum class RunMode {
 enum class OutputFormat {
   ERROR = -1,
   BEMGEN,
-  VTU
+  VTU,
+  VTU_BASE64,
+  VTU_BINARY,
+  VTU_BASE64_ZLIB,
+  VTU_BINARY_ZLIB,
+  FMESH
 };
 
 struct program_input_t {
   RunMode mode;
-  std::string in_file, out_file;
+  std::string in_file, out_file, cache_dir;
   OutputFormat out_format;
+  size_t memory_mb;
+  size_t grading_levels;
+  size_t cache_mb;
+  size_t threads;
 };
 
 const char* DEFAULT_OUTPUT_FILE_NAME = "tmp.vtu";
@@ -35,7 +48,10 @@ inline bool streq(const char* str1, const char* str2) {
 
 void printUsage(char* program_name) {
   std::cout << "Usage: " << program_name
-    << " {<input_file> [{-f | --format} {vtu | bemgen}] [{-o | --output} <output_file>] | {-h | --help}}\n";
+    << " {<input_file> [{-f | --format} {vtu | vtu-base64 | vtu-binary | vtu-base64-zlib | vtu-binary-zlib | bemgen | fmesh}]"
+    << " [{-o | --output} <output_file>]"
+    << " [{-m | --memory} <megabytes>] [{-g | --grading} <levels>]"
+    << " [{-c | --cache} <directory>] [--cache-size <megabytes>] [{-t | --threads} <count>] | {-h | --help}}\n";
 }
 
 program_input_t processArgs(int argc, char* argv []);
@@ -54,16 +70,21 @@ int main(int argc, char *argv []) {
   case RunMode::DEFAULT:
   case RunMode::HELP:
     printUsage(argv[0]);
+    return 0;
   default:
     return 0;
   }
 }
 
 program_input_t processArgs(int argc, char* argv []) {
-  // flatmesher {input.flat [-f {vtu|bemgen}] [-o output.flat] | -h}
+  // flatmesher {input.flat [-f {vtu|vtu-base64|vtu-binary|vtu-base64-zlib|vtu-binary-zlib|bemgen|fmesh}] [-o output.flat] [-m megabytes] [-g levels] [-c directory] [--cache-size megabytes] [-t count] | -h}
   program_input_t info;
   info.out_file = DEFAULT_OUTPUT_FILE_NAME;
   info.out_format = OutputFormat::VTU;
+  info.memory_mb = 0;
+  info.grading_levels = 0;
+  info.cache_mb = flat::MeshCache::DEFAULT_MAX_SIZE / (1024 * 1024);
+  info.threads = 0; // As many as OpenMP uses
 
   if (argc < 2)
     info.mode = RunMode::DEFAULT;
@@ -79,12 +100,66 @@ program_input_t processArgs(int argc, char* argv []) {
           info.out_format = OutputFormat::BEMGEN;
         else if (streq(argv[i + 1], "vtu"))
           info.out_format = OutputFormat::VTU;
+        else if (streq(argv[i + 1], "vtu-base64"))
+          info.out_format = OutputFormat::VTU_BASE64;
+        else if (streq(argv[i + 1], "vtu-binary"))
+          info.out_format = OutputFormat::VTU_BINARY;
+        else if (streq(argv[i + 1], "vtu-base64-zlib"))
+          info.out_format = OutputFormat::VTU_BASE64_ZLIB;
+        else if (streq(argv[i + 1], "vtu-binary-zlib"))
+          info.out_format = OutputFormat::VTU_BINARY_ZLIB;
+        else if (streq(argv[i + 1], "fmesh"))
+          info.out_format = OutputFormat::FMESH;
         else
           info.out_format = OutputFormat::ERROR;
       }
       else if (streq(argv[i], "-o") || streq(argv[i], "--output")) {
         info.out_file = argv[i + 1];
       }
+      else if (streq(argv[i], "-m") || streq(argv[i], "--memory")) {
+        char* end;
+        info.memory_mb = std::strtoul(argv[i + 1], &end, 10);
+
+        if (*end != '\0' || info.memory_mb == 0) {
+          info.mode = RunMode::ERROR;
+          break;
+        }
+      }
+      else if (streq(argv[i], "-g") || streq(argv[i], "--grading")) {
+        char* end;
+        info.grading_levels = std::strtoul(argv[i + 1], &end, 10);
+
+        if (*end != '\0' || argv[i + 1][0] == '\0') {
+          info.mode = RunMode::ERROR;
+          break;
+        }
+        if (info.grading_levels > flat::FlatMesh::MAX_GRADING_LEVELS) {
+          std::cerr << "There can't be more than " << flat::FlatMesh::MAX_GRADING_LEVELS << " grading levels.\n";
+          info.mode = RunMode::ERROR;
+          break;
+        }
+      }
+      else if (streq(argv[i], "-c") || streq(argv[i], "--cache")) {
+        info.cache_dir = argv[i + 1];
+      }
+      else if (streq(argv[i], "--cache-size")) {
+        char* end;
+        info.cache_mb = std::strtoul(argv[i + 1], &end, 10);
+
+        if (*end != '\0' || info.cache_mb == 0) {
+          info.mode = RunMode::ERROR;
+          break;
+        }
+      }
+      else if (streq(argv[i], "-t") || streq(argv[i], "--threads")) {
+        char* end;
+        info.threads = std::strtoul(argv[i + 1], &end, 10);
+
+        if (*end != '\0' || info.threads == 0) {
+          info.mode = RunMode::ERROR;
+          break;
+        }
+      }
       else {
         info.mode = RunMode::ERROR;
         break;
@@ -102,7 +177,18 @@ bool generate(program_input_t input) {
     return false;
   }
 
-  std::ofstream out(input.out_file.c_str());
+  if ((input.out_format == OutputFormat::VTU_BASE64_ZLIB || input.out_format == OutputFormat::VTU_BINARY_ZLIB) &&
+      !flat::VTUMeshSink::compressionAvailable()) {
+    std::cerr << "Compressed output is not available, because FlatMesher was built without zlib.\n";
+    return false;
+  }
+
+  // Binary VTU and fmesh files must not have their line endings translated
+  std::ios::openmode mode = std::ios::out;
+  if (input.out_format != OutputFormat::BEMGEN && input.out_format != OutputFormat::VTU)
+    mode |= std::ios::binary;
+
+  std::ofstream out(input.out_file.c_str(), mode);
   if (!out.is_open()) {
     std::cerr << "Output file \"" << input.out_file << "\" could not be opened.\n";
     return false;
@@ -122,25 +208,69 @@ bool generate(program_input_t input) {
   }
 
   flat::FlatMesh mesh;
-  flat::MeshFormatter* fmt = nullptr;
+  flat::MeshSink* sink = nullptr;
+
+  mesh.setMemoryBudget(input.memory_mb * 1024 * 1024);
+  mesh.setGradingLevels(input.grading_levels);
 
   switch (input.out_format) {
   case OutputFormat::ERROR:
     return false;
   case OutputFormat::BEMGEN:
-    fmt = new flat::BemgenMeshFormatter;
+    sink = new flat::BemgenMeshSink(out);
     break;
   case OutputFormat::VTU:
-    fmt = new flat::VTUMeshFormatter;
+    sink = new flat::VTUMeshSink(out);
+    break;
+  case OutputFormat::VTU_BASE64:
+    sink = new flat::VTUMeshSink(out, flat::VTUEncoding::BASE64);
+    break;
+  case OutputFormat::VTU_BINARY:
+    sink = new flat::VTUMeshSink(out, flat::VTUEncoding::APPENDED);
+    break;
+  case OutputFormat::VTU_BASE64_ZLIB:
+    sink = new flat::VTUMeshSink(out, flat::VTUEncoding::BASE64, true);
+    break;
+  case OutputFormat::VTU_BINARY_ZLIB:
+    sink = new flat::VTUMeshSink(out, flat::VTUEncoding::APPENDED, true);
+    break;
+  case OutputFormat::FMESH:
+    sink = new flat::FMeshSink(out);
     break;
   }
 
-  mesh.createFromPlan(&plan);
-  fmt->writeMesh(out, mesh);
+  sink->setThreads(input.threads);
 
-  delete fmt;
+  // The mesh is written as it's generated, so it's never stored in memory.
+  // When a cache is used, meshes created before are read from it instead
+  flat::MeshCache::Result result = flat::MeshCache::Result::CREATED;
+  if (input.cache_dir.empty())
+    mesh.createFromPlan(&plan, *sink);
+  else {
+    flat::MeshCache cache(input.cache_dir, uint64_t(input.cache_mb) * 1024 * 1024);
+    result = cache.createFromPlan(&plan, mesh, *sink);
+  }
+
+  delete sink;
   out.close();
 
+  if (result == flat::MeshCache::Result::FAILED) {
+    std::cerr << "The cached mesh could not be read, and it has been removed from the cache. Run again to create it.\n";
+    return false;
+  }
+
+  if (result == flat::MeshCache::Result::CREATED && mesh.empty()) {
+    std::cerr << "The mesh has too many nodes. The " << sizeof(flat::index_t) * 8
+              << "-bit indices of its triangles can't address nodes past " << flat::IndexTriangle::MAX_INDEX
+              << ". Use a larger triangle size, or build FlatMesher with -DFLATMESHER_WIDE_INDICES=ON.\n";
+    return false;
+  }
+
+  if (!out) {
+    std::cerr << "Output file \"" << input.out_file << "\" could not be written.\n";
+    return false;
+  }
+
   std::cout << "Mesh generated successfully at \"" << input.out_file << "\".\n";
   return true;
 }
@@ -45,8 +45,17 @@ HEADERS  += include/MainWindow.h \
 
 QMAKE_CXXFLAGS += -fopenmp
 
+# Must match the FLATMESHER_WIDE_INDICES option the library was built with:
+#   qmake CONFIG+=flatmesher_wide_indices
+flatmesher_wide_indices: DEFINES += FLATMESHER_WIDE_INDICES
+
 LIBS += -fopenmp -L"$$_PRO_FILE_PWD_/../library/build/" -L"$$_PRO_FILE_PWD_/libs/" -lFlatMesher
 
+# The library is built with FLATMESHER_ZLIB, and needs zlib, when CMake finds
+# it. Here pkg-config is asked instead; use CONFIG+=flatmesher_no_zlib if the
+# library was built without zlib anyway
+!flatmesher_no_zlib:packagesExist(zlib): LIBS += -lz
+
 INCLUDEPATH += include \
     ../library/include
 
@@ -7,11 +7,18 @@
 #include <QString>
 
 namespace flat {
-class FlatMesh;
 class FloorPlan;
-class MeshFormatter;
+class MeshCache;
 }
 
+enum class MeshFormat {
+  Bemgen,
+  VTU,
+  VTUBinary,
+  VTUCompressed,
+  FMesh
+};
+
 class FileManager {
 public:
   static QList<QPair<QString, flat::FloorPlan>> openFlats();
@@ -20,9 +27,14 @@ public:
   static QString saveFlat(const flat::FloorPlan &plan);
   static bool saveFlat(const flat::FloorPlan& plan, const QString& fileName);
 
-  static QString saveMesh(const flat::FlatMesh &plan);
-  static bool saveMesh(const flat::FlatMesh& mesh, const QString& fileName,
-                       const flat::MeshFormatter& fmt);
+  static QString saveMesh(const flat::FloorPlan &plan);
+  // 'tooLarge' is set if the export failed because the mesh has more nodes
+  // than the indices of this build can address
+  static bool saveMesh(const flat::FloorPlan& plan, const QString& fileName, MeshFormat format,
+                       bool *tooLarge = nullptr);
+
+  // Cache of the meshes exported, kept in the cache directory of the user
+  static const flat::MeshCache& meshCache();
 
 // Avoid the creation of instances of this class by making the constructor private
 private:
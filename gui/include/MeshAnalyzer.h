@@ -7,9 +7,7 @@ namespace Ui {
 class MeshAnalyzer;
 }
 
-namespace flat {
-class FloorPlan;
-}
+class MeshEditor;
 
 class MeshAnalyzer: public QDialog {
   Q_OBJECT
@@ -18,7 +16,9 @@ public:
   explicit MeshAnalyzer(QWidget *parent = 0);
   ~MeshAnalyzer();
 
-  void processMesh(const flat::FloorPlan& plan);
+  // Checks the plan of 'editor' and, if it's valid, shows the size of its
+  // mesh, which the editor updates from the previous one
+  void processMesh(const MeshEditor *editor);
 
 public slots:
   void setProcessingCompleted(int percentage);
@@ -1,11 +1,14 @@
 #ifndef MESHEDITOR_H
 #define MESHEDITOR_H
 
+#include <QList>
 #include <QString>
 #include <QWidget>
 
-#include <FlatMesher/FlatMesh.h>
+#include <vector>
+
 #include <FlatMesher/FloorPlan.h>
+#include <FlatMesher/IncrementalFlatMesh.h>
 #include <FlatMesher/Line2.h>
 #include <FlatMesher/Point2.h>
 #include <FlatMesher/Rectangle.h>
@@ -17,6 +20,7 @@ class GraphicsLineItem;
 class GraphicsPointItem;
 class GridGraphicsView;
 class QGraphicsItem;
+class QGraphicsPolygonItem;
 class QGraphicsScene;
 class QUndoStack;
 
@@ -29,8 +33,12 @@ public:
   explicit MeshEditor(QWidget *parent = 0);
   MeshEditor(const QString& fileName, const flat::FloorPlan& plan, QWidget *parent = 0);
 
+  // Plan being edited. Its holes are kept as they were loaded, because only
+  // the outer boundary can be edited
   flat::FloorPlan plan() const;
-  flat::FlatMesh mesh() const;
+  // Mesh of the current plan. Only the parts affected by the changes made
+  // since the last call are created again
+  const flat::IncrementalFlatMesh& mesh() const;
   flat::Rectangle viewport() const;
   int pointCount() const;
 
@@ -120,6 +128,10 @@ private:
   GraphicsPointItem* mFirstPoint;
   int mPointsAmount;
 
+  // Holes of the plan, which are shown but can't be edited
+  std::vector<std::vector<flat::Point2>> mHoles;
+  QList<QGraphicsPolygonItem*> mHoleItems;
+
   QUndoStack *mUndoStack;
   SelectionMode mCurrentMode;
 
@@ -131,6 +143,9 @@ private:
   GraphicsPointItem *mFirstSelectedMoved;
   flat::Point2 mFirstSelectedPrevPosition;
 
+  // Last mesh created, which is updated after each change of the plan
+  mutable flat::IncrementalFlatMesh mMesh;
+
 };
 
 #endif // MESHEDITOR_H
@@ -9,6 +9,7 @@ public:
   static void fileSaveFailed(QWidget *parent, const QString& fileName);
   static void fileOpenFailed(QWidget *parent, const QString& fileName);
   static void invalidMeshExport(QWidget *parent);
+  static void meshTooLarge(QWidget *parent);
 
   static void aboutApplication(QWidget *parent);
 
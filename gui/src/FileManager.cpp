@@ -2,14 +2,20 @@
 
 #include "MessageManager.h"
 
-#include <FlatMesher/BemgenMeshFormatter.h>
+#include <FlatMesher/BemgenMeshSink.h>
+#include <FlatMesher/FMeshSink.h>
 #include <FlatMesher/FlatMesh.h>
 #include <FlatMesher/FloorPlan.h>
-#include <FlatMesher/VTUMeshFormatter.h>
+#include <FlatMesher/MeshCache.h>
+#include <FlatMesher/VTUMeshSink.h>
 
+#include <QDir>
+#include <QFile>
 #include <QFileDialog>
+#include <QStandardPaths>
 
 #include <fstream>
+#include <memory>
 #include <string>
 
 QList<QPair<QString, flat::FloorPlan>> FileManager::openFlats() {
@@ -70,22 +76,34 @@ bool FileManager::saveFlat(const flat::FloorPlan& plan, const QString& fileName)
   return false;
 }
 
-QString FileManager::saveMesh(const flat::FlatMesh &plan) {
+QString FileManager::saveMesh(const flat::FloorPlan &plan) {
   QString filter;
-  QString fileName = QFileDialog::getSaveFileName(nullptr, QObject::tr("Export mesh"), QString(),
-                                                  QObject::tr("BEMGEN files(*.txt);;VTU files(*.vtu)"),
-                                                  &filter);
+  QString filters = QObject::tr("BEMGEN files(*.txt);;VTU files(*.vtu);;Binary VTU files(*.vtu)");
+  if (flat::VTUMeshSink::compressionAvailable())
+    filters += QObject::tr(";;Compressed VTU files(*.vtu)");
+  filters += QObject::tr(";;FlatMesher mesh files(*.fmesh)");
+
+  QString fileName = QFileDialog::getSaveFileName(nullptr, QObject::tr("Export mesh"), QString(), filters, &filter);
 
   if (!fileName.isNull()) {
-    bool success = false;
+    bool success = false, tooLarge = false;
 
     if (filter == QObject::tr("BEMGEN files(*.txt)"))
-      success = saveMesh(plan, fileName, flat::BemgenMeshFormatter());
+      success = saveMesh(plan, fileName, MeshFormat::Bemgen, &tooLarge);
     else if (filter == QObject::tr("VTU files(*.vtu)"))
-      success = saveMesh(plan, fileName, flat::VTUMeshFormatter());
+      success = saveMesh(plan, fileName, MeshFormat::VTU, &tooLarge);
+    else if (filter == QObject::tr("Binary VTU files(*.vtu)"))
+      success = saveMesh(plan, fileName, MeshFormat::VTUBinary, &tooLarge);
+    else if (filter == QObject::tr("Compressed VTU files(*.vtu)"))
+      success = saveMesh(plan, fileName, MeshFormat::VTUCompressed, &tooLarge);
+    else if (filter == QObject::tr("FlatMesher mesh files(*.fmesh)"))
+      success = saveMesh(plan, fileName, MeshFormat::FMesh, &tooLarge);
 
     if (!success) {
-      MessageManager::fileSaveFailed(nullptr, fileName);
+      if (tooLarge)
+        MessageManager::meshTooLarge(nullptr);
+      else
+        MessageManager::fileSaveFailed(nullptr, fileName);
       return QString();
     }
   }
@@ -93,15 +111,68 @@ QString FileManager::saveMesh(const flat::FlatMesh &plan) {
   return fileName;
 }
 
-bool FileManager::saveMesh(const flat::FlatMesh& mesh, const QString& fileName,
-                           const flat::MeshFormatter& fmt) {
+bool FileManager::saveMesh(const flat::FloorPlan& plan, const QString& fileName, MeshFormat format, bool *tooLarge) {
+  // Binary VTU and fmesh files must not have their line endings translated
   std::ofstream output;
-  output.open(fileName.toStdString());
+  if (format == MeshFormat::VTUBinary || format == MeshFormat::VTUCompressed || format == MeshFormat::FMesh)
+    output.open(fileName.toStdString(), std::ios::out | std::ios::binary);
+  else
+    output.open(fileName.toStdString());
 
   if (output.is_open()) {
-    fmt.writeMesh(output, mesh);
-    return true;
+    std::unique_ptr<flat::MeshSink> sink;
+
+    switch (format) {
+    case MeshFormat::Bemgen:
+      sink.reset(new flat::BemgenMeshSink(output));
+      break;
+    case MeshFormat::VTU:
+      sink.reset(new flat::VTUMeshSink(output));
+      break;
+    case MeshFormat::VTUBinary:
+      sink.reset(new flat::VTUMeshSink(output, flat::VTUEncoding::APPENDED));
+      break;
+    case MeshFormat::VTUCompressed:
+      sink.reset(new flat::VTUMeshSink(output, flat::VTUEncoding::APPENDED, true));
+      break;
+    case MeshFormat::FMesh:
+      sink.reset(new flat::FMeshSink(output));
+      break;
+    }
+
+    // Meshes exported before are read from the cache instead of created again.
+    // The export fails if the mesh has too many nodes to be indexed, if the
+    // cache couldn't be read, or if the file couldn't be written
+    flat::FlatMesh mesh;
+    flat::MeshCache::Result result = meshCache().createFromPlan(&plan, mesh, *sink);
+
+    sink.reset();
+    output.close();
+
+    // Invalid plans make the cache fail, so a mesh that was created is only
+    // left empty when it's too large
+    bool large = result == flat::MeshCache::Result::CREATED && mesh.empty();
+    if (tooLarge)
+      *tooLarge = large;
+
+    bool success = result != flat::MeshCache::Result::FAILED && !large && output.good();
+
+    if (!success)
+      QFile::remove(fileName);
+
+    return success;
   }
 
   return false;
 }
+
+const flat::MeshCache& FileManager::meshCache() {
+  static flat::MeshCache cache = []() {
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/meshes";
+    QDir().mkpath(dir);
+
+    return flat::MeshCache(dir.toStdString());
+  }();
+
+  return cache;
+}
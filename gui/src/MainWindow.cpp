@@ -116,7 +116,7 @@ void MainWindow::exportMesh() {
     if (!mCurrentEditor->plan().valid())
       MessageManager::invalidMeshExport(this);
     else
-      FileManager::saveMesh(mCurrentEditor->mesh());
+      FileManager::saveMesh(mCurrentEditor->plan());
   }
 }
 
@@ -150,7 +150,7 @@ void MainWindow::inspectMesh() {
   if (mCurrentEditor) {
     MeshAnalyzer *analyzer = new MeshAnalyzer(this);
     analyzer->show();
-    analyzer->processMesh(mCurrentEditor->plan());
+    analyzer->processMesh(mCurrentEditor);
   }
 }
 
@@ -2,8 +2,9 @@
 #include "ui_MeshAnalyzer.h"
 
 #include "Configuration.h"
+#include "MeshEditor.h"
 
-#include <FlatMesher/FlatMesh.h>
+#include <FlatMesher/IncrementalFlatMesh.h>
 #include <FlatMesher/FloorPlan.h>
 #include <FlatMesher/Line2.h>
 #include <FlatMesher/PlanErrorChecker.h>
@@ -77,6 +78,18 @@ public:
     return false;
   }
 
+  virtual bool visitHoleNotCWOrder(size_t hole) {
+    mParent->addMessage(MeshAnalyzer::tr("Points of the hole %1 are not in clockwise order.").arg(hole), mErrorColor);
+    mErrorsFound = true;
+    return false;
+  }
+
+  virtual bool visitHoleOffLattice(size_t hole) {
+    mParent->addMessage(MeshAnalyzer::tr("The hole %1 has points outside the triangle grid of the flat.").arg(hole), mErrorColor);
+    mErrorsFound = true;
+    return false;
+  }
+
   virtual bool visitRepeatedPoint(const flat::Point2& point) {
     mParent->addMessage(MeshAnalyzer::tr("The point %1 is repeated.").arg(print(point)), mErrorColor);
     mErrorsFound = true;
@@ -90,6 +103,12 @@ public:
     return false;
   }
 
+  virtual bool visitHoleOutside(size_t hole) {
+    mParent->addMessage(MeshAnalyzer::tr("The hole %1 is not inside the flat.").arg(hole), mErrorColor);
+    mErrorsFound = true;
+    return false;
+  }
+
   bool errorsFound() const {
     return mErrorsFound;
   }
@@ -122,7 +141,8 @@ MeshAnalyzer::~MeshAnalyzer() {
   delete ui;
 }
 
-void MeshAnalyzer::processMesh(const flat::FloorPlan& plan) {
+void MeshAnalyzer::processMesh(const MeshEditor *editor) {
+  flat::FloorPlan plan = editor->plan();
   ErrorChecker checker(this);
 
   if (!plan.checkErrors(&checker))
@@ -141,11 +161,10 @@ void MeshAnalyzer::processMesh(const flat::FloorPlan& plan) {
   if (!checker.errorsFound()) {
     addMessage(tr("No errors found."), QColor(Qt::green));
 
-    flat::FlatMesh mesh;
-    mesh.createFromPlan(&plan);
+    const flat::IncrementalFlatMesh& mesh = editor->mesh();
 
-    ui->labelPointsAmount->setText(QString::number(mesh.getNodes().size()));
-    ui->labelTrianglesAmount->setText(QString::number(mesh.getMesh().size()));
+    ui->labelPointsAmount->setText(QString::number(mesh.getNodesView().size()));
+    ui->labelTrianglesAmount->setText(QString::number(mesh.getMeshView().size()));
   }
 }
 
@@ -9,7 +9,9 @@
 #include <FlatMesher/Utils.h>
 
 #include <QGridLayout>
+#include <QGraphicsPolygonItem>
 #include <QGraphicsScene>
+#include <QPen>
 #include <QScrollBar>
 #include <QUndoStack>
 
@@ -70,16 +72,16 @@ flat::FloorPlan MeshEditor::plan() const {
   plan.setTriangleSize(mTriangleSize);
   plan.setHeight(mWallsHeight);
   plan.setNodes(points);
+  plan.setHoles(mHoles);
 
   return plan;
 }
 
-flat::FlatMesh MeshEditor::mesh() const {
+const flat::IncrementalFlatMesh& MeshEditor::mesh() const {
   flat::FloorPlan floor = plan();
-  flat::FlatMesh mesh;
+  mMesh.updateFromPlan(&floor);
 
-  mesh.createFromPlan(&floor);
-  return mesh;
+  return mMesh;
 }
 
 flat::Rectangle MeshEditor::viewport() const {
@@ -347,7 +349,7 @@ void MeshEditor::setPlan(const flat::FloorPlan& plan) {
   mView->setCellsSize(mTriangleSize);
   _setWallsHeight(plan.getHeight());
 
-  std::vector<flat::Point2> points = plan.getNodes();
+  flat::ArrayView<flat::Point2> points = plan.getNodesView();
   removePoints();
 
   if (points.size() > 2) {
@@ -386,6 +388,26 @@ void MeshEditor::setPlan(const flat::FloorPlan& plan) {
     mFirstPoint->setHighlight(HighlightMode::First);
   }
 
+  // Holes are drawn with a dashed line that keeps its width at any zoom, to
+  // tell them apart from the boundary that can be edited
+  qDeleteAll(mHoleItems);
+  mHoleItems.clear();
+  mHoles = plan.getHoles();
+
+  QPen holePen(Qt::darkGray, 2, Qt::DashLine);
+  holePen.setCosmetic(true);
+
+  for (const std::vector<flat::Point2>& hole: mHoles) {
+    QPolygonF polygon;
+    for (const flat::Point2& point: hole)
+      polygon << mapFromFlat(point);
+
+    QGraphicsPolygonItem *item = mScene->addPolygon(polygon, holePen);
+    item->setZValue(-2.0);
+    item->setToolTip(tr("Holes can't be edited. They are saved and meshed as they were loaded."));
+    mHoleItems << item;
+  }
+
   emit pointsAmountChanged(pointCount());
 }
 
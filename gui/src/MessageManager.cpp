@@ -2,6 +2,8 @@
 
 #include "Configuration.h"
 
+#include <FlatMesher/IndexTriangle.h>
+
 #include <QMessageBox>
 
 void MessageManager::fileSaveFailed(QWidget *parent, const QString& fileName) {
@@ -22,6 +24,14 @@ void MessageManager::invalidMeshExport(QWidget *parent) {
                                     "The 2D plan has errors. Check <i>Tools &gt; Find problems...</i>"));
 }
 
+void MessageManager::meshTooLarge(QWidget *parent) {
+  QMessageBox::critical(parent, QObject::tr("Mesh export failed"),
+                        QObject::tr("The mesh has too many nodes. The %1-bit indices of its triangles can't "
+                                    "address nodes past %2. Use a larger triangle size, or build FlatMesher with "
+                                    "FLATMESHER_WIDE_INDICES.")
+                        .arg(int(sizeof(flat::index_t) * 8)).arg(qulonglong(flat::IndexTriangle::MAX_INDEX)));
+}
+
 void MessageManager::aboutApplication(QWidget *parent) {
   QMessageBox::about(parent, QObject::tr("About"),
                      QObject::tr("<b>FlatMesher</b><tr/>"
@@ -15,9 +15,12 @@ public:
   virtual bool visitInvalidSegmentLength(const Line2& /*segment*/) { return true; }
   virtual bool visitInvalidSegmentSlope(const Line2& /*segment*/) { return true; }
   virtual bool visitNotCCWOrder() { return true; }
+  virtual bool visitHoleNotCWOrder(size_t /*hole*/) { return true; }
+  virtual bool visitHoleOffLattice(size_t /*hole*/) { return true; }
   virtual bool visitRepeatedPoint(const Point2& /*point*/) { return true; }
   virtual bool visitIntersectingSegments(const Line2& /*first*/,
                                          const Line2& /*second*/) { return true; }
+  virtual bool visitHoleOutside(size_t /*hole*/) { return true; }
 
 };
 
@@ -0,0 +1,73 @@
+#ifndef FLATMESHER_ARRAYVIEW_H_
+#define FLATMESHER_ARRAYVIEW_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "IndexTriangle.h"
+
+namespace flat {
+
+// Read-only view of contiguous elements owned by another object, used to read
+// them without copying. It's invalidated by any change of the owner's size
+template <typename T>
+class ArrayView {
+public:
+  typedef const T* const_iterator;
+
+  ArrayView(): m_data(NULL), m_size(0) {}
+  ArrayView(const T* data, size_t size): m_data(data), m_size(size) {}
+  ArrayView(const std::vector<T>& elements): m_data(elements.data()), m_size(elements.size()) {}
+  ArrayView(const ArrayView&) = default;
+
+  const T* data() const { return m_data; }
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  const_iterator begin() const { return m_data; }
+  const_iterator end() const { return m_data + m_size; }
+
+  const T& operator[](size_t index) const { return m_data[index]; }
+
+  std::vector<T> toVector() const { return std::vector<T>(begin(), end()); }
+
+  ArrayView& operator=(const ArrayView&) = default;
+
+private:
+  const T* m_data;
+  size_t m_size;
+
+};
+
+// View of triangles whose indices are shifted by an offset when they are read,
+// instead of creating a shifted copy of all of them
+class OffsetTriangleView {
+public:
+  OffsetTriangleView(): m_offset(0) {}
+  OffsetTriangleView(ArrayView<IndexTriangle> triangles, size_t index_offset):
+      m_triangles(triangles), m_offset(index_offset) {}
+  OffsetTriangleView(const OffsetTriangleView&) = default;
+
+  size_t size() const { return m_triangles.size(); }
+  bool empty() const { return m_triangles.empty(); }
+  size_t getOffset() const { return m_offset; }
+
+  // Triangles without the offset
+  ArrayView<IndexTriangle> getTriangles() const { return m_triangles; }
+
+  IndexTriangle operator[](size_t index) const { return m_triangles[index].offset(m_offset); }
+
+  // Writes the 'count' triangles that start at 'first' to 'output'
+  void copy(size_t first, size_t count, IndexTriangle* output) const;
+
+  OffsetTriangleView& operator=(const OffsetTriangleView&) = default;
+
+private:
+  ArrayView<IndexTriangle> m_triangles;
+  size_t m_offset;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_ARRAYVIEW_H_
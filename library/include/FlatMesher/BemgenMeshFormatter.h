@@ -9,8 +9,16 @@ class BemgenMeshFormatter: public MeshFormatter {
 public:
   virtual ~BemgenMeshFormatter() = default;
   virtual std::ostream& writeMesh(std::ostream& os, const Mesh& mesh) const;
+  // The whole stream is read, and anything but whitespace after the last
+  // triangle makes it invalid
   virtual std::istream& readMesh(std::istream& is, Mesh& mesh) const;
 
+  // Files are mapped in memory, and their lines are parsed in parallel
+  virtual bool readMeshFile(const std::string& file_name, Mesh& mesh) const;
+
+private:
+  static bool readMesh(const char* data, size_t size, Mesh& mesh);
+
 };
 
 } // namespace flat
@@ -0,0 +1,34 @@
+#ifndef FLATMESHER_BEMGENMESHSINK_H_
+#define FLATMESHER_BEMGENMESHSINK_H_
+
+#include <iostream>
+
+#include "MeshSink.h"
+#include "TextWriter.h"
+
+namespace flat {
+
+// Writes the mesh in the same format as BemgenMeshFormatter, as it's received
+class BemgenMeshSink: public MeshSink {
+public:
+  explicit BemgenMeshSink(std::ostream& os);
+  virtual ~BemgenMeshSink() = default;
+
+  virtual void onBegin(size_t total_nodes, size_t total_triangles);
+  virtual void onNodes(const Point3* nodes, size_t count);
+  virtual void onTriangles(const IndexTriangle* triangles, size_t count);
+  virtual void onEnd();
+
+private:
+  void beginTriangles();
+
+private:
+  TextWriter m_text;
+  size_t m_total_triangles;
+  bool m_triangles_begun;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_BEMGENMESHSINK_H_
@@ -0,0 +1,53 @@
+#ifndef FLATMESHER_BUILDING_H_
+#define FLATMESHER_BUILDING_H_
+
+#include <iostream>
+#include <vector>
+
+#include "FloorPlan.h"
+
+namespace flat {
+
+// Stack of floor plans, each one placed at its own elevation. Storeys are kept
+// in the order they were added, which must be from the bottom to the top
+class Building {
+public:
+  Building() = default;
+  Building(const Building& b) = default;
+
+  size_t getStoreyCount() const { return m_plans.size(); }
+  const FloorPlan& getPlanAt(size_t index) const { return m_plans.at(index); }
+  FloorPlan& getPlanAt(size_t index) { return m_plans.at(index); }
+  double getElevationAt(size_t index) const { return m_elevations.at(index); }
+
+  void addStorey(const FloorPlan& plan, double elevation);
+  void clear();
+
+  // Tells if the ceiling of the storey 'index' is at the same height than the
+  // floor of the next one
+  bool sharesSlab(size_t index) const;
+
+  // Tells if the lattices of the storey 'index' and of the next one have the
+  // same triangle size, and their origins (the lower left corners of the
+  // bounding boxes) are a whole amount of triangles apart, so that the nodes
+  // of a slab between them are at the same places
+  bool alignedLattices(size_t index) const;
+
+  // Every plan must be valid, no storey can start below the ceiling of the
+  // previous one, and storeys that share a slab must have aligned lattices
+  bool valid() const;
+
+  Building& operator=(const Building& b) = default;
+
+private:
+  std::vector<FloorPlan> m_plans;
+  std::vector<double> m_elevations;
+
+};
+
+} // namespace flat
+
+std::ostream& operator<<(std::ostream& os, const flat::Building& b);
+std::istream& operator>>(std::istream& is, flat::Building& b);
+
+#endif // FLATMESHER_BUILDING_H_
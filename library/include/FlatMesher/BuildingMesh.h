@@ -0,0 +1,42 @@
+#ifndef FLATMESHER_BUILDINGMESH_H_
+#define FLATMESHER_BUILDINGMESH_H_
+
+#include <vector>
+
+#include "Mesh.h"
+
+namespace flat {
+
+class Building;
+
+// Mesh of every storey of a building. The nodes where the ceiling of a storey
+// meets the floor of the next one are shared by both storeys, and the triangles
+// they have in common are kept only once, as part of the lower ceiling, so the
+// result is a single conforming mesh. Buildings whose storeys don't have aligned
+// lattices where they share a slab are not valid, and leave the mesh empty
+class BuildingMesh: public Mesh {
+public:
+  BuildingMesh(): m_building(NULL) {}
+  BuildingMesh(const BuildingMesh& mesh): Mesh(mesh), m_building(mesh.m_building) {}
+  ~BuildingMesh() = default;
+
+  void createFromBuilding(const Building* building);
+  bool empty() const { return m_building == NULL; }
+
+  BuildingMesh& operator=(const BuildingMesh&) = default;
+
+protected:
+  static void matchSlab(ArrayView<Point3> lower, double lower_z, ArrayView<Point3> upper, double upper_z,
+                        std::vector<size_t>& shared);
+  static void matchSlabTriangles(ArrayView<Point3> lower, ArrayView<IndexTriangle> lower_triangles, double slab_z,
+                                 ArrayView<IndexTriangle> upper_triangles, const std::vector<size_t>& shared,
+                                 std::vector<char>& dropped);
+
+private:
+  const Building* m_building;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_BUILDINGMESH_H_
@@ -0,0 +1,42 @@
+#ifndef FLATMESHER_FMESHFORMATTER_H_
+#define FLATMESHER_FMESHFORMATTER_H_
+
+#include <cstdint>
+
+#include "ArrayView.h"
+#include "MeshFormatter.h"
+
+namespace flat {
+
+class MappedMesh;
+
+// Reads and writes meshes in the binary .fmesh format of FMeshHeader. Streams
+// must be opened in binary mode. To use the arrays of a file without reading
+// them into a Mesh, see MappedMesh
+class FMeshFormatter: public MeshFormatter {
+public:
+  explicit FMeshFormatter(bool checksum = true): m_checksum(checksum) {}
+  virtual ~FMeshFormatter() = default;
+
+  // Tells if a checksum is written. It's checked when reading if there's one
+  bool getChecksum() const { return m_checksum; }
+  void setChecksum(bool checksum) { m_checksum = checksum; }
+
+  virtual std::ostream& writeMesh(std::ostream& os, const Mesh& mesh) const;
+  // Writes the group of each triangle too, if there's one for every triangle
+  std::ostream& writeMesh(std::ostream& os, const Mesh& mesh, ArrayView<uint32_t> groups) const;
+  virtual std::istream& readMesh(std::istream& is, Mesh& mesh) const;
+
+  // Files are mapped in memory, and their arrays are copied as they are
+  virtual bool readMeshFile(const std::string& file_name, Mesh& mesh) const;
+
+private:
+  static bool readMesh(const MappedMesh& file, Mesh& mesh);
+
+  bool m_checksum;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_FMESHFORMATTER_H_
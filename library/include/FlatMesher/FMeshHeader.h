@@ -0,0 +1,67 @@
+#ifndef FLATMESHER_FMESHHEADER_H_
+#define FLATMESHER_FMESHHEADER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace flat {
+
+// Header of .fmesh files, the native binary format of FlatMesher, whose arrays
+// can be used where they are when the file is mapped in memory. Every value is
+// little-endian. The header takes the first SIZE bytes:
+//
+//   "FLATMESH", version (uint32), flags (uint32),
+//   amount of nodes (uint64), amount of triangles (uint64),
+//   offsets of the nodes, triangles, groups and checksum (uint64 each)
+//
+// Each node is 3 doubles, and each triangle 3 indices of 32 bits, or of 64 bits
+// with WIDE_INDICES. Groups are an optional uint32 tag per triangle. Arrays
+// start at multiples of ARRAY_ALIGNMENT, with zeros in between. The optional
+// checksum takes the last 8 bytes, and covers everything before it. Missing
+// parts have offset 0
+struct FMeshHeader {
+  static const uint32_t VERSION = 1;
+  static const size_t SIZE = 64;
+  static const size_t ARRAY_ALIGNMENT = 64;
+
+  enum Flags {
+    WIDE_INDICES = 1,
+    GROUPS = 2,
+    CHECKSUM = 4
+  };
+
+  FMeshHeader();
+
+  // Header of a file with the given contents
+  static FMeshHeader layout(uint64_t total_nodes, uint64_t total_triangles, uint32_t flags);
+
+  size_t indexBytes() const { return (flags & WIDE_INDICES) != 0? 8 : 4; }
+  uint64_t fileSize() const;
+
+  // Writes the SIZE bytes of the header
+  void write(char* output) const;
+
+  // Reads the header of a file of 'size' bytes. Returns false if it isn't an
+  // .fmesh file of this version, or its size isn't the one of its arrays, so
+  // that truncated files and trailing data are both rejected
+  bool read(const char* data, size_t size);
+
+  // 64-bit FNV-1a of the little-endian 32-bit words of 'data', starting from
+  // 'state' so that it can be computed by parts. 'size' must be a multiple of 4
+  static const uint64_t CHECKSUM_SEED = 14695981039346656037ULL;
+  static uint64_t checksum(const char* data, size_t size, uint64_t state = CHECKSUM_SEED);
+
+  // Little-endian integers of 'bytes' bytes
+  static void store(uint64_t value, size_t bytes, char* output);
+  static uint64_t load(const char* data, size_t bytes);
+  static bool hostIsLittleEndian();
+
+  uint32_t version, flags;
+  uint64_t total_nodes, total_triangles;
+  uint64_t nodes_offset, triangles_offset, groups_offset, checksum_offset;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_FMESHHEADER_H_
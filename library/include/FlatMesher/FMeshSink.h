@@ -0,0 +1,58 @@
+#ifndef FLATMESHER_FMESHSINK_H_
+#define FLATMESHER_FMESHSINK_H_
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "ArrayView.h"
+#include "FMeshHeader.h"
+#include "MeshSink.h"
+
+namespace flat {
+
+// Writes the mesh in the .fmesh format of FMeshHeader, as it's received.
+// Indices take 32 bits unless there are more nodes than they can index. The
+// stream must be opened in binary mode
+class FMeshSink: public MeshSink {
+public:
+  explicit FMeshSink(std::ostream& os, bool checksum = true);
+  virtual ~FMeshSink() = default;
+
+  // Group of each triangle, written after the triangles. It must be set before
+  // onBegin and kept until onEnd, and it's ignored if it doesn't have a group
+  // for every triangle
+  void setGroups(ArrayView<uint32_t> groups) { m_groups = groups; }
+
+  virtual void onBegin(size_t total_nodes, size_t total_triangles);
+  virtual void onNodes(const Point3* nodes, size_t count);
+  virtual void onTriangles(const IndexTriangle* triangles, size_t count);
+  virtual void onEnd();
+
+private:
+  void beginTriangles();
+
+  // Writes zeros up to 'offset'
+  void pad(uint64_t offset);
+
+  // Writes the buffer, adding it to the checksum
+  void emit(size_t bytes);
+
+private:
+  std::ostream& m_os;
+  bool m_checksum;
+  ArrayView<uint32_t> m_groups;
+
+  FMeshHeader m_header;
+  bool m_triangles_begun;
+
+  // Bytes written and checksum of all of them
+  uint64_t m_written, m_state;
+
+  std::vector<char> m_buffer;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_FMESHSINK_H_
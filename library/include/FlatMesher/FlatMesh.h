@@ -1,47 +1,169 @@
 #ifndef FLATMESHER_FLATMESH_H_
 #define FLATMESHER_FLATMESH_H_
 
+#include <algorithm>
 #include <iostream>
-#include <map>
 #include <vector>
 
+#include "LatticeClassifier.h"
 #include "Mesh.h"
+#include "Point2.h"
 #include "Point3.h"
+#include "ScanlineClassifier.h"
 
 namespace flat {
 
 class FloorPlan;
-class Point2;
-class Rectangle;
+class MeshSink;
 
 class FlatMesh: public Mesh {
 public:
-  FlatMesh(): m_plan(NULL) {}
-  FlatMesh(const FlatMesh& mesh): Mesh(mesh), m_plan(mesh.m_plan) {}
+  FlatMesh(): m_plan(NULL), m_memory_budget(0), m_grading_levels(0) {}
+  FlatMesh(const FlatMesh& mesh): Mesh(mesh), m_plan(mesh.m_plan), m_memory_budget(mesh.m_memory_budget),
+                                  m_grading_levels(mesh.m_grading_levels) {}
   ~FlatMesh() = default;
 
   void createFromPlan(const FloorPlan* plan);
+
+  // Generates the mesh of the plan without storing it, passing it to 'sink'
+  // as it's created. The memory used only depends on the width of the plan,
+  // and it's kept under the memory budget when one is set
+  void createFromPlan(const FloorPlan* plan, MeshSink& sink);
+
   bool empty() const { return m_plan == NULL; }
 
+  // Approximate amount of bytes used to hold the parts of the mesh that are
+  // being passed to a sink. 0 means there is no limit
+  size_t getMemoryBudget() const { return m_memory_budget; }
+  void setMemoryBudget(size_t bytes) { m_memory_budget = bytes; }
+
+  // Maximum amount of times that squares of the interior of the ceiling and
+  // floor can be merged, doubling their size each time. Squares next to the
+  // walls always have the triangle size. 0 means that no squares are merged.
+  // Levels above MAX_GRADING_LEVELS are reduced to it, and levels that would
+  // make blocks larger than the plan are ignored when the mesh is created
+  size_t getGradingLevels() const { return m_grading_levels; }
+  void setGradingLevels(size_t levels) { m_grading_levels = std::min(levels, MAX_GRADING_LEVELS); }
+
+  // Largest amount of grading levels, which makes blocks of 2^32 x 2^32 squares
+  static const size_t MAX_GRADING_LEVELS = 32;
+
   FlatMesh& operator=(const FlatMesh&) = default;
 
 protected:
-  Mesh createWall(const Point2& a, const Point2& b) const;
-  Mesh createCeiling(const Rectangle& box, std::vector<size_t>& boundary_nodes) const;
-  void merge(const std::vector<Mesh>& walls, const std::vector<size_t>& boundary_nodes, const Mesh& ceiling);
+  // Default amount of rows of the lattice that form each band of the ceiling
+  static const size_t CEILING_BAND_ROWS = 32;
+
+  // Default amount of bands of the ceiling kept in memory at the same time
+  // while passing the mesh to a sink
+  static const size_t SINK_BATCH_BANDS = 16;
+
+  // Amount of nodes processed together when computing the new indices of the
+  // ceiling and floor nodes
+  static const size_t REMAP_BLOCK_SIZE = 4096;
+
+  // Node of the ceiling which is also part of a wall. 'segment' is the index of
+  // the segment of the plan that contains it, and 'column' the column of the
+  // wall created from that segment where it is
+  struct BoundaryNode {
+    size_t index;
+    size_t segment, column;
+  };
+
+  // Grid of points of the bounding box of the plan, used to create the ceiling.
+  // If the nodes of the plan are part of the grid, points are classified with
+  // exact integer arithmetic, and the classifier with tolerances is used
+  // otherwise
+  struct CeilingLattice {
+    explicit CeilingLattice(const FloorPlan& plan);
+
+    size_t totalBands() const { return (rows + band_rows - 1) / band_rows; }
+
+    void classifyNodes(size_t iy, std::vector<PointLocation>& loc, std::vector<size_t>& edges) const;
+    void classifyMiddles(size_t iy, std::vector<PointLocation>& loc) const;
+
+    ScanlineClassifier classifier;
+    LatticeClassifier exact_classifier;
+    Point2 origin;
+    double delta;
+    std::vector<double> node_xs, mid_xs;
+    size_t rows, band_rows;
+  };
+
+  // Rows of the ceiling created together. The last row of the previous band is
+  // created again at the beginning of the band, so that the squares between
+  // both bands are created with the rest. The first 'previous_nodes' nodes
+  // belong to that row, and are not part of the band
+  struct CeilingBand {
+    CeilingBand(): previous_nodes(0), previous_kept(0) {}
+
+    size_t keptNodes() const { return nodes.size() - boundary_nodes.size() - previous_kept; }
+
+    std::vector<Point3> nodes;
+    std::vector<IndexTriangle> triangles;
+    std::vector<BoundaryNode> boundary_nodes;
+    size_t previous_nodes, previous_kept;
+  };
+
+  // Position of each part of the flat's mesh in the arrays of nodes and
+  // triangles, known before any of them is created. There is a wall for each
+  // segment of the plan, and 'next_walls' gives the wall that follows each one
+  // in the same ring
+  struct MeshLayout {
+    std::vector<size_t> wall_offsets, wall_triangle_offsets, next_walls;
+    std::vector<size_t> band_offsets, band_triangle_offsets;
+    size_t nodes_z;
+    size_t ceil_offset, floor_offset;
+    size_t ceil_triangle_offset, floor_triangle_offset;
+    size_t total_nodes, total_triangles;
+  };
+
+  // Sizes of the parts of the mesh created together while passing it to a
+  // sink, chosen to stay under the memory budget
+  struct SinkBatches {
+    size_t band_rows, bands, wall_columns;
+  };
+
+  void createBands(const CeilingLattice& lattice, std::vector<CeilingBand>& bands) const;
+  MeshLayout createMesh(const std::vector<CeilingBand>& bands);
+  void mergeBand(const CeilingBand& band, size_t band_idx, const MeshLayout& layout);
+
+  void createWall(const MeshLayout& layout, size_t wall_idx, size_t first_column, size_t last_column,
+                  Point3* nodes, IndexTriangle* triangles) const;
+  void createCeilingBand(const CeilingLattice& lattice, size_t band_idx, CeilingBand& band) const;
+  void createGradedCeiling(const CeilingLattice& lattice, CeilingBand& band) const;
+  size_t boundaryColumn(const CeilingLattice& lattice, size_t segment, size_t ix, size_t iy) const;
+  void addCeilingRow(const CeilingLattice& lattice, size_t iy, const std::vector<PointLocation>& loc,
+                     const std::vector<size_t>& edges, std::vector<size_t>& row_idx, CeilingBand& band) const;
+
+  MeshLayout layout(const std::vector<size_t>& band_nodes, const std::vector<size_t>& band_triangles) const;
+  void merge(const CeilingBand& band, size_t band_idx, const MeshLayout& layout,
+             Point3* ceil_nodes, Point3* floor_nodes,
+             IndexTriangle* ceil_triangles, IndexTriangle* floor_triangles) const;
+
+  SinkBatches sinkBatches(const CeilingLattice& lattice) const;
+  void sinkWalls(const MeshLayout& layout, const SinkBatches& batches, bool triangles, MeshSink& sink) const;
+  void sinkBands(const CeilingLattice& lattice, const MeshLayout& layout, const SinkBatches& batches,
+                 bool floor, bool triangles, MeshSink& sink) const;
+  void mergeBand(const CeilingBand& band, size_t band_idx, const MeshLayout& layout, bool floor, bool triangles,
+                 std::vector<Point3>& nodes, std::vector<IndexTriangle>& band_triangles) const;
 
   inline static void submesh(size_t a_idx, size_t b_idx, size_t c_idx, size_t d_idx,
-                             bool a_in, bool b_in, bool c_in, bool d_in, bool m_in, Mesh& mesh);
-  inline static void processTriangle(const std::vector<size_t>& boundaries,
-                                     const std::map<size_t, size_t>& tr_floor, size_t input_offset,
-                                     size_t output_offset, IndexTriangle& triangle);
-  inline static size_t processTriangleIndex(const std::vector<size_t>& boundaries,
-                                            const std::map<size_t, size_t>& tr_floor, size_t input_offset,
-                                            size_t output_offset, size_t idx);
+                             bool a_in, bool b_in, bool c_in, bool d_in, bool m_in,
+                             std::vector<IndexTriangle>& triangles);
+  static void submeshRow(const std::vector<size_t>& row_idx, const std::vector<size_t>& current_row_idx,
+                         const std::vector<PointLocation>& mid_loc, std::vector<IndexTriangle>& triangles);
+  inline static void processTriangle(const std::vector<size_t>& remap, IndexTriangle& triangle);
+  static size_t remapIndices(const std::vector<size_t>& tr_floor, size_t input_offset,
+                             size_t output_offset, std::vector<size_t>& remap);
 
-private:
+protected:
   const FloorPlan* m_plan;
 
+private:
+  size_t m_memory_budget;
+  size_t m_grading_levels;
+
 };
 
 } // namespace flat
@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 
+#include "ArrayView.h"
+#include "Line2.h"
 #include "Point2.h"
 #include "Rectangle.h"
 
@@ -12,6 +14,8 @@ namespace flat {
 
 class PlanErrorChecker;
 
+// Outer boundary of a flat, in counter-clockwise order, and the boundaries of
+// the holes inside of it (courtyards, shafts...), in clockwise order
 class FloorPlan {
 public:
   FloorPlan(): m_height(0.0), m_triangle_sz(0.0) {}
@@ -20,13 +24,26 @@ public:
   std::vector<Point2> getNodes() const { return m_nodes; }
   const Point2& getNodeAt(size_t index) const { return m_nodes.at(index); }
   Point2& getNodeAt(size_t index) { return m_nodes.at(index); }
+  std::vector<std::vector<Point2>> getHoles() const { return m_holes; }
+  const std::vector<Point2>& getHoleAt(size_t index) const { return m_holes.at(index); }
+  ArrayView<Point2> getNodesView() const { return m_nodes; }
+  ArrayView<std::vector<Point2>> getHolesView() const { return m_holes; }
   double getHeight() const { return m_height; }
   double getTriangleSize() const { return m_triangle_sz; }
 
   void setNodes(std::vector<Point2> nodes) { m_nodes = nodes; }
+  void setHoles(std::vector<std::vector<Point2>> holes) { m_holes = holes; }
+  void addHole(std::vector<Point2> hole) { m_holes.push_back(hole); }
   void setHeight(double height) { m_height = height; }
   void setTriangleSize(double size) { m_triangle_sz = size; }
 
+  // Segments of the outer boundary followed by the segments of each hole. The
+  // segment 'index' goes from a node of a ring to the next node of that ring
+  size_t segmentCount() const;
+  Line2 getSegmentAt(size_t index) const;
+  std::vector<Line2> getSegments() const;
+  size_t nextSegment(size_t index) const;
+
   Rectangle boundingBox() const;
   double boundaryLength() const;
 
@@ -39,6 +56,7 @@ public:
 
 private:
   std::vector<Point2> m_nodes;
+  std::vector<std::vector<Point2>> m_holes;
   double m_height;
   double m_triangle_sz;
 
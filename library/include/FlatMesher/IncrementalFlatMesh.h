@@ -0,0 +1,43 @@
+#ifndef FLATMESHER_INCREMENTALFLATMESH_H_
+#define FLATMESHER_INCREMENTALFLATMESH_H_
+
+#include <vector>
+
+#include "FlatMesh.h"
+#include "FloorPlan.h"
+
+namespace flat {
+
+// Mesh of a floor plan that is updated after each change of the plan, creating
+// again only the walls of the segments that changed and the bands of the
+// ceiling and floor whose rows they cross. The rest is taken from the previous
+// mesh. The plan is copied, so it doesn't need to outlive the mesh
+class IncrementalFlatMesh: public FlatMesh {
+public:
+  IncrementalFlatMesh() = default;
+  IncrementalFlatMesh(const IncrementalFlatMesh& mesh);
+  ~IncrementalFlatMesh() = default;
+
+  using FlatMesh::createFromPlan;
+  void createFromPlan(const FloorPlan* plan);
+
+  // Updates the mesh to match 'plan'. The whole mesh is created again when the
+  // plan changes too much (the amount of nodes, the bounding box, the height or
+  // the triangle size). Returns true if only part of the mesh was created
+  bool updateFromPlan(const FloorPlan* plan);
+
+  IncrementalFlatMesh& operator=(const IncrementalFlatMesh& mesh);
+
+protected:
+  bool canUpdate(const FloorPlan& plan) const;
+
+private:
+  FloorPlan m_previous;
+  std::vector<CeilingBand> m_bands;
+  MeshLayout m_layout;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_INCREMENTALFLATMESH_H_
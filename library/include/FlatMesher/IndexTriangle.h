@@ -1,30 +1,52 @@
 #ifndef FLATMESHER_INDEXTRIANGLE_H_
 #define FLATMESHER_INDEXTRIANGLE_H_
 
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 
 namespace flat {
 
+// Type used to store the indices of the nodes of a triangle. 32 bits are enough
+// for meshes of up to 4 billion nodes and halve the memory used by triangles.
+// Larger meshes need the library to be built with FLATMESHER_WIDE_INDICES
+#ifdef FLATMESHER_WIDE_INDICES
+typedef uint64_t index_t;
+#else
+typedef uint32_t index_t;
+#endif
+
 class IndexTriangle {
 public:
-  IndexTriangle(size_t i, size_t j, size_t k): m_i(i), m_j(j), m_k(k) {}
+  // Largest index of a node that can be stored
+  static const size_t MAX_INDEX = index_t(-1);
+
+  // Indices above MAX_INDEX would be truncated, so callers must check them
+  // first, e.g. with canIndex on the amount of nodes
+  IndexTriangle(size_t i, size_t j, size_t k): m_i(index_t(i)), m_j(index_t(j)), m_k(index_t(k)) {
+    assert(i <= MAX_INDEX && j <= MAX_INDEX && k <= MAX_INDEX);
+  }
   IndexTriangle(const IndexTriangle& t) = default;
 
   size_t getI() const { return m_i; }
   size_t getJ() const { return m_j; }
   size_t getK() const { return m_k; }
 
-  void setI(size_t i) { m_i = i; }
-  void setJ(size_t j) { m_j = j; }
-  void setK(size_t k) { m_k = k; }
+  void setI(size_t i) { assert(i <= MAX_INDEX); m_i = index_t(i); }
+  void setJ(size_t j) { assert(j <= MAX_INDEX); m_j = index_t(j); }
+  void setK(size_t k) { assert(k <= MAX_INDEX); m_k = index_t(k); }
 
   IndexTriangle offset(size_t index_offset) const;
   void invertRotation();
 
+  // Tells if every node of a mesh of 'nodes' nodes can be indexed
+  static bool canIndex(size_t nodes) { return nodes == 0 || nodes - 1 <= MAX_INDEX; }
+
   IndexTriangle& operator=(const IndexTriangle&) = default;
 
 private:
-  size_t m_i, m_j, m_k;
+  index_t m_i, m_j, m_k;
 
 };
 
@@ -0,0 +1,60 @@
+#ifndef FLATMESHER_LATTICECLASSIFIER_H_
+#define FLATMESHER_LATTICECLASSIFIER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ScanlineClassifier.h"
+
+namespace flat {
+
+class FloorPlan;
+
+// Classifies rows of points of the lattice of a floor plan using exact integer
+// arithmetic. Coordinates are expressed in units of half the triangle size,
+// relative to the lower left corner of the bounding box of the plan, so that
+// both the nodes and the middle points of the squares of the lattice have
+// integer coordinates. It can only be used if every node of the plan is part of
+// that grid, which is checked when it's created
+class LatticeClassifier {
+public:
+  // Coordinates larger than this are rejected, so that no product overflows
+  static const int64_t MAX_COORDINATE = int64_t(1) << 29;
+
+  explicit LatticeClassifier(const FloorPlan& plan);
+  LatticeClassifier(const LatticeClassifier&) = default;
+
+  // Tells if the plan could be converted to grid coordinates
+  bool valid() const { return m_valid; }
+
+  // Classifies the 'count' points (x0 + k * step, y) with k = 0..count-1. If
+  // 'boundary_edges' is given, it is filled with the index of the last edge
+  // that contains each point of the boundary
+  void classifyRow(int64_t y, int64_t x0, int64_t step, size_t count, std::vector<PointLocation>& result,
+                   std::vector<size_t>* boundary_edges = NULL) const;
+
+  // Column of the wall created from the edge 'edge_idx' where the point (x, y)
+  // of that edge is
+  size_t column(size_t edge_idx, int64_t x, int64_t y) const;
+
+  LatticeClassifier& operator=(const LatticeClassifier&) = default;
+
+private:
+  struct Edge {
+    int64_t a_x, a_y, b_x, b_y;
+    size_t columns;
+  };
+
+  void markBoundary(size_t edge_idx, int64_t y, int64_t x0, int64_t step, size_t count,
+                    std::vector<PointLocation>& result, std::vector<size_t>* boundary_edges) const;
+
+private:
+  std::vector<Edge> m_edges;
+  bool m_valid;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_LATTICECLASSIFIER_H_
@@ -0,0 +1,39 @@
+#ifndef FLATMESHER_MAPPEDFILE_H_
+#define FLATMESHER_MAPPEDFILE_H_
+
+#include <cstddef>
+#include <string>
+
+namespace flat {
+
+// Read-only view of the whole contents of a file, mapped in memory so that it
+// can be parsed without copying it. The contents are available until the
+// object is destroyed
+class MappedFile {
+public:
+  explicit MappedFile(const std::string& file_name);
+  MappedFile(const MappedFile&) = delete;
+  ~MappedFile();
+
+  // Tells if the file could be opened and mapped. Empty files are valid
+  bool valid() const { return m_valid; }
+
+  const char* data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+  MappedFile& operator=(const MappedFile&) = delete;
+
+private:
+  const char* m_data;
+  size_t m_size;
+  bool m_valid;
+
+  // Handles of the file and of its mapping, only used in Windows
+  void* m_file;
+  void* m_mapping;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_MAPPEDFILE_H_
@@ -0,0 +1,78 @@
+#ifndef FLATMESHER_MAPPEDMESH_H_
+#define FLATMESHER_MAPPEDMESH_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ArrayView.h"
+#include "FMeshHeader.h"
+#include "IndexTriangle.h"
+#include "Point3.h"
+
+namespace flat {
+
+class MappedFile;
+
+// Mesh of an .fmesh file, read without copying its arrays. When the host is
+// little-endian and the file's indices have the size of index_t, the views
+// point to the mapped file itself, so loading takes the same time whatever
+// the size of the mesh. Otherwise, the arrays are converted into copies.
+// The views are available until the object is destroyed
+class MappedMesh {
+public:
+  explicit MappedMesh(const std::string& file_name);
+  // Reads the file from memory, which must be kept until the object is destroyed
+  MappedMesh(const char* data, size_t size);
+  MappedMesh(const MappedMesh&) = delete;
+  ~MappedMesh();
+
+  // Tells if the file could be mapped and has a valid header. The contents of
+  // the arrays are only checked by verify, except that copied indices must fit
+  // in index_t
+  bool valid() const { return m_valid; }
+
+  // Tells if the views point to the file instead of to copies
+  bool isZeroCopy() const { return m_zero_copy; }
+
+  const FMeshHeader& getHeader() const { return m_header; }
+  bool hasGroups() const { return (m_header.flags & FMeshHeader::GROUPS) != 0; }
+  bool hasChecksum() const { return (m_header.flags & FMeshHeader::CHECKSUM) != 0; }
+
+  ArrayView<Point3> getNodesView() const { return m_nodes; }
+  ArrayView<IndexTriangle> getMeshView() const { return m_mesh; }
+  // Empty if the file doesn't have groups
+  ArrayView<uint32_t> getGroupsView() const { return m_groups; }
+
+  // Tells if the checksum, when there's one, matches the contents, and every
+  // index refers to a node. It reads the whole file, so it can be skipped when
+  // it's known to be correct
+  bool verify() const;
+
+  MappedMesh& operator=(const MappedMesh&) = delete;
+
+private:
+  void load(const char* data, size_t size);
+
+private:
+  std::unique_ptr<MappedFile> m_file;
+  const char* m_data;
+
+  FMeshHeader m_header;
+  bool m_valid, m_zero_copy;
+
+  ArrayView<Point3> m_nodes;
+  ArrayView<IndexTriangle> m_mesh;
+  ArrayView<uint32_t> m_groups;
+
+  // Converted arrays, when the views can't point to the file
+  std::vector<Point3> m_node_copy;
+  std::vector<IndexTriangle> m_mesh_copy;
+  std::vector<uint32_t> m_group_copy;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_MAPPEDMESH_H_
@@ -3,8 +3,11 @@
 
 #include <vector>
 
+#include "ArrayView.h"
 #include "IndexTriangle.h"
+#include "NodeArrays.h"
 #include "Point3.h"
+#include "Utils.h"
 
 namespace flat {
 
@@ -19,13 +22,40 @@ public:
   Point3& getNodeAt(size_t index) { return m_nodes.at(index); }
   std::vector<IndexTriangle> getMesh(size_t index_offset = 0) const;
 
+  // Views of the nodes and triangles, to read them without copying. The offset
+  // view shifts the indices of the triangles as they are read
+  ArrayView<Point3> getNodesView() const { return m_nodes; }
+  ArrayView<IndexTriangle> getMeshView() const { return m_mesh; }
+  OffsetTriangleView getMeshView(size_t index_offset) const { return OffsetTriangleView(m_mesh, index_offset); }
+
+  // Copy of the nodes as separate arrays of coordinates, for operations that
+  // are applied to every node. 'setNodes' replaces the nodes with them, which
+  // must keep every index used by the triangles
+  NodeArrays getNodeArrays() const { return NodeArrays(m_nodes); }
+  void setNodes(const NodeArrays& nodes);
+
   void setMesh(const std::vector<Point3>& nodes, const std::vector<IndexTriangle> edges);
+  void setMesh(std::vector<Point3>&& nodes, std::vector<IndexTriangle>&& edges);
 
   void move(double x, double y = 0.0, double z = 0.0);
   void invert();
   size_t addNode(const Point3& node);
   void addTriangle(const IndexTriangle& triangle);
 
+  // Adds the nodes and triangles of 'mesh' after the ones of this mesh, without
+  // joining any node. Several meshes can be appended before welding them once.
+  // Nothing is appended if the result would have more nodes than can be indexed
+  void append(const Mesh& mesh);
+
+  // Joins the nodes that are equal within 'epsilon', keeping the first one of
+  // each group, and removes the triangles that become degenerate. Returns the
+  // amount of nodes removed
+  size_t weld(double epsilon = utils::DOUBLE_EPSILON);
+
+  // Appends 'mesh' and welds the result, so that the nodes both meshes have in
+  // common are shared
+  void merge(const Mesh& mesh, double epsilon = utils::DOUBLE_EPSILON);
+
   Mesh& operator=(const Mesh&) = default;
 
 protected:
@@ -0,0 +1,76 @@
+#ifndef FLATMESHER_MESHCACHE_H_
+#define FLATMESHER_MESHCACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace flat {
+
+class FlatMesh;
+class FloorPlan;
+class MeshSink;
+
+// Meshes stored in a directory, indexed by a hash of the plan and the options
+// used to create them, so that the same mesh is only created once. Each mesh
+// is stored in a binary file, and the least recently used ones are removed when
+// the total size goes over the limit. The directory must already exist
+class MeshCache {
+public:
+  static const uint64_t DEFAULT_MAX_SIZE = uint64_t(256) * 1024 * 1024;
+
+  explicit MeshCache(const std::string& directory, uint64_t max_size = DEFAULT_MAX_SIZE);
+  MeshCache(const MeshCache&) = default;
+  ~MeshCache() = default;
+
+  std::string getDirectory() const { return m_directory; }
+  uint64_t getMaxSize() const { return m_max_size; }
+  void setMaxSize(uint64_t bytes) { m_max_size = bytes; }
+
+  // Where the mesh passed to the sink by createFromPlan comes from. FAILED
+  // means that the plan isn't valid, or that reading the cache failed after
+  // the sink received part of the mesh, so its output is incomplete. The
+  // entry that couldn't be read is removed from the cache
+  enum class Result {
+    CREATED,
+    CACHED,
+    FAILED
+  };
+
+  // Passes the mesh of 'plan' to 'sink'. It's read from the cache if it's
+  // there, and otherwise it's created by 'mesh' and added to the cache. When
+  // it's created, 'mesh' tells if it could be
+  Result createFromPlan(const FloorPlan* plan, FlatMesh& mesh, MeshSink& sink) const;
+
+  // Canonical representation of the plan and the options of 'mesh' that change
+  // the result, and its hash, which is used to name the file of the mesh
+  static std::string key(const FloorPlan& plan, const FlatMesh& mesh);
+  static uint64_t hash(const std::string& key);
+
+  MeshCache& operator=(const MeshCache&) = default;
+
+protected:
+  typedef std::vector<std::pair<std::string, uint64_t>> Index;
+
+  std::string entryPath(const std::string& name) const;
+  // Passes the entry 'name' to 'sink' if it holds the mesh of 'key'. Returns
+  // CREATED, without passing anything, if it doesn't
+  Result load(const std::string& name, const std::string& key, MeshSink& sink) const;
+
+  // The index holds the name and size of every mesh in the cache, from the
+  // least to the most recently used
+  Index readIndex() const;
+  void writeIndex(const Index& index) const;
+  void touch(const std::string& name, uint64_t size) const;
+  void erase(const std::string& name) const;
+
+private:
+  std::string m_directory;
+  uint64_t m_max_size;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_MESHCACHE_H_
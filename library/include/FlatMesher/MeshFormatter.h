@@ -2,6 +2,7 @@
 #define FLATMESHER_MESHFORMATTER_H_
 
 #include <iostream>
+#include <string>
 
 namespace flat {
 
@@ -9,10 +10,23 @@ class Mesh;
 
 class MeshFormatter {
 public:
+  MeshFormatter(): m_threads(1) {}
   virtual ~MeshFormatter() = default;
+
+  // Threads used to write meshes, as in MeshSink::setThreads
+  int getThreads() const { return m_threads; }
+  void setThreads(int threads) { m_threads = threads; }
+
   virtual std::ostream& writeMesh(std::ostream& os, const Mesh& mesh) const = 0;
   virtual std::istream& readMesh(std::istream& is, Mesh& mesh) const = 0;
 
+  // Reads the mesh stored in the file 'file_name'. Returns false if the file
+  // can't be opened or its contents aren't valid, leaving 'mesh' unchanged
+  virtual bool readMeshFile(const std::string& file_name, Mesh& mesh) const;
+
+protected:
+  int m_threads;
+
 };
 
 } // namespace flat
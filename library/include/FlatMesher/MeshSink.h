@@ -0,0 +1,46 @@
+#ifndef FLATMESHER_MESHSINK_H_
+#define FLATMESHER_MESHSINK_H_
+
+#include <cstddef>
+
+namespace flat {
+
+class IndexTriangle;
+class Mesh;
+class OffsetTriangleView;
+class Point3;
+
+// Receives a mesh as it's being generated, so that it never needs to be fully
+// stored in memory. Every node is received before the first triangle, and both
+// are received in order and in chunks of at most CHUNK_SIZE elements
+class MeshSink {
+public:
+  static const size_t CHUNK_SIZE = 65536;
+
+  MeshSink(): m_threads(1) {}
+  virtual ~MeshSink() = default;
+
+  // Threads used to write each chunk, as in TextWriter::writeParallel. Only
+  // sinks that write text use them, and the output is the same with any amount
+  int getThreads() const { return m_threads; }
+  void setThreads(int threads) { m_threads = threads; }
+
+  virtual void onBegin(size_t total_nodes, size_t total_triangles) = 0;
+  virtual void onNodes(const Point3* nodes, size_t count) = 0;
+  virtual void onTriangles(const IndexTriangle* triangles, size_t count) = 0;
+  virtual void onEnd() = 0;
+
+  // Split the input into chunks and pass them to the callbacks
+  void writeNodes(const Point3* nodes, size_t count);
+  void writeTriangles(const IndexTriangle* triangles, size_t count);
+  void writeTriangles(const OffsetTriangleView& triangles);
+  void writeMesh(const Mesh& mesh);
+
+protected:
+  int m_threads;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_MESHSINK_H_
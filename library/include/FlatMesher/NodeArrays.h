@@ -0,0 +1,75 @@
+#ifndef FLATMESHER_NODEARRAYS_H_
+#define FLATMESHER_NODEARRAYS_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "IndexTriangle.h"
+#include "Point3.h"
+
+namespace flat {
+
+// Nodes stored as three separate arrays of x, y and z coordinates, each one
+// starting at a 64-byte boundary. Operations over every node work on
+// contiguous arrays of doubles, which the compiler can vectorise, instead of
+// going through a Point3 for each node
+class NodeArrays {
+public:
+  NodeArrays(): m_size(0), m_stride(0), m_offset(0) {}
+  explicit NodeArrays(const std::vector<Point3>& nodes);
+  NodeArrays(const Point3* nodes, size_t count);
+  NodeArrays(const NodeArrays& nodes);
+  ~NodeArrays() = default;
+
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  // Changes the amount of nodes, keeping the first ones. New nodes are (0, 0, 0)
+  void resize(size_t size);
+
+  const double* getX() const { return m_buffer.data() + m_offset; }
+  const double* getY() const { return getX() + m_stride; }
+  const double* getZ() const { return getX() + 2 * m_stride; }
+  double* getX() { return m_buffer.data() + m_offset; }
+  double* getY() { return getX() + m_stride; }
+  double* getZ() { return getX() + 2 * m_stride; }
+
+  Point3 getNodeAt(size_t index) const;
+  void setNodeAt(size_t index, const Point3& node);
+
+  void assign(const Point3* nodes, size_t count);
+  void toPoints(Point3* nodes) const;
+  std::vector<Point3> toPoints() const;
+
+  void move(double x, double y = 0.0, double z = 0.0);
+
+  // Smallest box that contains every node. Both corners are (0, 0, 0) if there
+  // are no nodes
+  void bounds(Point3& lower, Point3& upper) const;
+
+  // Centroid and unit normal of each triangle, which must only use indices of
+  // these nodes. Normals follow the order of the nodes of the triangle, and
+  // are (0, 0, 0) for degenerate triangles
+  void centroids(const std::vector<IndexTriangle>& triangles, NodeArrays& result) const;
+  void normals(const std::vector<IndexTriangle>& triangles, NodeArrays& result) const;
+
+  NodeArrays& operator=(const NodeArrays& nodes);
+
+private:
+  // Alignment of each array, in doubles
+  static const size_t ALIGNMENT = 8;
+
+  // Amount of nodes processed together by each thread
+  static const size_t BLOCK_SIZE = 4096;
+
+  static int blocks(size_t count) { return (count + BLOCK_SIZE - 1) / BLOCK_SIZE; }
+
+private:
+  std::vector<double> m_buffer;
+  size_t m_size, m_stride, m_offset;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_NODEARRAYS_H_
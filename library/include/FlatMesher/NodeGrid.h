@@ -0,0 +1,53 @@
+#ifndef FLATMESHER_NODEGRID_H_
+#define FLATMESHER_NODEGRID_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Point3.h"
+#include "Utils.h"
+
+namespace flat {
+
+// Spatial hash of nodes, used to find the node equal to another one within a
+// tolerance in constant expected time. Cells are cubes a few times bigger than
+// the tolerance, so two equal nodes are always in the same or in adjacent cells
+class NodeGrid {
+public:
+  explicit NodeGrid(double epsilon = utils::DOUBLE_EPSILON);
+  NodeGrid(const NodeGrid&) = default;
+  ~NodeGrid() = default;
+
+  size_t size() const { return m_entries.size(); }
+  void reserve(size_t nodes);
+
+  // Adds a node, identified by 'index'
+  void insert(const Point3& node, size_t index);
+
+  // Index of a node equal to 'node' within the tolerance, or
+  // numeric_limits<size_t>::max if there isn't any
+  size_t find(const Point3& node) const;
+
+  NodeGrid& operator=(const NodeGrid&) = default;
+
+private:
+  struct Entry {
+    Point3 node;
+    size_t index, next;
+  };
+
+  int64_t cell(double coordinate) const;
+  static uint64_t cellKey(int64_t x, int64_t y, int64_t z);
+
+private:
+  double m_epsilon, m_cell_size;
+  std::unordered_map<uint64_t, size_t> m_cells;
+  std::vector<Entry> m_entries;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_NODEGRID_H_
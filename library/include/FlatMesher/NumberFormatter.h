@@ -0,0 +1,25 @@
+#ifndef FLATMESHER_NUMBERFORMATTER_H_
+#define FLATMESHER_NUMBERFORMATTER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace flat { namespace utils {
+
+// Formatters of the numbers of text files, which write directly to a buffer
+// instead of going through a stream. They return the amount of characters
+// written, which is never more than MAX_NUMBER_SIZE. Numbers are always
+// written in the C locale
+
+const size_t MAX_NUMBER_SIZE = 32;
+
+// Writes the same characters as printf's "%.15g", which is what a stream with
+// precision 15 writes, so files keep the same contents. Most values are
+// converted with a single multiplication, and the rest by the standard library
+size_t formatDouble(double value, char* output);
+
+size_t formatUnsigned(uint64_t value, char* output);
+
+}} // namespace flat::utils
+
+#endif // FLATMESHER_NUMBERFORMATTER_H_
@@ -0,0 +1,25 @@
+#ifndef FLATMESHER_NUMBERPARSER_H_
+#define FLATMESHER_NUMBERPARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace flat { namespace utils {
+
+// Parsers of the numbers of text files, which work directly on a buffer instead
+// of extracting each number from a stream. They skip the whitespace before the
+// number, and return a pointer to the character that follows it, or NULL if
+// there isn't a valid number there. Numbers are always read in the C locale
+
+const char* skipSpaces(const char* begin, const char* end);
+
+// Decimal numbers with up to 15 significant digits and small exponents are
+// converted exactly with a single operation. Any other number is converted by
+// the standard library, so the result is always correctly rounded
+const char* parseDouble(const char* begin, const char* end, double& value);
+
+const char* parseUnsigned(const char* begin, const char* end, uint64_t& value);
+
+}} // namespace flat::utils
+
+#endif // FLATMESHER_NUMBERPARSER_H_
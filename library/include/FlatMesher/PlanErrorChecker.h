@@ -25,9 +25,12 @@ public:
   virtual bool visitInvalidSegmentLength(const Line2& segment) = 0;
   virtual bool visitInvalidSegmentSlope(const Line2& segment) = 0;
   virtual bool visitNotCCWOrder() = 0;
+  virtual bool visitHoleNotCWOrder(size_t hole) = 0;
+  virtual bool visitHoleOffLattice(size_t hole) = 0;
   virtual bool visitRepeatedPoint(const Point2& point) = 0;
   virtual bool visitIntersectingSegments(const Line2& first,
                                          const Line2& second) = 0;
+  virtual bool visitHoleOutside(size_t hole) = 0;
 
 };
 
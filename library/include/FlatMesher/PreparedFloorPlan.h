@@ -0,0 +1,63 @@
+#ifndef FLATMESHER_PREPAREDFLOORPLAN_H_
+#define FLATMESHER_PREPAREDFLOORPLAN_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "Line2.h"
+#include "Point2.h"
+
+namespace flat {
+
+class FloorPlan;
+
+enum class PointLocation {
+  OUTSIDE,
+  INSIDE,
+  BOUNDARY
+};
+
+// Floor plan prepared to classify many points against its boundaries,
+// including the ones of its holes. The bounding box is split into horizontal
+// buckets, each one with the list of edges whose vertical extent overlaps it,
+// so that each query only looks at the edges that can cross the row of the
+// point. Edges spanning more than MAX_BUCKET_SPAN buckets are kept in a
+// separate list instead, which every query looks at, so that the memory used
+// grows linearly with the amount of edges. The results are the same that
+// FloorPlan::pointInBoundary and FloorPlan::pointInside would give
+class PreparedFloorPlan {
+public:
+  explicit PreparedFloorPlan(const FloorPlan& plan);
+  PreparedFloorPlan(const PreparedFloorPlan&) = default;
+
+  PointLocation classify(const Point2& p) const;
+
+  size_t edgeCount() const { return m_edges.size(); }
+  const Line2& getEdgeAt(size_t index) const { return m_edges[index]; }
+  const std::vector<Line2>& getEdges() const { return m_edges; }
+
+  // Indices of the edges which may cross the horizontal line at 'y' or contain
+  // points of it, in increasing order, except for the long edges. It may also
+  // contain some other edges
+  const std::vector<size_t>& edgesAt(double y) const;
+
+  // Indices of the edges that aren't in the buckets because they span too many
+  // of them, in increasing order. Any of them may cross any row
+  const std::vector<size_t>& longEdges() const { return m_long_edges; }
+
+  // Maximum amount of buckets that an edge is added to
+  static const size_t MAX_BUCKET_SPAN = 64;
+
+  PreparedFloorPlan& operator=(const PreparedFloorPlan&) = default;
+
+private:
+  std::vector<Line2> m_edges;
+  std::vector<std::vector<size_t>> m_buckets;
+  std::vector<size_t> m_long_edges;
+  double m_bottom, m_bucket_height;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_PREPAREDFLOORPLAN_H_
@@ -0,0 +1,44 @@
+#ifndef FLATMESHER_SCANLINECLASSIFIER_H_
+#define FLATMESHER_SCANLINECLASSIFIER_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "PreparedFloorPlan.h"
+
+namespace flat {
+
+class FloorPlan;
+
+// Classifies whole rows of points against the boundaries of a floor plan,
+// including the ones of its holes.
+// The crossings of every edge with the row are computed once, and then all the
+// points of the row are classified in a single sweep. Only the edges of the
+// bucket of the prepared plan that contains the row and its long edges are
+// looked at. The results are the same that FloorPlan::pointInBoundary and
+// FloorPlan::pointInside would give for each individual point
+class ScanlineClassifier {
+public:
+  explicit ScanlineClassifier(const FloorPlan& plan);
+  ScanlineClassifier(const ScanlineClassifier&) = default;
+
+  // 'xs' must be sorted in increasing order. If 'boundary_edges' is given, it
+  // is filled with the index of the last edge that contains each point of the
+  // boundary
+  void classifyRow(double y, const std::vector<double>& xs, std::vector<PointLocation>& result,
+                   std::vector<size_t>* boundary_edges = NULL) const;
+
+  ScanlineClassifier& operator=(const ScanlineClassifier&) = default;
+
+private:
+  void markBoundary(size_t edge_idx, double y, const std::vector<double>& xs,
+                    std::vector<PointLocation>& result, std::vector<size_t>* boundary_edges) const;
+
+private:
+  PreparedFloorPlan m_plan;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_SCANLINECLASSIFIER_H_
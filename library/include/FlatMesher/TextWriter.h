@@ -0,0 +1,106 @@
+#ifndef FLATMESHER_TEXTWRITER_H_
+#define FLATMESHER_TEXTWRITER_H_
+
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "NumberFormatter.h"
+
+namespace flat {
+
+class IndexTriangle;
+class Point2;
+class Point3;
+
+// Writes text to a stream through a large buffer, formatting numbers with the
+// utils formatters instead of the stream. The output is the same as writing the
+// values to a stream with precision 15 in the C locale. Everything is written
+// when the buffer is full, when flush is called, and when the writer is
+// destroyed, so the stream must not be written directly in the meantime.
+// Without a stream, the text is kept in memory until it's cleared
+class TextWriter {
+public:
+  static const size_t BUFFER_SIZE = 1 << 20;
+
+  // Amount of elements formatted together by each thread
+  static const size_t PART_SIZE = 8192;
+
+  TextWriter(): m_os(NULL), m_used(0) {}
+  explicit TextWriter(std::ostream& os): m_os(&os), m_used(0) {}
+  TextWriter(const TextWriter&) = delete;
+  ~TextWriter() { flush(); }
+
+  void flush();
+
+  // Text kept in memory, which is everything written since the last flush
+  const char* data() const { return m_buffer.data(); }
+  size_t size() const { return m_used; }
+  void clear() { m_used = 0; }
+
+  // Writes 'sz' characters as they are. Long texts skip the buffer
+  void write(const char* text, size_t sz);
+
+  // Writes 'count' elements, calling 'format' to write each range of them.
+  // With more than 1 thread, the ranges are formatted in parallel into
+  // separate buffers, which are written in order as soon as they are ready,
+  // so the text is the same. 0 threads uses the default amount of OpenMP
+  typedef std::function<void(TextWriter& text, size_t first, size_t last)> RangeFormat;
+  void writeParallel(size_t count, int threads, const RangeFormat& format);
+
+  TextWriter& operator<<(char c) {
+    *reserve(1) = c;
+    ++m_used;
+    return *this;
+  }
+
+  TextWriter& operator<<(const char* text) {
+    write(text, std::strlen(text));
+    return *this;
+  }
+
+  TextWriter& operator<<(double value) {
+    m_used += utils::formatDouble(value, reserve(utils::MAX_NUMBER_SIZE));
+    return *this;
+  }
+
+  TextWriter& operator<<(unsigned int value) { return writeUnsigned(value); }
+  TextWriter& operator<<(unsigned long value) { return writeUnsigned(value); }
+  TextWriter& operator<<(unsigned long long value) { return writeUnsigned(value); }
+
+  // Same formats as the stream operators
+  TextWriter& operator<<(const Point2& p);
+  TextWriter& operator<<(const Point3& p);
+  TextWriter& operator<<(const IndexTriangle& triangle);
+
+  TextWriter& operator=(const TextWriter&) = delete;
+
+private:
+  static const size_t INITIAL_BUFFER_SIZE = 4096;
+
+  // Returns where the next 'bytes' characters can be written
+  char* reserve(size_t bytes) {
+    if (m_used + bytes > m_buffer.size())
+      grow(bytes);
+
+    return m_buffer.data() + m_used;
+  }
+
+  void grow(size_t bytes);
+
+  TextWriter& writeUnsigned(uint64_t value) {
+    m_used += utils::formatUnsigned(value, reserve(utils::MAX_NUMBER_SIZE));
+    return *this;
+  }
+
+private:
+  std::ostream* m_os;
+  std::vector<char> m_buffer;
+  size_t m_used;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_TEXTWRITER_H_
@@ -2,15 +2,38 @@
 #define FLATMESHER_VTUMESHFORMATTER_H_
 
 #include "MeshFormatter.h"
+#include "VTUMeshSink.h"
 
 namespace flat {
 
 class VTUMeshFormatter: public MeshFormatter {
 public:
+  explicit VTUMeshFormatter(VTUEncoding encoding = VTUEncoding::ASCII, bool compressed = false):
+      m_encoding(encoding), m_compressed(compressed) {}
   virtual ~VTUMeshFormatter() = default;
+
+  VTUEncoding getEncoding() const { return m_encoding; }
+  bool getCompressed() const { return m_compressed; }
+
+  void setEncoding(VTUEncoding encoding) { m_encoding = encoding; }
+  void setCompressed(bool compressed) { m_compressed = compressed; }
+
   virtual std::ostream& writeMesh(std::ostream& os, const Mesh& mesh) const;
+  // Any of the encodings that are written can be read, whatever the formatter
+  // was configured with. Only unstructured grids with a single piece of
+  // triangles are supported, and the attributes are ignored. Incomplete files,
+  // or with anything but whitespace after </VTKFile>, are rejected
   virtual std::istream& readMesh(std::istream& is, Mesh& mesh) const;
 
+  // Files are mapped in memory and parsed in place
+  virtual bool readMeshFile(const std::string& file_name, Mesh& mesh) const;
+
+private:
+  static bool readMesh(const char* data, size_t size, Mesh& mesh);
+
+  VTUEncoding m_encoding;
+  bool m_compressed;
+
 };
 
 } // namespace flat
@@ -0,0 +1,105 @@
+#ifndef FLATMESHER_VTUMESHSINK_H_
+#define FLATMESHER_VTUMESHSINK_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "MeshSink.h"
+#include "TextWriter.h"
+
+namespace flat {
+
+// How the arrays of a VTU file are written. ASCII writes them as text inside of
+// the XML, BASE64 as base64-encoded binary data inside of the XML, and APPENDED
+// as raw binary data in a section after the XML
+enum class VTUEncoding {
+  ASCII,
+  BASE64,
+  APPENDED
+};
+
+// Writes the mesh in the same format as VTUMeshFormatter, as it's received.
+// Binary arrays can be compressed with zlib in blocks, as VTK does. Uncompressed
+// arrays are written as they are received, but compressed ones are kept in
+// memory until they are complete, or until the end of the mesh when they are
+// appended, because their compressed size goes before them
+class VTUMeshSink: public MeshSink {
+public:
+  explicit VTUMeshSink(std::ostream& os, VTUEncoding encoding = VTUEncoding::ASCII, bool compressed = false);
+  virtual ~VTUMeshSink() = default;
+
+  // Tells if the library was built with zlib. If it wasn't, compressed arrays
+  // are written without compression
+  static bool compressionAvailable();
+
+  virtual void onBegin(size_t total_nodes, size_t total_triangles);
+  virtual void onNodes(const Point3* nodes, size_t count);
+  virtual void onTriangles(const IndexTriangle* triangles, size_t count);
+  virtual void onEnd();
+
+private:
+  // Size of the blocks in which arrays are compressed
+  static const size_t COMPRESSION_BLOCK_SIZE = 32768;
+
+  // Arrays of the file, in the order they are written
+  enum Array {
+    POINTS,
+    CONNECTIVITY,
+    OFFSETS,
+    TYPES,
+    TOTAL_ARRAYS
+  };
+
+  void beginTriangles();
+
+  void writeHeader();
+  void writeDataArray(Array array, uint64_t offset);
+  void writeAppendedXML(const uint64_t* offsets);
+  uint64_t arrayBytes(Array array) const;
+
+  void beginArray(Array array);
+  void writeArray(const void* data, size_t bytes);
+  void endArray();
+
+  void writeOffsets();
+  void writeTypes();
+
+  void compressBlock();
+  void emit(const void* data, size_t bytes);
+  void encodeBase64(const void* data, size_t bytes, bool flush);
+
+private:
+  std::ostream& m_os;
+  size_t m_total_nodes, m_total_triangles;
+  bool m_triangles_begun;
+
+  VTUEncoding m_encoding;
+  bool m_compressed;
+
+  // Size in bytes of each element of the connectivity and offsets arrays
+  size_t m_index_bytes, m_offset_bytes;
+
+  // Array being written, its compressed blocks, and the uncompressed data
+  // of its last block
+  Array m_array;
+  std::vector<char> m_block, m_compressed_data;
+  std::vector<uint64_t> m_block_sizes;
+  uint64_t m_array_bytes;
+
+  // Bytes received by the base64 encoder that don't form a group of 3 yet
+  unsigned char m_base64_carry[3];
+  size_t m_base64_carry_sz;
+
+  // Complete compressed arrays that are appended after the XML
+  std::string m_appended[TOTAL_ARRAYS];
+
+  // Writer of the whole file when it's ASCII
+  TextWriter m_text;
+
+};
+
+} // namespace flat
+
+#endif // FLATMESHER_VTUMESHSINK_H_
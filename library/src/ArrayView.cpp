@@ -0,0 +1,10 @@
+#include "FlatMesher/ArrayView.h"
+
+using namespace flat;
+
+void OffsetTriangleView::copy(size_t first, size_t count, IndexTriangle* output) const {
+  const IndexTriangle* input = m_triangles.data() + first;
+
+  for (size_t i = 0; i < count; ++i)
+    output[i] = input[i].offset(m_offset);
+}
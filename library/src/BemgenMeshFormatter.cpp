@@ -1,57 +1,198 @@
 #include "FlatMesher/BemgenMeshFormatter.h"
+#include "FlatMesher/BemgenMeshSink.h"
+#include "FlatMesher/MappedFile.h"
 #include "FlatMesher/Mesh.h"
+#include "FlatMesher/NumberParser.h"
 
+#include <algorithm>
+#include <cstring>
+#include <utility>
 #include <vector>
 
 using namespace flat;
 
-std::ostream& BemgenMeshFormatter::writeMesh(std::ostream& os, const Mesh& mesh) const {
-  std::vector<Point3> nodes = mesh.getNodes();
-  std::vector<IndexTriangle> triangles = mesh.getMesh();
+namespace {
 
-  std::streamsize prec = os.precision();
-  os.precision(15);
+// Approximate size of the chunks of text parsed in parallel. Each chunk is
+// extended to the end of its line, so no number is split between two chunks
+const size_t CHUNK_SIZE = 1 << 20;
 
-  os << "3\n3\n\n";
+inline bool isSpace(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
 
-  os << nodes.size() << '\n';
-  for (auto i = nodes.begin(); i != nodes.end(); ++i)
-    os << *i << '\n';
+// Position after the number that starts at 'p'
+inline const char* skipToken(const char* p, const char* end) {
+  while (p != end && !isSpace(*p))
+    ++p;
 
-  os << '\n' << triangles.size();
-  for (auto i = triangles.begin(); i != triangles.end(); ++i)
-    os << '\n' << *i;
+  return p;
+}
 
-  os.precision(prec);
+// Splits [begin, end) in chunks that end after a newline
+std::vector<const char*> splitLines(const char* begin, const char* end) {
+  std::vector<const char*> bounds(1, begin);
 
-  return os;
+  while (size_t(end - bounds.back()) > CHUNK_SIZE) {
+    const char* line_end = static_cast<const char*>(std::memchr(bounds.back() + CHUNK_SIZE, '\n',
+                                                                end - bounds.back() - CHUNK_SIZE));
+    if (line_end == NULL)
+      break;
+
+    bounds.push_back(line_end + 1);
+  }
+
+  bounds.push_back(end);
+  return bounds;
 }
 
-std::istream& BemgenMeshFormatter::readMesh(std::istream& is, Mesh& mesh) const {
-  size_t sp_dim, nodes_el;
+bool parseMesh(const char* data, size_t size, std::vector<Point3>& nodes, std::vector<IndexTriangle>& triangles) {
+  const char* end = data + size;
 
-  is >> sp_dim;
-  is >> nodes_el;
-  if (sp_dim != 3 || nodes_el != 3) {
-    is.clear(std::ios::failbit);
-    return is;
+  uint64_t sp_dim, nodes_el, total_nodes;
+  const char* p = utils::parseUnsigned(data, end, sp_dim);
+  if (p != NULL)
+    p = utils::parseUnsigned(p, end, nodes_el);
+  if (p == NULL || sp_dim != 3 || nodes_el != 3)
+    return false;
+
+  p = utils::parseUnsigned(p, end, total_nodes);
+  if (p == NULL || !IndexTriangle::canIndex(total_nodes))
+    return false;
+
+  // Every value of the rest of the file is a token: 3 coordinates per node,
+  // the amount of triangles, and 3 indices per triangle. The tokens of each
+  // chunk are counted in parallel, so that each chunk knows the index of its
+  // first token, and then the chunks are parsed in parallel
+  std::vector<const char*> bounds = splitLines(p, end);
+  int total_chunks = bounds.size() - 1;
+  std::vector<uint64_t> first_token(total_chunks + 1, 0);
+
+  #pragma omp parallel for schedule(static) shared(bounds, first_token)
+  for (int c = 0; c < total_chunks; ++c) {
+    uint64_t tokens = 0;
+
+    for (const char* q = bounds[c]; (q = utils::skipSpaces(q, bounds[c + 1])) != bounds[c + 1]; ++tokens)
+      q = skipToken(q, bounds[c + 1]);
+
+    first_token[c + 1] = tokens;
   }
 
-  size_t total_nodes;
-  is >> total_nodes;
+  for (int c = 0; c < total_chunks; ++c)
+    first_token[c + 1] += first_token[c];
+
+  uint64_t node_tokens = 3 * total_nodes;
+  if (first_token[total_chunks] <= node_tokens)
+    return false;
+
+  // The amount of triangles is read on its own, from the chunk that has it
+  int count_chunk = std::upper_bound(first_token.begin(), first_token.end(), node_tokens) - first_token.begin() - 1;
+  const char* q = bounds[count_chunk];
+
+  for (uint64_t t = first_token[count_chunk]; t < node_tokens; ++t)
+    q = skipToken(utils::skipSpaces(q, bounds[count_chunk + 1]), bounds[count_chunk + 1]);
+
+  uint64_t total_triangles;
+  q = utils::parseUnsigned(q, bounds[count_chunk + 1], total_triangles);
+  if (q == NULL || (q != end && !isSpace(*q)))
+    return false;
+
+  // Only whitespace may follow the last triangle, so that truncated files and
+  // trailing garbage are both rejected
+  uint64_t total_tokens = node_tokens + 1 + 3 * total_triangles;
+  if (total_triangles > first_token[total_chunks] / 3 || total_tokens != first_token[total_chunks])
+    return false;
+
+  nodes.assign(total_nodes, Point3());
+  triangles.assign(total_triangles, IndexTriangle(0, 0, 0));
+
+  std::vector<char> valid_chunk(total_chunks, 1);
+
+  #pragma omp parallel for schedule(dynamic) shared(bounds, first_token, nodes, triangles, valid_chunk)
+  for (int c = 0; c < total_chunks; ++c) {
+    const char* chunk_end = bounds[c + 1];
+    const char* r = bounds[c];
+
+    for (uint64_t t = first_token[c]; t < first_token[c + 1]; ++t) {
+      r = utils::skipSpaces(r, chunk_end);
+
+      if (t < node_tokens) {
+        double value;
+        r = utils::parseDouble(r, chunk_end, value);
+        if (r == NULL || (r != chunk_end && !isSpace(*r))) {
+          valid_chunk[c] = 0;
+          break;
+        }
+
+        Point3& node = nodes[t / 3];
+        switch (t % 3) {
+        case 0: node.setX(value); break;
+        case 1: node.setY(value); break;
+        default: node.setZ(value); break;
+        }
+      }
+      else if (t == node_tokens)
+        r = skipToken(r, chunk_end);
+      else {
+        uint64_t index;
+        r = utils::parseUnsigned(r, chunk_end, index);
+        if (r == NULL || (r != chunk_end && !isSpace(*r)) || index >= total_nodes) {
+          valid_chunk[c] = 0;
+          break;
+        }
+
+        IndexTriangle& triangle = triangles[(t - node_tokens - 1) / 3];
+        switch ((t - node_tokens - 1) % 3) {
+        case 0: triangle.setI(index); break;
+        case 1: triangle.setJ(index); break;
+        default: triangle.setK(index); break;
+        }
+      }
+    }
+  }
 
-  std::vector<Point3> nodes(total_nodes);
-  for (size_t i = 0; i < total_nodes; ++i)
-    is >> nodes[i];
+  return std::find(valid_chunk.begin(), valid_chunk.end(), 0) == valid_chunk.end();
+}
 
-  size_t total_edges;
-  is >> total_edges;
+} // anonymous namespace
 
-  std::vector<IndexTriangle> edges(total_edges, IndexTriangle(0, 0, 0));
-  for (size_t i = 0; i < total_edges; ++i)
-    is >> edges[i];
+std::ostream& BemgenMeshFormatter::writeMesh(std::ostream& os, const Mesh& mesh) const {
+  BemgenMeshSink sink(os);
+  sink.setThreads(m_threads);
+  sink.writeMesh(mesh);
+
+  return os;
+}
+
+std::istream& BemgenMeshFormatter::readMesh(std::istream& is, Mesh& mesh) const {
+  // The whole stream is read at once, and parsed in memory the same way as a
+  // mapped file
+  std::vector<char> data;
+  char chunk[65536];
+
+  while (is.read(chunk, sizeof(chunk)) || is.gcount() > 0)
+    data.insert(data.end(), chunk, chunk + is.gcount());
 
-  mesh.setMesh(nodes, edges);
+  is.clear(std::ios::eofbit);
+
+  if (!readMesh(data.data(), data.size(), mesh))
+    is.setstate(std::ios::failbit);
 
   return is;
 }
+
+bool BemgenMeshFormatter::readMeshFile(const std::string& file_name, Mesh& mesh) const {
+  MappedFile file(file_name);
+  return file.valid() && readMesh(file.data(), file.size(), mesh);
+}
+
+bool BemgenMeshFormatter::readMesh(const char* data, size_t size, Mesh& mesh) {
+  std::vector<Point3> nodes;
+  std::vector<IndexTriangle> triangles;
+
+  if (!parseMesh(data, size, nodes, triangles))
+    return false;
+
+  mesh.setMesh(std::move(nodes), std::move(triangles));
+  return true;
+}
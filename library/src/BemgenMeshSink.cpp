@@ -0,0 +1,44 @@
+#include "FlatMesher/BemgenMeshSink.h"
+#include "FlatMesher/IndexTriangle.h"
+#include "FlatMesher/Point3.h"
+
+using namespace flat;
+
+BemgenMeshSink::BemgenMeshSink(std::ostream& os):
+  m_text(os), m_total_triangles(0), m_triangles_begun(false) {}
+
+void BemgenMeshSink::onBegin(size_t total_nodes, size_t total_triangles) {
+  m_total_triangles = total_triangles;
+  m_triangles_begun = false;
+
+  m_text << "3\n3\n\n";
+  m_text << total_nodes << '\n';
+}
+
+void BemgenMeshSink::onNodes(const Point3* nodes, size_t count) {
+  m_text.writeParallel(count, m_threads, [nodes](TextWriter& text, size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i)
+      text << nodes[i] << '\n';
+  });
+}
+
+void BemgenMeshSink::onTriangles(const IndexTriangle* triangles, size_t count) {
+  beginTriangles();
+
+  m_text.writeParallel(count, m_threads, [triangles](TextWriter& text, size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i)
+      text << '\n' << triangles[i];
+  });
+}
+
+void BemgenMeshSink::onEnd() {
+  beginTriangles();
+  m_text.flush();
+}
+
+void BemgenMeshSink::beginTriangles() {
+  if (!m_triangles_begun) {
+    m_text << '\n' << m_total_triangles;
+    m_triangles_begun = true;
+  }
+}
@@ -0,0 +1,100 @@
+#include "FlatMesher/Building.h"
+#include "FlatMesher/NumberFormatter.h"
+#include "FlatMesher/Utils.h"
+
+#include <string>
+
+using namespace flat;
+
+namespace {
+
+const char* const STOREY_KEYWORD = "storey";
+
+} // anonymous namespace
+
+void Building::addStorey(const FloorPlan& plan, double elevation) {
+  m_plans.push_back(plan);
+  m_elevations.push_back(elevation);
+}
+
+void Building::clear() {
+  m_plans.clear();
+  m_elevations.clear();
+}
+
+bool Building::sharesSlab(size_t index) const {
+  if (index + 1 >= m_plans.size())
+    return false;
+
+  return utils::areEqual(m_elevations[index] + m_plans[index].getHeight(), m_elevations[index + 1]);
+}
+
+bool Building::alignedLattices(size_t index) const {
+  if (index + 1 >= m_plans.size())
+    return false;
+
+  const FloorPlan& lower = m_plans[index];
+  const FloorPlan& upper = m_plans[index + 1];
+  double delta = lower.getTriangleSize();
+
+  if (!utils::areEqual(delta, upper.getTriangleSize()))
+    return false;
+
+  Point2 shift = upper.boundingBox().getLowerLeft() - lower.boundingBox().getLowerLeft();
+  return utils::isInteger(shift.getX() / delta) && utils::isInteger(shift.getY() / delta);
+}
+
+bool Building::valid() const {
+  if (m_plans.empty())
+    return false;
+
+  for (size_t i = 0; i < m_plans.size(); ++i) {
+    if (!m_plans[i].valid())
+      return false;
+
+    if (i > 0 && utils::less(m_elevations[i], m_elevations[i - 1] + m_plans[i - 1].getHeight()))
+      return false;
+
+    if (i > 0 && sharesSlab(i - 1) && !alignedLattices(i - 1))
+      return false;
+  }
+
+  return true;
+}
+
+std::ostream& operator<<(std::ostream& os, const Building& b) {
+  os << b.getStoreyCount() << '\n';
+  for (size_t i = 0; i < b.getStoreyCount(); ++i) {
+    char elevation[utils::MAX_NUMBER_SIZE];
+    os << STOREY_KEYWORD << ' ';
+    os.write(elevation, utils::formatDouble(b.getElevationAt(i), elevation));
+    os << '\n' << b.getPlanAt(i);
+  }
+
+  return os;
+}
+
+std::istream& operator>>(std::istream& is, Building& b) {
+  size_t sz;
+  is >> sz;
+
+  b.clear();
+  for (size_t i = 0; i < sz && is; ++i) {
+    std::string keyword;
+    double elevation;
+    FloorPlan plan;
+
+    // The keyword delimits each storey, so a plan without its list of holes
+    // fails when the count of holes is read from it, instead of taking values
+    // of the next storey
+    if (!(is >> keyword) || keyword != STOREY_KEYWORD) {
+      is.setstate(std::ios::failbit);
+      break;
+    }
+
+    if (is >> elevation >> plan)
+      b.addStorey(plan, elevation);
+  }
+
+  return is;
+}
@@ -0,0 +1,172 @@
+#include "FlatMesher/BuildingMesh.h"
+#include "FlatMesher/Building.h"
+#include "FlatMesher/FlatMesh.h"
+#include "FlatMesher/NodeGrid.h"
+#include "FlatMesher/Utils.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+using namespace flat;
+
+namespace {
+
+// Nodes of a triangle, whatever its orientation
+typedef std::array<size_t, 3> NodeSet;
+
+NodeSet nodeSet(size_t i, size_t j, size_t k) {
+  NodeSet set = {{i, j, k}};
+  std::sort(set.begin(), set.end());
+  return set;
+}
+
+} // anonymous namespace
+
+void BuildingMesh::createFromBuilding(const Building* building) {
+  m_nodes.clear();
+  m_mesh.clear();
+  m_building = NULL;
+
+  if (building == NULL || !building->valid())
+    return;
+
+  m_building = building;
+
+  // Every storey is meshed on its own and placed at its elevation. The meshes
+  // are kept and read through views until they are joined
+  int storeys = building->getStoreyCount();
+  std::vector<FlatMesh> meshes(storeys);
+  std::vector<ArrayView<Point3>> nodes(storeys);
+  std::vector<ArrayView<IndexTriangle>> triangles(storeys);
+
+  #pragma omp parallel for schedule(dynamic) shared(building, meshes)
+  for (int i = 0; i < storeys; ++i) {
+    meshes[i].createFromPlan(&building->getPlanAt(i));
+    meshes[i].move(0.0, 0.0, building->getElevationAt(i));
+  }
+
+  for (int i = 0; i < storeys; ++i) {
+    nodes[i] = meshes[i].getNodesView();
+    triangles[i] = meshes[i].getMeshView();
+  }
+
+  // Find the nodes of the floor of each storey which are also part of the
+  // ceiling of the previous one. 'shared' holds the index of the node of the
+  // previous storey, or numeric_limits::max if it's not shared. The triangles
+  // of the floor that are also triangles of the ceiling below are dropped, so
+  // that each slab is a single surface
+  std::vector<std::vector<size_t>> shared(storeys);
+  std::vector<std::vector<char>> dropped(storeys);
+  std::vector<size_t> node_offsets(storeys + 1, 0);
+  std::vector<size_t> triangle_offsets(storeys + 1, 0);
+
+  #pragma omp parallel for schedule(dynamic) shared(building, nodes, triangles, shared, dropped, node_offsets, \
+                                                    triangle_offsets)
+  for (int i = 0; i < storeys; ++i) {
+    shared[i].assign(nodes[i].size(), std::numeric_limits<size_t>::max());
+    dropped[i].assign(triangles[i].size(), 0);
+
+    if (i > 0 && building->sharesSlab(i - 1)) {
+      double slab_z = building->getElevationAt(i);
+      matchSlab(nodes[i - 1], slab_z, nodes[i], slab_z, shared[i]);
+      matchSlabTriangles(nodes[i - 1], triangles[i - 1], slab_z, triangles[i], shared[i], dropped[i]);
+    }
+
+    node_offsets[i + 1] = std::count(shared[i].begin(), shared[i].end(), std::numeric_limits<size_t>::max());
+    triangle_offsets[i + 1] = std::count(dropped[i].begin(), dropped[i].end(), 0);
+  }
+
+  for (int i = 0; i < storeys; ++i) {
+    node_offsets[i + 1] += node_offsets[i];
+    triangle_offsets[i + 1] += triangle_offsets[i];
+  }
+
+  // Give the new index to the nodes of each storey which are not shared, and
+  // then to the shared ones, which already have one in the previous storey
+  std::vector<std::vector<size_t>> remap(storeys);
+
+  #pragma omp parallel for schedule(static) shared(nodes, shared, node_offsets, remap)
+  for (int i = 0; i < storeys; ++i) {
+    remap[i].resize(nodes[i].size());
+
+    size_t kept = node_offsets[i];
+    for (size_t j = 0; j < nodes[i].size(); ++j)
+      if (shared[i][j] == std::numeric_limits<size_t>::max())
+        remap[i][j] = kept++;
+  }
+
+  #pragma omp parallel for schedule(static) shared(shared, remap)
+  for (int i = 1; i < storeys; ++i)
+    for (size_t j = 0; j < shared[i].size(); ++j)
+      if (shared[i][j] != std::numeric_limits<size_t>::max())
+        remap[i][j] = remap[i - 1][shared[i][j]];
+
+  // The storeys are meshed on their own, so the building as a whole may have
+  // more nodes than the triangles can index
+  if (!IndexTriangle::canIndex(node_offsets[storeys])) {
+    m_building = NULL;
+    return;
+  }
+
+  m_nodes.resize(node_offsets[storeys]);
+  m_mesh.resize(triangle_offsets[storeys], IndexTriangle(0, 0, 0));
+
+  #pragma omp parallel for schedule(dynamic) shared(nodes, triangles, shared, dropped, remap, triangle_offsets)
+  for (int i = 0; i < storeys; ++i) {
+    for (size_t j = 0; j < nodes[i].size(); ++j)
+      if (shared[i][j] == std::numeric_limits<size_t>::max())
+        m_nodes[remap[i][j]] = nodes[i][j];
+
+    IndexTriangle* output = m_mesh.data() + triangle_offsets[i];
+    for (size_t j = 0; j < triangles[i].size(); ++j) {
+      const IndexTriangle& t = triangles[i][j];
+      if (!dropped[i][j])
+        *output++ = IndexTriangle(remap[i][t.getI()], remap[i][t.getJ()], remap[i][t.getK()]);
+    }
+  }
+}
+
+void BuildingMesh::matchSlab(ArrayView<Point3> lower, double lower_z, ArrayView<Point3> upper, double upper_z,
+                             std::vector<size_t>& shared) {
+  using namespace utils;
+
+  // Only the nodes at the top of the lower storey can be shared. They are
+  // compared by their projection on the plane of the slab
+  NodeGrid slab;
+  for (size_t i = 0; i < lower.size(); ++i) {
+    if (areEqual(lower[i].getZ(), lower_z))
+      slab.insert(Point3(lower[i].getX(), lower[i].getY()), i);
+  }
+
+  for (size_t i = 0; i < upper.size(); ++i) {
+    if (areEqual(upper[i].getZ(), upper_z))
+      shared[i] = slab.find(Point3(upper[i].getX(), upper[i].getY()));
+  }
+}
+
+void BuildingMesh::matchSlabTriangles(ArrayView<Point3> lower, ArrayView<IndexTriangle> lower_triangles,
+                                      double slab_z, ArrayView<IndexTriangle> upper_triangles,
+                                      const std::vector<size_t>& shared, std::vector<char>& dropped) {
+  // Triangles of the ceiling of the lower storey, as the sets of their nodes
+  std::vector<NodeSet> ceiling;
+  for (auto t = lower_triangles.begin(); t != lower_triangles.end(); ++t) {
+    if (utils::areEqual(lower[t->getI()].getZ(), slab_z) && utils::areEqual(lower[t->getJ()].getZ(), slab_z) &&
+        utils::areEqual(lower[t->getK()].getZ(), slab_z))
+      ceiling.push_back(nodeSet(t->getI(), t->getJ(), t->getK()));
+  }
+
+  std::sort(ceiling.begin(), ceiling.end());
+
+  // A triangle of the upper storey whose nodes are all shared is dropped if
+  // the ceiling has a triangle with the same nodes
+  const size_t NOT_SHARED = std::numeric_limits<size_t>::max();
+
+  for (size_t j = 0; j < upper_triangles.size(); ++j) {
+    const IndexTriangle& t = upper_triangles[j];
+    size_t a = shared[t.getI()], b = shared[t.getJ()], c = shared[t.getK()];
+
+    if (a != NOT_SHARED && b != NOT_SHARED && c != NOT_SHARED)
+      dropped[j] = std::binary_search(ceiling.begin(), ceiling.end(), nodeSet(a, b, c));
+  }
+}
@@ -0,0 +1,47 @@
+#include "FlatMesher/FMeshFormatter.h"
+#include "FlatMesher/FMeshSink.h"
+#include "FlatMesher/MappedMesh.h"
+#include "FlatMesher/Mesh.h"
+
+#include <vector>
+
+using namespace flat;
+
+std::ostream& FMeshFormatter::writeMesh(std::ostream& os, const Mesh& mesh) const {
+  return writeMesh(os, mesh, ArrayView<uint32_t>());
+}
+
+std::ostream& FMeshFormatter::writeMesh(std::ostream& os, const Mesh& mesh, ArrayView<uint32_t> groups) const {
+  FMeshSink sink(os, m_checksum);
+  sink.setGroups(groups);
+  sink.writeMesh(mesh);
+
+  return os;
+}
+
+std::istream& FMeshFormatter::readMesh(std::istream& is, Mesh& mesh) const {
+  std::vector<char> data;
+  char chunk[65536];
+
+  while (is.read(chunk, sizeof(chunk)) || is.gcount() > 0)
+    data.insert(data.end(), chunk, chunk + is.gcount());
+
+  is.clear(std::ios::eofbit);
+
+  if (!readMesh(MappedMesh(data.data(), data.size()), mesh))
+    is.setstate(std::ios::failbit);
+
+  return is;
+}
+
+bool FMeshFormatter::readMeshFile(const std::string& file_name, Mesh& mesh) const {
+  return readMesh(MappedMesh(file_name), mesh);
+}
+
+bool FMeshFormatter::readMesh(const MappedMesh& file, Mesh& mesh) {
+  if (!file.verify())
+    return false;
+
+  mesh.setMesh(file.getNodesView().toVector(), file.getMeshView().toVector());
+  return true;
+}
@@ -0,0 +1,127 @@
+#include "FlatMesher/FMeshHeader.h"
+
+#include <cstring>
+
+using namespace flat;
+
+namespace {
+
+const char MAGIC[8] = {'F', 'L', 'A', 'T', 'M', 'E', 'S', 'H'};
+
+inline uint64_t align(uint64_t offset, uint64_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+} // anonymous namespace
+
+const uint32_t FMeshHeader::VERSION;
+const size_t FMeshHeader::SIZE;
+const size_t FMeshHeader::ARRAY_ALIGNMENT;
+const uint64_t FMeshHeader::CHECKSUM_SEED;
+
+FMeshHeader::FMeshHeader():
+  version(VERSION), flags(0), total_nodes(0), total_triangles(0),
+  nodes_offset(0), triangles_offset(0), groups_offset(0), checksum_offset(0) {}
+
+FMeshHeader FMeshHeader::layout(uint64_t total_nodes, uint64_t total_triangles, uint32_t flags) {
+  FMeshHeader header;
+  header.flags = flags;
+  header.total_nodes = total_nodes;
+  header.total_triangles = total_triangles;
+
+  header.nodes_offset = SIZE;
+  header.triangles_offset = align(header.nodes_offset + total_nodes * 3 * sizeof(double), ARRAY_ALIGNMENT);
+  uint64_t end = header.triangles_offset + total_triangles * 3 * header.indexBytes();
+
+  if ((flags & GROUPS) != 0) {
+    header.groups_offset = align(end, ARRAY_ALIGNMENT);
+    end = header.groups_offset + total_triangles * sizeof(uint32_t);
+  }
+
+  if ((flags & CHECKSUM) != 0)
+    header.checksum_offset = align(end, sizeof(uint64_t));
+
+  return header;
+}
+
+uint64_t FMeshHeader::fileSize() const {
+  if ((flags & CHECKSUM) != 0)
+    return checksum_offset + sizeof(uint64_t);
+  if ((flags & GROUPS) != 0)
+    return groups_offset + total_triangles * sizeof(uint32_t);
+
+  return triangles_offset + total_triangles * 3 * indexBytes();
+}
+
+void FMeshHeader::write(char* output) const {
+  std::memcpy(output, MAGIC, sizeof(MAGIC));
+  store(version, 4, output + 8);
+  store(flags, 4, output + 12);
+  store(total_nodes, 8, output + 16);
+  store(total_triangles, 8, output + 24);
+  store(nodes_offset, 8, output + 32);
+  store(triangles_offset, 8, output + 40);
+  store(groups_offset, 8, output + 48);
+  store(checksum_offset, 8, output + 56);
+}
+
+bool FMeshHeader::read(const char* data, size_t size) {
+  if (size < SIZE || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+    return false;
+
+  version = (uint32_t) load(data + 8, 4);
+  flags = (uint32_t) load(data + 12, 4);
+  total_nodes = load(data + 16, 8);
+  total_triangles = load(data + 24, 8);
+  nodes_offset = load(data + 32, 8);
+  triangles_offset = load(data + 40, 8);
+  groups_offset = load(data + 48, 8);
+  checksum_offset = load(data + 56, 8);
+
+  // Amounts that can't fit in the file are rejected before computing any
+  // offset with them, so that nothing overflows
+  if (version != VERSION || (flags & ~uint32_t(WIDE_INDICES | GROUPS | CHECKSUM)) != 0 ||
+      total_nodes > size / (3 * sizeof(double)) || total_triangles > size / (3 * sizeof(uint32_t)))
+    return false;
+
+  // Only the layout that is written is accepted
+  FMeshHeader expected = layout(total_nodes, total_triangles, flags);
+
+  return nodes_offset == expected.nodes_offset && triangles_offset == expected.triangles_offset &&
+         groups_offset == expected.groups_offset && checksum_offset == expected.checksum_offset &&
+         fileSize() == size;
+}
+
+uint64_t FMeshHeader::checksum(const char* data, size_t size, uint64_t state) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+
+  for (size_t i = 0; i + 4 <= size; i += 4) {
+    uint32_t word = uint32_t(bytes[i]) | (uint32_t(bytes[i + 1]) << 8) | (uint32_t(bytes[i + 2]) << 16) |
+                    (uint32_t(bytes[i + 3]) << 24);
+    state ^= word;
+    state *= 1099511628211ULL;
+  }
+
+  return state;
+}
+
+void FMeshHeader::store(uint64_t value, size_t bytes, char* output) {
+  for (size_t i = 0; i < bytes; ++i)
+    output[i] = char((value >> (8 * i)) & 0xff);
+}
+
+uint64_t FMeshHeader::load(const char* data, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; ++i)
+    value |= uint64_t((unsigned char) data[i]) << (8 * i);
+
+  return value;
+}
+
+bool FMeshHeader::hostIsLittleEndian() {
+  uint16_t value = 1;
+  unsigned char first;
+  std::memcpy(&first, &value, 1);
+
+  return first == 1;
+}
@@ -0,0 +1,124 @@
+#include "FlatMesher/FMeshSink.h"
+#include "FlatMesher/IndexTriangle.h"
+#include "FlatMesher/Point3.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using namespace flat;
+
+namespace {
+
+inline void storeDouble(double value, char* output) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  FMeshHeader::store(bits, 8, output);
+}
+
+} // anonymous namespace
+
+FMeshSink::FMeshSink(std::ostream& os, bool checksum):
+  m_os(os), m_checksum(checksum), m_triangles_begun(false), m_written(0), m_state(FMeshHeader::CHECKSUM_SEED) {}
+
+void FMeshSink::onBegin(size_t total_nodes, size_t total_triangles) {
+  uint32_t flags = 0;
+  if (total_nodes > 0 && total_nodes - 1 > std::numeric_limits<uint32_t>::max())
+    flags |= FMeshHeader::WIDE_INDICES;
+  if (!m_groups.empty() && m_groups.size() == total_triangles)
+    flags |= FMeshHeader::GROUPS;
+  if (m_checksum)
+    flags |= FMeshHeader::CHECKSUM;
+
+  m_header = FMeshHeader::layout(total_nodes, total_triangles, flags);
+  m_triangles_begun = false;
+  m_written = 0;
+  m_state = FMeshHeader::CHECKSUM_SEED;
+
+  m_buffer.assign(FMeshHeader::SIZE, 0);
+  m_header.write(m_buffer.data());
+  emit(FMeshHeader::SIZE);
+}
+
+void FMeshSink::onNodes(const Point3* nodes, size_t count) {
+  m_buffer.resize(count * 3 * sizeof(double));
+
+  char* output = m_buffer.data();
+  for (size_t i = 0; i < count; ++i, output += 3 * sizeof(double)) {
+    storeDouble(nodes[i].getX(), output);
+    storeDouble(nodes[i].getY(), output + sizeof(double));
+    storeDouble(nodes[i].getZ(), output + 2 * sizeof(double));
+  }
+
+  emit(m_buffer.size());
+}
+
+void FMeshSink::onTriangles(const IndexTriangle* triangles, size_t count) {
+  beginTriangles();
+
+  size_t index_bytes = m_header.indexBytes();
+  m_buffer.resize(count * 3 * index_bytes);
+
+  char* output = m_buffer.data();
+  for (size_t i = 0; i < count; ++i, output += 3 * index_bytes) {
+    FMeshHeader::store(triangles[i].getI(), index_bytes, output);
+    FMeshHeader::store(triangles[i].getJ(), index_bytes, output + index_bytes);
+    FMeshHeader::store(triangles[i].getK(), index_bytes, output + 2 * index_bytes);
+  }
+
+  emit(m_buffer.size());
+}
+
+void FMeshSink::onEnd() {
+  beginTriangles();
+
+  if ((m_header.flags & FMeshHeader::GROUPS) != 0) {
+    pad(m_header.groups_offset);
+
+    for (size_t i = 0; i < m_groups.size(); i += CHUNK_SIZE) {
+      size_t count = std::min(m_groups.size() - i, CHUNK_SIZE);
+      m_buffer.resize(count * sizeof(uint32_t));
+
+      for (size_t j = 0; j < count; ++j)
+        FMeshHeader::store(m_groups[i + j], sizeof(uint32_t), m_buffer.data() + j * sizeof(uint32_t));
+
+      emit(m_buffer.size());
+    }
+  }
+
+  if ((m_header.flags & FMeshHeader::CHECKSUM) != 0) {
+    pad(m_header.checksum_offset);
+
+    char checksum[sizeof(uint64_t)];
+    FMeshHeader::store(m_state, sizeof(checksum), checksum);
+    m_os.write(checksum, sizeof(checksum));
+  }
+
+  m_os.flush();
+  std::vector<char>().swap(m_buffer);
+}
+
+void FMeshSink::beginTriangles() {
+  if (!m_triangles_begun) {
+    pad(m_header.triangles_offset);
+    m_triangles_begun = true;
+  }
+}
+
+void FMeshSink::pad(uint64_t offset) {
+  m_buffer.assign(offset - m_written, 0);
+  emit(m_buffer.size());
+}
+
+void FMeshSink::emit(size_t bytes) {
+  if (bytes == 0)
+    return;
+
+  // Every part of the file has a multiple of 4 bytes, so the checksum can be
+  // computed by parts
+  if (m_checksum)
+    m_state = FMeshHeader::checksum(m_buffer.data(), bytes, m_state);
+
+  m_os.write(m_buffer.data(), bytes);
+  m_written += bytes;
+}
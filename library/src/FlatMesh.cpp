@@ -1,8 +1,9 @@
 #include "FlatMesher/FlatMesh.h"
 #include "FlatMesher/FloorPlan.h"
-#include "FlatMesher/Line2.h"
+#include "FlatMesher/MeshSink.h"
 #include "FlatMesher/Point2.h"
 #include "FlatMesher/Rectangle.h"
+#include "FlatMesher/ScanlineClassifier.h"
 #include "FlatMesher/Utils.h"
 
 #include <algorithm>
@@ -11,6 +12,50 @@
 
 using namespace flat;
 
+const size_t FlatMesh::CEILING_BAND_ROWS;
+const size_t FlatMesh::SINK_BATCH_BANDS;
+const size_t FlatMesh::MAX_GRADING_LEVELS;
+
+FlatMesh::CeilingLattice::CeilingLattice(const FloorPlan& plan): classifier(plan), exact_classifier(plan) {
+  Rectangle box = plan.boundingBox();
+  delta = plan.getTriangleSize();
+
+  origin = box.getLowerLeft();
+  rows = lround(box.getHeight() / delta) + 1;
+  band_rows = CEILING_BAND_ROWS;
+  size_t width = lround(box.getWidth() / delta);
+
+  // The x coordinates of the nodes and of the middle points of each column
+  // are the same for every row, so they are computed only once
+  node_xs.resize(width + 1);
+  mid_xs.resize(width);
+
+  for (size_t ix = 0; ix <= width; ++ix)
+    node_xs[ix] = origin.getX() + (ix * delta);
+
+  if (width > 0)
+    mid_xs[0] = origin.getX() + (delta / 2.0);
+  for (size_t ix = 2; ix <= width; ++ix)
+    mid_xs[ix - 1] = node_xs[ix] - (delta / 2.0);
+}
+
+void FlatMesh::CeilingLattice::classifyNodes(size_t iy, std::vector<PointLocation>& loc,
+                                             std::vector<size_t>& edges) const {
+  // Grid coordinates are in units of half the triangle size
+  if (exact_classifier.valid())
+    exact_classifier.classifyRow(2 * iy, 0, 2, node_xs.size(), loc, &edges);
+  else
+    classifier.classifyRow(origin.getY() + (iy * delta), node_xs, loc, &edges);
+}
+
+void FlatMesh::CeilingLattice::classifyMiddles(size_t iy, std::vector<PointLocation>& loc) const {
+  // Middle points of the squares between the rows iy - 1 and iy
+  if (exact_classifier.valid())
+    exact_classifier.classifyRow(2 * iy - 1, 1, 2, mid_xs.size(), loc);
+  else
+    classifier.classifyRow(origin.getY() + (iy * delta) - (delta / 2.0), mid_xs, loc);
+}
+
 void FlatMesh::createFromPlan(const FloorPlan* plan) {
   if (m_plan != NULL) {
     m_nodes.clear();
@@ -22,315 +67,712 @@ void FlatMesh::createFromPlan(const FloorPlan* plan) {
 
   m_plan = plan;
 
-  std::vector<Point2> plan_nodes = plan->getNodes();
-  int plan_sz = plan_nodes.size();
-  std::vector<Mesh> walls(plan_sz);
+  CeilingLattice lattice(*plan);
+  std::vector<CeilingBand> bands;
 
-  Mesh ceiling;
-  std::vector<size_t> boundaries;
+  createBands(lattice, bands);
+  createMesh(bands);
+}
 
-  #pragma omp parallel shared(walls, ceiling, boundaries)
-  {
-    #pragma omp for schedule(dynamic) nowait
-    for (int i = 1; i <= plan_sz; ++i) {
-      Point2 a = plan_nodes[i - 1];
-      Point2 b = plan_nodes[i % plan_sz];
+void FlatMesh::createFromPlan(const FloorPlan* plan, MeshSink& sink) {
+  if (m_plan != NULL) {
+    m_nodes.clear();
+    m_mesh.clear();
+  }
 
-      Mesh wall = createWall(a, b);
+  if (plan == NULL || !plan->valid())
+    return;
+
+  m_plan = plan;
 
-      // Thread-safe
-      walls[i - 1] = wall;
+  // The bands of the ceiling are created once only to count their nodes and
+  // triangles, so that the position of every part of the mesh is known. After
+  // that, they are created again in small batches each time they are needed
+  CeilingLattice lattice(*plan);
+  SinkBatches batches = sinkBatches(lattice);
+  lattice.band_rows = batches.band_rows;
+
+  // A graded ceiling needs the classification of the whole lattice, so it's
+  // created only once and kept until the whole mesh has been passed
+  if (m_grading_levels > 0) {
+    CeilingBand band;
+    createGradedCeiling(lattice, band);
+
+    MeshLayout mesh_layout = layout(std::vector<size_t>(1, band.keptNodes()),
+                                    std::vector<size_t>(1, band.triangles.size()));
+    if (!IndexTriangle::canIndex(mesh_layout.total_nodes)) {
+      m_plan = NULL;
+      return;
     }
 
-    // This can be executed before the for loop has finished
-    #pragma omp single
-    ceiling = createCeiling(plan->boundingBox(), boundaries);
+    std::vector<Point3> nodes;
+    std::vector<IndexTriangle> triangles;
+
+    sink.onBegin(mesh_layout.total_nodes, mesh_layout.total_triangles);
+
+    sinkWalls(mesh_layout, batches, false, sink);
+    for (int floor = 0; floor < 2; ++floor) {
+      mergeBand(band, 0, mesh_layout, floor, false, nodes, triangles);
+      sink.writeNodes(nodes.data(), nodes.size());
+    }
+
+    sinkWalls(mesh_layout, batches, true, sink);
+    for (int floor = 0; floor < 2; ++floor) {
+      mergeBand(band, 0, mesh_layout, floor, true, nodes, triangles);
+      sink.writeTriangles(triangles.data(), triangles.size());
+    }
+
+    sink.onEnd();
+    return;
+  }
+
+  int total_bands = lattice.totalBands();
+
+  std::vector<size_t> band_nodes(total_bands), band_triangles(total_bands);
+
+  #pragma omp parallel for schedule(dynamic) shared(lattice, band_nodes, band_triangles)
+  for (int i = 0; i < total_bands; ++i) {
+    CeilingBand band;
+    createCeilingBand(lattice, i, band);
+
+    band_nodes[i] = band.keptNodes();
+    band_triangles[i] = band.triangles.size();
+  }
+
+  MeshLayout mesh_layout = layout(band_nodes, band_triangles);
+
+  // Nothing is passed to the sink if the mesh is too large to be indexed
+  if (!IndexTriangle::canIndex(mesh_layout.total_nodes)) {
+    m_plan = NULL;
+    return;
+  }
+
+  sink.onBegin(mesh_layout.total_nodes, mesh_layout.total_triangles);
+
+  sinkWalls(mesh_layout, batches, false, sink);
+  sinkBands(lattice, mesh_layout, batches, false, false, sink);
+  sinkBands(lattice, mesh_layout, batches, true, false, sink);
+
+  sinkWalls(mesh_layout, batches, true, sink);
+  sinkBands(lattice, mesh_layout, batches, false, true, sink);
+  sinkBands(lattice, mesh_layout, batches, true, true, sink);
+
+  sink.onEnd();
+}
+
+void FlatMesh::createBands(const CeilingLattice& lattice, std::vector<CeilingBand>& bands) const {
+  // The ceiling is created first, because the size of the whole mesh depends
+  // on it. The rows of the lattice are split into bands that are created in
+  // parallel. The amount of bands only depends on the size of the lattice, so
+  // the numbering of nodes and triangles is the same regardless of the number
+  // of threads. A graded ceiling is created as a single band
+  int total_bands = m_grading_levels > 0? 1 : lattice.totalBands();
+  bands.assign(total_bands, CeilingBand());
+
+  if (m_grading_levels > 0) {
+    createGradedCeiling(lattice, bands[0]);
+    return;
   }
 
-  merge(walls, boundaries, ceiling);
+  #pragma omp parallel for schedule(dynamic) shared(lattice, bands)
+  for (int i = 0; i < total_bands; ++i)
+    createCeilingBand(lattice, i, bands[i]);
 }
 
-Mesh FlatMesh::createWall(const Point2& a, const Point2& b) const {
-  Mesh wall;
+FlatMesh::MeshLayout FlatMesh::createMesh(const std::vector<CeilingBand>& bands) {
+  int total_bands = bands.size();
+  std::vector<size_t> band_nodes(total_bands), band_triangles(total_bands);
+
+  for (int i = 0; i < total_bands; ++i) {
+    band_nodes[i] = bands[i].keptNodes();
+    band_triangles[i] = bands[i].triangles.size();
+  }
+
+  // The whole mesh is allocated at once, and then every wall and every band of
+  // the ceiling and floor is written directly into its own slice
+  MeshLayout mesh_layout = layout(band_nodes, band_triangles);
+  int plan_sz = mesh_layout.wall_offsets.size() - 1;
+
+  // A mesh with more nodes than the indices of the triangles can address is
+  // left empty, the same as the mesh of an invalid plan
+  if (!IndexTriangle::canIndex(mesh_layout.total_nodes)) {
+    m_plan = NULL;
+    return mesh_layout;
+  }
+
+  m_nodes.resize(mesh_layout.total_nodes);
+  m_mesh.resize(mesh_layout.total_triangles, IndexTriangle(0, 0, 0));
+
+  #pragma omp parallel shared(bands, mesh_layout)
+  {
+    #pragma omp for schedule(dynamic) nowait
+    for (int i = 0; i < plan_sz; ++i)
+      createWall(mesh_layout, i, 0, (mesh_layout.wall_offsets[i + 1] - mesh_layout.wall_offsets[i]) / mesh_layout.nodes_z,
+                 m_nodes.data() + mesh_layout.wall_offsets[i], m_mesh.data() + mesh_layout.wall_triangle_offsets[i]);
 
+    #pragma omp for schedule(dynamic)
+    for (int i = 0; i < total_bands; ++i)
+      mergeBand(bands[i], i, mesh_layout);
+  }
+
+  return mesh_layout;
+}
+
+void FlatMesh::mergeBand(const CeilingBand& band, size_t band_idx, const MeshLayout& layout) {
+  size_t node_idx = layout.band_offsets[band_idx];
+  size_t triangle_idx = layout.band_triangle_offsets[band_idx];
+
+  merge(band, band_idx, layout,
+        m_nodes.data() + layout.ceil_offset + node_idx,
+        m_nodes.data() + layout.floor_offset + node_idx,
+        m_mesh.data() + layout.ceil_triangle_offset + triangle_idx,
+        m_mesh.data() + layout.floor_triangle_offset + triangle_idx);
+}
+
+void FlatMesh::createWall(const MeshLayout& layout, size_t wall_idx, size_t first_column, size_t last_column,
+                          Point3* nodes, IndexTriangle* triangles) const {
   double delta = m_plan->getTriangleSize();
+  Line2 segment = m_plan->getSegmentAt(wall_idx);
+  Point2 a = segment.getA(), b = segment.getB();
 
   // z represents the height, and xy is the plane where the two points are
-  size_t nodes_z = lround(m_plan->getHeight() / delta);
-  size_t nodes_xy = lround(a.distance(b) / delta);
+  size_t nodes_z = layout.nodes_z - 1;
+  size_t nodes_xy = (layout.wall_offsets[wall_idx + 1] - layout.wall_offsets[wall_idx]) / layout.nodes_z;
+  size_t node_offset = layout.wall_offsets[wall_idx];
 
   // We use this to be able to iterate over the line that contains the two
   // points, even when it is not vertical or horizontal
   double delta_x = (b.getX() - a.getX()) / nodes_xy;
   double delta_y = (b.getY() - a.getY()) / nodes_xy;
 
-  // Add the nodes in column order and from bottom to top
-  // Leave out the last column, because it's created in the next wall
-  // The edges between the last column and the second to last column are added by
-  // the merge() method
+  // Add the nodes of the columns in the range in column order and from bottom
+  // to top. The last column is left out, because it's created in the next wall
   Point3 origin(a);
-  for (size_t i = 0; i < nodes_xy; ++i)
+  for (size_t i = first_column; i < last_column; ++i)
     for (size_t j = 0; j <= nodes_z; ++j)
-      wall.addNode(origin + Point3(i * delta_x, i * delta_y, j * delta));
+      *nodes++ = origin + Point3(i * delta_x, i * delta_y, j * delta);
 
   // Add the edges that compose the mesh
   // For this to always order the indices of the nodes in counter-clockwise order
   // the 2D points of the floor plan must be specified in that order also
-  for (size_t i = 0; i < nodes_xy - 1; ++i) {
+  for (size_t i = first_column; i < std::min(last_column, nodes_xy - 1); ++i) {
     for (size_t j = 0; j < nodes_z; ++j) {
-      size_t actual_idx = (i * (nodes_z + 1)) + j;
+      size_t actual_idx = node_offset + (i * (nodes_z + 1)) + j;
 
       /* /|
         / |
        o__| */
-      IndexTriangle t1(actual_idx, actual_idx + nodes_z + 1, actual_idx + nodes_z + 2);
+      *triangles++ = IndexTriangle(actual_idx, actual_idx + nodes_z + 1, actual_idx + nodes_z + 2);
 
       /* ____
          |  /
          | /
          o/  */
-      IndexTriangle t2(actual_idx, actual_idx + nodes_z + 2, actual_idx + 1);
-
-      wall.addTriangle(t1);
-      wall.addTriangle(t2);
+      *triangles++ = IndexTriangle(actual_idx, actual_idx + nodes_z + 2, actual_idx + 1);
     }
   }
 
-  return wall;
-}
+  // The edges between the last column and the first column of the next wall
+  // are created the same way, wrapping around after the last wall of the ring
+  if (last_column == nodes_xy) {
+    size_t next_offset = layout.wall_offsets[layout.next_walls[wall_idx]];
 
-Mesh FlatMesh::createCeiling(const Rectangle& box, std::vector<size_t>& boundary_nodes) const {
-  Mesh ceiling;
+    for (size_t j = 0; j < nodes_z; ++j) {
+      size_t actual_idx = node_offset + ((nodes_xy - 1) * (nodes_z + 1)) + j;
 
-  double delta = m_plan->getTriangleSize();
+      *triangles++ = IndexTriangle(actual_idx, next_offset + j, next_offset + j + 1);
+      *triangles++ = IndexTriangle(actual_idx, next_offset + j + 1, actual_idx + 1);
+    }
+  }
+}
 
-  Point2 rectOffset = box.getLowerLeft();
-  size_t height = lround(box.getHeight() / delta);
-  size_t width = lround(box.getWidth() / delta);
+void FlatMesh::createCeilingBand(const CeilingLattice& lattice, size_t band_idx, CeilingBand& band) const {
+  size_t first_row = band_idx * lattice.band_rows;
+  size_t last_row = std::min(first_row + lattice.band_rows, lattice.rows);
+
+  std::vector<PointLocation> node_loc;
+  std::vector<size_t> node_edges;
 
   // This will be used to save the index of the node located at the
   // last processed row. If its value is numeric_limits::max, it means that
   // it isn't part of the mesh
-  std::vector<size_t> row_idx(width + 1, std::numeric_limits<size_t>::max());
+  std::vector<size_t> row_idx;
 
-  // Fill the first row and create the first nodes, saving its indices
-  for (size_t ix = 0; ix <= width; ++ix) {
-    Point2 p(rectOffset.getX() + (ix * delta), rectOffset.getY());
+  // Fill the first row and create the first nodes, saving its indices. Except
+  // for the first band, this is the last row of the previous band, which is
+  // handed off to this one
+  size_t start_row = first_row > 0? first_row - 1 : first_row;
 
-    bool boundary = m_plan->pointInBoundary(p);
-    bool inside = boundary || m_plan->pointInside(p);
+  lattice.classifyNodes(start_row, node_loc, node_edges);
+  addCeilingRow(lattice, start_row, node_loc, node_edges, row_idx, band);
 
-    if (inside) {
-      row_idx[ix] = ceiling.addNode(Point3(p, m_plan->getHeight()));
-      if (boundary)
-        boundary_nodes.push_back(row_idx[ix]);
-    }
+  if (first_row > 0) {
+    band.previous_nodes = band.nodes.size();
+    band.previous_kept = band.nodes.size() - band.boundary_nodes.size();
   }
 
-  // We iterate through the bounding box analyzing each group of 4 points
-  // in order to create the triangular mesh. The middle point is used to know
-  // if the square belongs to the ceiling.
+  // We iterate through the band analyzing each group of 4 points in order to
+  // create the triangular mesh. The middle point is used to know if the square
+  // belongs to the ceiling.
   // d --- c
   // |  m  |
   // a --- b
-  for (size_t iy = 1; iy <= height; ++iy) {
-    double y = rectOffset.getY() + (iy * delta);
+  std::vector<PointLocation> mid_loc;
+  std::vector<size_t> current_row_idx;
 
-    std::vector<size_t> current_row_idx(width + 1, std::numeric_limits<size_t>::max());
+  for (size_t iy = start_row + 1; iy < last_row; ++iy) {
+    lattice.classifyNodes(iy, node_loc, node_edges);
+    lattice.classifyMiddles(iy, mid_loc);
 
-    // We compute the first iteration separately, so that the nodes in the
-    // first column can be processed (base case)
-    size_t a_idx = row_idx[0];
-    size_t b_idx = row_idx[1];
-    size_t c_idx = std::numeric_limits<size_t>::max();
-    size_t d_idx = std::numeric_limits<size_t>::max();
+    addCeilingRow(lattice, iy, node_loc, node_edges, current_row_idx, band);
+    submeshRow(row_idx, current_row_idx, mid_loc, band.triangles);
 
-    // Coordinates of the points we will create
-    Point2 c(rectOffset.getX() + delta, y);
-    Point2 d(rectOffset.getX(), y);
-    Point2 m(rectOffset.getX() + (delta / 2.0), y - (delta / 2.0));
+    // We change the indices for the processing of the next row
+    std::swap(row_idx, current_row_idx);
+  }
+}
 
-    // Check if the two new points are part of the boundary
-    bool c_bo = m_plan->pointInBoundary(c);
-    bool d_bo = m_plan->pointInBoundary(d);
+void FlatMesh::addCeilingRow(const CeilingLattice& lattice, size_t iy, const std::vector<PointLocation>& loc,
+                             const std::vector<size_t>& edges, std::vector<size_t>& row_idx, CeilingBand& band) const {
+  const std::vector<double>& xs = lattice.node_xs;
+  double y = lattice.origin.getY() + (iy * lattice.delta);
 
-    // For each point: Is it inside the polygon?
-    bool a_in = a_idx != std::numeric_limits<size_t>::max();
-    bool b_in = b_idx != std::numeric_limits<size_t>::max();
-    bool c_in = c_bo || m_plan->pointInside(c);
-    bool d_in = d_bo || m_plan->pointInside(d);
-    bool m_in = m_plan->pointInBoundary(m) || m_plan->pointInside(m);
-
-    // Add the new two points if they are part of the mesh
-    if (d_in) {
-      d_idx = ceiling.addNode(Point3(d, m_plan->getHeight()));
-      if (d_bo)
-        boundary_nodes.push_back(d_idx);
+  // Add the nodes of the row that are part of the mesh, from left to right,
+  // saving their indices
+  row_idx.assign(xs.size(), std::numeric_limits<size_t>::max());
+
+  for (size_t ix = 0; ix < xs.size(); ++ix) {
+    if (loc[ix] != PointLocation::OUTSIDE) {
+      Point2 p(xs[ix], y);
+
+      row_idx[ix] = band.nodes.size();
+      band.nodes.push_back(Point3(p, m_plan->getHeight()));
+
+      if (loc[ix] == PointLocation::BOUNDARY) {
+        BoundaryNode node;
+        node.index = row_idx[ix];
+        node.segment = edges[ix];
+        node.column = boundaryColumn(lattice, node.segment, ix, iy);
+
+        band.boundary_nodes.push_back(node);
+      }
+    }
+  }
+}
+
+void FlatMesh::createGradedCeiling(const CeilingLattice& lattice, CeilingBand& band) const {
+  size_t width = lattice.mid_xs.size(), height = lattice.rows - 1;
+  size_t row_sz = width + 1;
+
+  // Classify every node and every square of the lattice
+  std::vector<PointLocation> node_loc(lattice.rows * row_sz), mid_loc(height * width);
+  std::vector<size_t> node_edges(lattice.rows * row_sz);
+
+  #pragma omp parallel for schedule(dynamic) shared(lattice, node_loc, mid_loc, node_edges)
+  for (int iy = 0; iy < (int) lattice.rows; ++iy) {
+    std::vector<PointLocation> loc;
+    std::vector<size_t> edges;
+
+    lattice.classifyNodes(iy, loc, edges);
+    std::copy(loc.begin(), loc.end(), node_loc.begin() + iy * row_sz);
+    std::copy(edges.begin(), edges.end(), node_edges.begin() + iy * row_sz);
+
+    if (iy > 0) {
+      lattice.classifyMiddles(iy, loc);
+      std::copy(loc.begin(), loc.end(), mid_loc.begin() + (iy - 1) * width);
     }
+  }
 
-    if (c_in) {
-      c_idx = ceiling.addNode(Point3(c, m_plan->getHeight()));
-      if (c_bo)
-        boundary_nodes.push_back(c_idx);
+  // Squares whose four corners are strictly inside the plan can be merged into
+  // blocks of 2^k x 2^k squares, aligned to a multiple of their size. The
+  // level of each square is the level of the largest block that contains it
+  // made only of those squares
+  std::vector<unsigned char> level(height * width, 0);
+  std::vector<char> mergeable(height * width, 0);
+
+  for (size_t iy = 0; iy < height; ++iy) {
+    for (size_t ix = 0; ix < width; ++ix) {
+      size_t a = iy * row_sz + ix;
+
+      mergeable[iy * width + ix] = node_loc[a] == PointLocation::INSIDE &&
+                                   node_loc[a + 1] == PointLocation::INSIDE &&
+                                   node_loc[a + row_sz] == PointLocation::INSIDE &&
+                                   node_loc[a + row_sz + 1] == PointLocation::INSIDE &&
+                                   mid_loc[iy * width + ix] != PointLocation::OUTSIDE;
     }
+  }
 
-    // Create the triangles
-    submesh(a_idx, b_idx, c_idx, d_idx, a_in, b_in, c_in, d_in, m_in, ceiling);
+  // Blocks can't be larger than the lattice, so there are at most
+  // floor(log2(min(width, height))) levels
+  size_t levels = 0;
+  while (levels < m_grading_levels && (std::min(width, height) >> (levels + 1)) > 0)
+    ++levels;
+
+  for (size_t k = 1, blocks_x = width, blocks_y = height; k <= levels; ++k) {
+    size_t s = size_t(1) << k;
+    std::vector<char> parent((blocks_y / 2) * (blocks_x / 2), 0);
+
+    for (size_t by = 0; by < blocks_y / 2; ++by) {
+      for (size_t bx = 0; bx < blocks_x / 2; ++bx) {
+        size_t child = (2 * by) * blocks_x + 2 * bx;
+        parent[by * (blocks_x / 2) + bx] = mergeable[child] && mergeable[child + 1] &&
+                                           mergeable[child + blocks_x] && mergeable[child + blocks_x + 1];
+
+        if (parent[by * (blocks_x / 2) + bx])
+          for (size_t iy = by * s; iy < (by + 1) * s; ++iy)
+            std::fill(level.begin() + iy * width + bx * s, level.begin() + iy * width + (bx + 1) * s, k);
+      }
+    }
 
-    // Save indices for the next row
-    current_row_idx[0] = d_idx;
-    current_row_idx[1] = c_idx;
+    mergeable.swap(parent);
+    blocks_x /= 2;
+    blocks_y /= 2;
+  }
 
-    // Processing of the rest of columns
-    // We reuse the information of the previous column and the previous row
-    // in order to avoid double calculations and duplicate indices, so in each
-    // iteration we just have to check the node "c" of the square (top right
-    // corner)
-    // Other than that, the computation is pretty much the same that the
-    // first iteration
-    for (size_t ix = 2; ix <= width; ++ix) {
-      double x = rectOffset.getX() + (ix * delta);
+  // Balance the blocks, so that the size of adjacent blocks differs at most by
+  // a factor of 2. This way, there is at most one node in the middle of each
+  // side of a block that is also part of the neighbouring blocks
+  for (bool changed = true; changed;) {
+    changed = false;
+
+    for (size_t iy = 0; iy < height; ++iy) {
+      for (size_t ix = 0; ix < width; ++ix) {
+        unsigned char k = level[iy * width + ix];
+        size_t s = size_t(1) << k;
+
+        if (k < 2 || ix % s != 0 || iy % s != 0)
+          continue;
+
+        bool split = false;
+        for (size_t t = 0; t < s && !split; ++t) {
+          split = (iy > 0 && level[(iy - 1) * width + ix + t] < k - 1) ||
+                  (iy + s < height && level[(iy + s) * width + ix + t] < k - 1) ||
+                  (ix > 0 && level[(iy + t) * width + ix - 1] < k - 1) ||
+                  (ix + s < width && level[(iy + t) * width + ix + s] < k - 1);
+        }
+
+        if (split) {
+          for (size_t y = iy; y < iy + s; ++y)
+            std::fill(level.begin() + y * width + ix, level.begin() + y * width + ix + s, k - 1);
+          changed = true;
+        }
+      }
+    }
+  }
 
-      a_idx = b_idx;
-      d_idx = c_idx;
-      b_idx = row_idx[ix];
+  // Create the triangles of each square and block, using the indices of the
+  // nodes in the lattice. Blocks without nodes in the middle of their sides
+  // are split like squares, and the rest are split around their center, which
+  // is also a node of the lattice
+  // d --- c
+  // |  m  |
+  // a --- b
+  std::vector<IndexTriangle> triangles;
+
+  for (size_t iy = 0; iy < height; ++iy) {
+    for (size_t ix = 0; ix < width; ++ix) {
+      unsigned char k = level[iy * width + ix];
+      size_t s = size_t(1) << k, h = s / 2;
 
-      d = c;
-      c = Point2(x, y);
-      m = Point2(x - (delta / 2.0), y - (delta / 2.0));
+      size_t a = iy * row_sz + ix;
+      size_t b = a + s, c = a + s * row_sz + s, d = a + s * row_sz;
 
-      c_bo = m_plan->pointInBoundary(c);
+      if (k == 0) {
+        submesh(a, b, c, d, node_loc[a] != PointLocation::OUTSIDE, node_loc[b] != PointLocation::OUTSIDE,
+                node_loc[c] != PointLocation::OUTSIDE, node_loc[d] != PointLocation::OUTSIDE,
+                mid_loc[iy * width + ix] != PointLocation::OUTSIDE, triangles);
+        continue;
+      }
 
-      a_in = b_in;
-      d_in = c_in;
-      b_in = b_idx != std::numeric_limits<size_t>::max();
-      c_in = c_bo || m_plan->pointInside(c);
-      m_in = m_plan->pointInBoundary(m) || m_plan->pointInside(m);
+      if (ix % s != 0 || iy % s != 0)
+        continue;
 
-      if (c_in) {
-        c_idx = ceiling.addNode(Point3(c, m_plan->getHeight()));
-        if (c_bo)
-          boundary_nodes.push_back(c_idx);
+      bool bottom = iy > 0 && level[(iy - 1) * width + ix] < k;
+      bool right = ix + s < width && level[iy * width + ix + s] < k;
+      bool top = iy + s < height && level[(iy + s) * width + ix] < k;
+      bool left = ix > 0 && level[iy * width + ix - 1] < k;
+
+      if (!bottom && !right && !top && !left) {
+        triangles.push_back(IndexTriangle(a, b, c));
+        triangles.push_back(IndexTriangle(a, c, d));
+        continue;
       }
 
-      submesh(a_idx, b_idx, c_idx, d_idx, a_in, b_in, c_in, d_in, m_in, ceiling);
-      current_row_idx[ix] = c_idx;
+      std::vector<size_t> ring;
+      ring.push_back(a);
+      if (bottom) ring.push_back(a + h);
+      ring.push_back(b);
+      if (right) ring.push_back(b + h * row_sz);
+      ring.push_back(c);
+      if (top) ring.push_back(d + h);
+      ring.push_back(d);
+      if (left) ring.push_back(a + h * row_sz);
+
+      size_t center = a + h * row_sz + h;
+      for (size_t i = 0; i < ring.size(); ++i)
+        triangles.push_back(IndexTriangle(center, ring[i], ring[(i + 1) % ring.size()]));
     }
+  }
 
-    // We change the indices for the processing of the next row
-    std::swap(row_idx, current_row_idx);
+  // Only the nodes used by the triangles are added to the band, from bottom to
+  // top and from left to right, like in the rest of the ceiling
+  std::vector<size_t> band_idx(node_loc.size(), std::numeric_limits<size_t>::max());
+
+  for (auto i = triangles.begin(); i != triangles.end(); ++i)
+    band_idx[i->getI()] = band_idx[i->getJ()] = band_idx[i->getK()] = 0;
+
+  for (size_t iy = 0; iy < lattice.rows; ++iy) {
+    for (size_t ix = 0; ix < row_sz; ++ix) {
+      size_t node_idx = iy * row_sz + ix;
+      if (band_idx[node_idx] == std::numeric_limits<size_t>::max())
+        continue;
+
+      band_idx[node_idx] = band.nodes.size();
+      band.nodes.push_back(Point3(Point2(lattice.node_xs[ix], lattice.origin.getY() + (iy * lattice.delta)),
+                                  m_plan->getHeight()));
+
+      if (node_loc[node_idx] == PointLocation::BOUNDARY) {
+        BoundaryNode node;
+        node.index = band_idx[node_idx];
+        node.segment = node_edges[node_idx];
+        node.column = boundaryColumn(lattice, node.segment, ix, iy);
+
+        band.boundary_nodes.push_back(node);
+      }
+    }
   }
 
-  // Maybe return a list of indices of nodes that are part of the boundaries, so
-  // that the search for the nodes doesn't take long
-  return ceiling;
+  for (auto i = triangles.begin(); i != triangles.end(); ++i)
+    processTriangle(band_idx, *i);
+
+  band.triangles.swap(triangles);
 }
 
-void FlatMesh::merge(const std::vector<Mesh>& walls, const std::vector<size_t>& boundaries, const Mesh& ceiling) {
-  // We merge the walls by offsetting the indices and creating the sub-mesh
-  // of each corner that we didn't create before
-  std::vector<size_t> nodes_amount(walls.size());
-  size_t acc_nodes = 0;
+size_t FlatMesh::boundaryColumn(const CeilingLattice& lattice, size_t segment, size_t ix, size_t iy) const {
+  // Find the column of the wall where the node is, so that merge() can
+  // find the corresponding wall node without searching for it
+  if (lattice.exact_classifier.valid())
+    return lattice.exact_classifier.column(segment, 2 * ix, 2 * iy);
 
-  size_t nodes_z = lround(m_plan->getHeight() / m_plan->getTriangleSize()) + 1;
-  size_t total_nodes = lround(m_plan->boundaryLength() * nodes_z);
+  Point2 p(lattice.node_xs[ix], lattice.origin.getY() + (iy * lattice.delta));
+  return lround(m_plan->getSegmentAt(segment).getA().distance(p) / lattice.delta);
+}
 
-  for (size_t i = 0; i < walls.size(); ++i) {
-    Mesh wall = walls[i];
+FlatMesh::MeshLayout FlatMesh::layout(const std::vector<size_t>& band_nodes,
+                                      const std::vector<size_t>& band_triangles) const {
+  MeshLayout result;
 
-    std::vector<Point3> nodes = wall.getNodes();
-    std::vector<IndexTriangle> indices = wall.getMesh(acc_nodes);
+  // The size of every wall is known from the plan
+  std::vector<Line2> segments = m_plan->getSegments();
+  size_t plan_sz = segments.size();
 
-    m_nodes.insert(m_nodes.end(), nodes.begin(), nodes.end());
-    m_mesh.insert(m_mesh.end(), indices.begin(), indices.end());
+  double delta = m_plan->getTriangleSize();
+  result.nodes_z = lround(m_plan->getHeight() / delta) + 1;
 
-    acc_nodes += nodes.size();
-    nodes_amount[i] = nodes.size();
+  result.wall_offsets.assign(plan_sz + 1, 0);
+  result.wall_triangle_offsets.assign(plan_sz + 1, 0);
+  result.next_walls.resize(plan_sz);
 
-    for (size_t j = 0; j < nodes_z - 1; ++j) {
-      size_t actual_idx = acc_nodes - nodes_z + j;
+  for (size_t i = 0; i < plan_sz; ++i) {
+    size_t nodes_xy = lround(segments[i].length() / delta);
+    result.next_walls[i] = m_plan->nextSegment(i);
 
-      IndexTriangle t1(actual_idx, (actual_idx + nodes_z) % total_nodes, (actual_idx + nodes_z + 1) % total_nodes);
-      IndexTriangle t2(actual_idx, (actual_idx + nodes_z + 1) % total_nodes, actual_idx + 1);
+    result.wall_offsets[i + 1] = result.wall_offsets[i] + nodes_xy * result.nodes_z;
+    result.wall_triangle_offsets[i + 1] = result.wall_triangle_offsets[i] + 2 * nodes_xy * (result.nodes_z - 1);
+  }
 
-      m_mesh.push_back(t1);
-      m_mesh.push_back(t2);
-    }
+  // The nodes of the ceiling which are not part of the walls go after them,
+  // followed by the same nodes of the floor, and the same for the triangles
+  size_t total_bands = band_nodes.size();
+
+  result.band_offsets.assign(total_bands + 1, 0);
+  result.band_triangle_offsets.assign(total_bands + 1, 0);
+
+  for (size_t i = 0; i < total_bands; ++i) {
+    result.band_offsets[i + 1] = result.band_offsets[i] + band_nodes[i];
+    result.band_triangle_offsets[i + 1] = result.band_triangle_offsets[i] + band_triangles[i];
   }
 
-  // Creation of the floor mesh from the ceiling mesh
-  Mesh floor = ceiling;
-  floor.move(0, 0, -m_plan->getHeight());
-  floor.invert();
+  result.ceil_offset = result.wall_offsets[plan_sz];
+  result.floor_offset = result.ceil_offset + result.band_offsets[total_bands];
+  result.total_nodes = result.floor_offset + result.band_offsets[total_bands];
 
-  std::vector<Point3> nodes = ceiling.getNodes();
-  std::map<size_t, size_t> tr_floor;
+  result.ceil_triangle_offset = result.wall_triangle_offsets[plan_sz];
+  result.floor_triangle_offset = result.ceil_triangle_offset + result.band_triangle_offsets[total_bands];
+  result.total_triangles = result.floor_triangle_offset + result.band_triangle_offsets[total_bands];
 
-  std::vector<Point2> plan_nodes = m_plan->getNodes();
-  size_t plan_sz = plan_nodes.size();
-  size_t boundary_sz = boundaries.size();
+  return result;
+}
 
-  acc_nodes = 0;
+void FlatMesh::merge(const CeilingBand& band, size_t band_idx, const MeshLayout& layout,
+                     Point3* ceil_nodes, Point3* floor_nodes,
+                     IndexTriangle* ceil_triangles, IndexTriangle* floor_triangles) const {
+  // Fill the translation table with the wall node corresponding to each node
+  // in the boundaries of the ceiling. We know that nodes are ordered by columns
+  // from bottom to top, so it's only needed the column index and the index
+  // where the wall starts to figure out the global index of the corresponding
+  // top and bottom nodes (ceiling and floor). The node after the last column
+  // of a wall is the first one of the next wall of the ring
+  std::vector<size_t> tr_floor(band.nodes.size(), std::numeric_limits<size_t>::max());
 
-  // Walk over every segment and find the corresponding nodes in the ceiling
-  // to fill the translation table
-  for (size_t i = 0; i < plan_sz; ++i) {
-    Point2 a = plan_nodes[i];
-    Point2 b = plan_nodes[(i + 1) % plan_sz];
-
-    Line2 ab(a, b);
-
-    for (size_t j = 0; j < boundary_sz; ++j) {
-      Point3 boundary_point = nodes[boundaries[j]];
-      Point2 boundary_2d(boundary_point.getX(), boundary_point.getY());
-
-      if (ab.contains(boundary_2d)) {
-        // Find the index in the line where the "boundary_point" is
-        // We know that nodes are ordered by columns from bottom to top, so
-        // it's only needed the column index and the index where the current
-        // wall starts to figure out the global index of the corresponding top
-        // and bottom nodes (ceiling and floor)
-        size_t wall_column_idx = lround(a.distance(boundary_2d) / m_plan->getTriangleSize());
-        tr_floor[boundaries[j]] = (acc_nodes + wall_column_idx * nodes_z) % total_nodes;
-      }
-    }
+  for (auto i = band.boundary_nodes.begin(); i != band.boundary_nodes.end(); ++i) {
+    size_t wall_offset = layout.wall_offsets[i->segment] + i->column * layout.nodes_z;
 
-    acc_nodes += nodes_amount[i];
+    if (wall_offset == layout.wall_offsets[i->segment + 1])
+      wall_offset = layout.wall_offsets[layout.next_walls[i->segment]];
+
+    tr_floor[i->index] = wall_offset;
   }
 
+  // Build the tables that give the new index of every node of the band, by
+  // applying offsets and translations. The nodes of the previous row go right
+  // before the ones of the band
+  size_t input_offset = layout.band_offsets[band_idx] - band.previous_kept;
+  std::vector<size_t> remap_ceil, remap_floor;
+
+  if (ceil_nodes || ceil_triangles)
+    remapIndices(tr_floor, layout.ceil_offset + input_offset, layout.nodes_z - 1, remap_ceil);
+  if (floor_nodes || floor_triangles)
+    remapIndices(tr_floor, layout.floor_offset + input_offset, 0, remap_floor);
+
   // Get the nodes which are not part of the boundaries and add them to the mesh
-  for (size_t i = 0; i < nodes.size(); ++i) {
-    if (tr_floor.find(i) == tr_floor.end())
-      m_nodes.push_back(nodes[i]);
+  Point3 floor_translation(0, 0, -m_plan->getHeight());
+
+  for (size_t i = band.previous_nodes; i < band.nodes.size(); ++i) {
+    if (tr_floor[i] == std::numeric_limits<size_t>::max()) {
+      if (ceil_nodes)
+        *ceil_nodes++ = band.nodes[i];
+      if (floor_nodes)
+        *floor_nodes++ = band.nodes[i] + floor_translation;
+    }
+  }
+
+  // Take the triangles of the ceiling and change the indices to match the new
+  // ones. The floor uses the same triangles, with the opposite orientation
+  for (auto i = band.triangles.begin(); i != band.triangles.end(); ++i) {
+    if (ceil_triangles) {
+      IndexTriangle triangle(*i);
+      processTriangle(remap_ceil, triangle);
+      *ceil_triangles++ = triangle;
+    }
+
+    if (floor_triangles) {
+      IndexTriangle triangle(*i);
+      triangle.invertRotation();
+      processTriangle(remap_floor, triangle);
+      *floor_triangles++ = triangle;
+    }
   }
+}
+
+FlatMesh::SinkBatches FlatMesh::sinkBatches(const CeilingLattice& lattice) const {
+  SinkBatches result;
+  result.band_rows = CEILING_BAND_ROWS;
+  result.bands = SINK_BATCH_BANDS;
+  result.wall_columns = std::numeric_limits<size_t>::max();
+
+  if (m_memory_budget == 0)
+    return result;
+
+  // Upper estimate of the memory needed by each row of a band while it's
+  // created and merged: its nodes and triangles, the translation and remap
+  // tables and the output of merge()
+  size_t width = lattice.node_xs.size();
+  size_t row_bytes = width * (sizeof(Point3) + 2 * sizeof(size_t) + 4 * sizeof(IndexTriangle));
+
+  // Each band also holds the last row of the previous one. The rows of each
+  // band are reduced first, so that bands can still be created in parallel,
+  // and then the amount of bands of each batch
+  size_t rows = std::max(m_memory_budget / row_bytes, (size_t) 2);
+
+  result.band_rows = std::max(std::min(rows / result.bands, CEILING_BAND_ROWS + 1), (size_t) 2) - 1;
+  result.bands = std::max(std::min(rows / (result.band_rows + 1), SINK_BATCH_BANDS), (size_t) 1);
+
+  // Walls are created by slices of columns
+  size_t nodes_z = lround(m_plan->getHeight() / lattice.delta) + 1;
+  size_t column_bytes = nodes_z * (sizeof(Point3) + 2 * sizeof(IndexTriangle));
+
+  result.wall_columns = std::max(m_memory_budget / column_bytes, (size_t) 1);
 
-  nodes = floor.getNodes();
-  for (size_t i = 0; i < nodes.size(); ++i) {
-    if (tr_floor.find(i) == tr_floor.end())
-      m_nodes.push_back(nodes[i]);
+  return result;
+}
+
+void FlatMesh::sinkWalls(const MeshLayout& layout, const SinkBatches& batches, bool triangles,
+                         MeshSink& sink) const {
+  size_t plan_sz = layout.wall_offsets.size() - 1;
+
+  std::vector<Point3> wall_nodes;
+  std::vector<IndexTriangle> wall_triangles;
+
+  for (size_t i = 0; i < plan_sz; ++i) {
+    size_t columns = (layout.wall_offsets[i + 1] - layout.wall_offsets[i]) / layout.nodes_z;
+
+    for (size_t first = 0; first < columns; first += std::min(batches.wall_columns, columns - first)) {
+      size_t last = first + std::min(batches.wall_columns, columns - first);
+
+      // Every column has the same amount of triangles, except the last one,
+      // which has none if it's not joined to the next wall
+      size_t triangle_columns = last == columns? last - first : std::min(last, columns - 1) - first;
+
+      wall_nodes.resize((last - first) * layout.nodes_z);
+      wall_triangles.resize(triangle_columns * 2 * (layout.nodes_z - 1), IndexTriangle(0, 0, 0));
+
+      createWall(layout, i, first, last, wall_nodes.data(), wall_triangles.data());
+
+      if (triangles)
+        sink.writeTriangles(wall_triangles.data(), wall_triangles.size());
+      else
+        sink.writeNodes(wall_nodes.data(), wall_nodes.size());
+    }
   }
+}
+
+void FlatMesh::sinkBands(const CeilingLattice& lattice, const MeshLayout& layout, const SinkBatches& batches,
+                         bool floor, bool triangles, MeshSink& sink) const {
+  int total_bands = lattice.totalBands();
+  int batch_bands = batches.bands;
+
+  // Bands are created in parallel in batches, and passed to the sink in order
+  for (int first = 0; first < total_bands; first += batch_bands) {
+    int last = std::min(first + batch_bands, total_bands);
 
-  // Take the meshes of the ceiling and floor and change the indices to match
-  // the new ones, by applying offsets and translations
-  size_t ceil_offset = total_nodes;
-  size_t floor_offset = total_nodes + nodes.size() - boundary_sz;
+    std::vector<std::vector<Point3>> nodes(last - first);
+    std::vector<std::vector<IndexTriangle>> band_triangles(last - first);
 
-  std::vector<IndexTriangle> mesh_ceil = ceiling.getMesh(ceil_offset);
-  std::vector<IndexTriangle> mesh_floor = floor.getMesh(floor_offset);
+    #pragma omp parallel for schedule(dynamic) shared(lattice, layout, nodes, band_triangles)
+    for (int i = first; i < last; ++i) {
+      CeilingBand band;
+      createCeilingBand(lattice, i, band);
 
-  #pragma omp parallel for schedule(guided) shared(mesh_ceil, mesh_floor)
-  for (int i = 0; i < (int) mesh_ceil.size(); ++i) {
-    processTriangle(boundaries, tr_floor, ceil_offset, nodes_z - 1, mesh_ceil[i]);
-    processTriangle(boundaries, tr_floor, floor_offset, 0, mesh_floor[i]);
+      mergeBand(band, i, layout, floor, triangles, nodes[i - first], band_triangles[i - first]);
+    }
+
+    for (int i = 0; i < last - first; ++i) {
+      if (triangles)
+        sink.writeTriangles(band_triangles[i].data(), band_triangles[i].size());
+      else
+        sink.writeNodes(nodes[i].data(), nodes[i].size());
+    }
   }
+}
 
-  // Add all the new triangles to the flat's mesh
-  m_mesh.insert(m_mesh.end(), mesh_ceil.begin(), mesh_ceil.end());
-  m_mesh.insert(m_mesh.end(), mesh_floor.begin(), mesh_floor.end());
+void FlatMesh::mergeBand(const CeilingBand& band, size_t band_idx, const MeshLayout& layout, bool floor,
+                         bool triangles, std::vector<Point3>& nodes, std::vector<IndexTriangle>& band_triangles) const {
+  // Only the nodes or the triangles of either the ceiling or the floor are
+  // taken from the band
+  if (triangles) {
+    band_triangles.resize(band.triangles.size(), IndexTriangle(0, 0, 0));
+    merge(band, band_idx, layout, NULL, NULL, floor? NULL : band_triangles.data(), floor? band_triangles.data() : NULL);
+  }
+  else {
+    nodes.resize(band.keptNodes());
+    merge(band, band_idx, layout, floor? NULL : nodes.data(), floor? nodes.data() : NULL, NULL, NULL);
+  }
 }
 
 void FlatMesh::submesh(size_t a_idx, size_t b_idx, size_t c_idx, size_t d_idx,
-                       bool a_in, bool b_in, bool c_in, bool d_in, bool m_in, Mesh& mesh) {
+                       bool a_in, bool b_in, bool c_in, bool d_in, bool m_in,
+                       std::vector<IndexTriangle>& triangles) {
   // d --- c
   // |  m  |
   // a --- b
@@ -338,45 +780,82 @@ void FlatMesh::submesh(size_t a_idx, size_t b_idx, size_t c_idx, size_t d_idx,
     if (a_in) {
       if (c_in) {
         if (b_in)
-          mesh.addTriangle(IndexTriangle(a_idx, b_idx, c_idx));
+          triangles.push_back(IndexTriangle(a_idx, b_idx, c_idx));
         if (d_in)
-          mesh.addTriangle(IndexTriangle(a_idx, c_idx, d_idx));
+          triangles.push_back(IndexTriangle(a_idx, c_idx, d_idx));
       }
       else if (b_in && d_in)
-        mesh.addTriangle(IndexTriangle(a_idx, b_idx, d_idx));
+        triangles.push_back(IndexTriangle(a_idx, b_idx, d_idx));
     }
     else if (b_in && c_in && d_in)
-      mesh.addTriangle(IndexTriangle(b_idx, c_idx, d_idx));
+      triangles.push_back(IndexTriangle(b_idx, c_idx, d_idx));
+  }
+}
+
+void FlatMesh::submeshRow(const std::vector<size_t>& row_idx, const std::vector<size_t>& current_row_idx,
+                          const std::vector<PointLocation>& mid_loc, std::vector<IndexTriangle>& triangles) {
+  // Create the triangles of each square, using the indices of the previous
+  // and the current rows
+  for (size_t ix = 1; ix < row_idx.size(); ++ix) {
+    size_t a_idx = row_idx[ix - 1];
+    size_t b_idx = row_idx[ix];
+    size_t c_idx = current_row_idx[ix];
+    size_t d_idx = current_row_idx[ix - 1];
+
+    // For each point: Is it inside the polygon?
+    bool a_in = a_idx != std::numeric_limits<size_t>::max();
+    bool b_in = b_idx != std::numeric_limits<size_t>::max();
+    bool c_in = c_idx != std::numeric_limits<size_t>::max();
+    bool d_in = d_idx != std::numeric_limits<size_t>::max();
+    bool m_in = mid_loc[ix - 1] != PointLocation::OUTSIDE;
+
+    submesh(a_idx, b_idx, c_idx, d_idx, a_in, b_in, c_in, d_in, m_in, triangles);
   }
 }
 
-void FlatMesh::processTriangle(const std::vector<size_t>& boundaries,
-                               const std::map<size_t, size_t>& tr_floor, size_t input_offset,
-                               size_t output_offset, IndexTriangle& triangle) {
-  triangle.setI(processTriangleIndex(boundaries, tr_floor, input_offset, output_offset, triangle.getI()));
-  triangle.setJ(processTriangleIndex(boundaries, tr_floor, input_offset, output_offset, triangle.getJ()));
-  triangle.setK(processTriangleIndex(boundaries, tr_floor, input_offset, output_offset, triangle.getK()));
+void FlatMesh::processTriangle(const std::vector<size_t>& remap, IndexTriangle& triangle) {
+  triangle.setI(remap[triangle.getI()]);
+  triangle.setJ(remap[triangle.getJ()]);
+  triangle.setK(remap[triangle.getK()]);
 }
 
-size_t FlatMesh::processTriangleIndex(const std::vector<size_t>& boundaries,
-                                      const std::map<size_t, size_t>& tr_floor, size_t input_offset,
-                                      size_t output_offset, size_t idx) {
-  std::map<size_t, size_t>::const_iterator itm;
+size_t FlatMesh::remapIndices(const std::vector<size_t>& tr_floor, size_t input_offset,
+                              size_t output_offset, std::vector<size_t>& remap) {
+  // Nodes which are not translated keep their relative order, so their new
+  // index is their position minus the number of translated nodes before them.
+  // That number is computed with a prefix sum over fixed size blocks: first the
+  // nodes kept in each block are counted in parallel, then the counts are
+  // accumulated, and finally each block is filled in parallel
+  size_t sz = tr_floor.size();
+  int total_blocks = (sz + REMAP_BLOCK_SIZE - 1) / REMAP_BLOCK_SIZE;
+  std::vector<size_t> block_offsets(total_blocks + 1, 0);
+
+  remap.resize(sz);
+
+  #pragma omp parallel for schedule(static) shared(tr_floor, block_offsets)
+  for (int b = 0; b < total_blocks; ++b) {
+    size_t end = std::min((b + 1) * REMAP_BLOCK_SIZE, sz);
+
+    for (size_t i = b * REMAP_BLOCK_SIZE; i < end; ++i)
+      if (tr_floor[i] == std::numeric_limits<size_t>::max())
+        ++block_offsets[b + 1];
+  }
 
-  // If the index has to be translated, we just use the translation table
-  if ((itm = tr_floor.find(idx - input_offset)) != tr_floor.end())
-    return itm->second + output_offset;
+  for (int b = 0; b < total_blocks; ++b)
+    block_offsets[b + 1] += block_offsets[b];
 
-  // In case it does not have to be translated, we decrement the index as many
-  // times as nodes with smaller indices are in the boundaries of the mesh
-  // This is needed in order to keep the indices of the mesh correct after
-  // deleting the boundary nodes
-  else {
-    size_t i;
-    for (i = 0; i < boundaries.size(); ++i)
-      if (boundaries[i] > idx - input_offset)
-        break;
+  #pragma omp parallel for schedule(static) shared(tr_floor, block_offsets, remap)
+  for (int b = 0; b < total_blocks; ++b) {
+    size_t end = std::min((b + 1) * REMAP_BLOCK_SIZE, sz);
+    size_t kept = block_offsets[b];
 
-    return idx - i;
+    for (size_t i = b * REMAP_BLOCK_SIZE; i < end; ++i) {
+      if (tr_floor[i] == std::numeric_limits<size_t>::max())
+        remap[i] = input_offset + kept++;
+      else
+        remap[i] = tr_floor[i] + output_offset;
+    }
   }
+
+  return block_offsets[total_blocks];
 }
@@ -1,13 +1,266 @@
 #include "FlatMesher/FloorPlan.h"
 #include "FlatMesher/Line2.h"
 #include "FlatMesher/AbortPlanErrorChecker.h"
+#include "FlatMesher/TextWriter.h"
 #include "FlatMesher/Utils.h"
 
-#include <limits>
+#include <algorithm>
 #include <cmath>
+#include <limits>
+#include <utility>
 
 using namespace flat;
 
+namespace {
+
+// Amount of candidates to intersect tested together by checkErrors
+const size_t INTERSECTION_BLOCK_SIZE = 4096;
+
+// Sum used to know the orientation of a ring: it's negative if the points are
+// in CCW order, and positive if they are in CW order
+double orientationSum(const std::vector<Point2>& ring) {
+  size_t sz = ring.size();
+  double total = 0.0;
+
+  for (size_t i = 1; i <= sz; ++i) {
+    const Point2& a = ring[i - 1];
+    const Point2& b = ring[i % sz];
+
+    total += (b.getX() - a.getX()) * (a.getY() + b.getY());
+  }
+
+  return total;
+}
+
+// Winding number of a ring around a point. Not reliable if used for points in
+// the ring
+int windingNumber(const std::vector<Point2>& ring, const Point2& p) {
+  using namespace utils;
+
+  int wn = 0;
+  size_t sz = ring.size();
+
+  for (size_t i = 0; i < sz; ++i) {
+    size_t next = (i+1) % sz;
+    Line2 line(ring[i], ring[next]);
+
+    if (lessEqual(ring[i].getY(), p.getY())) {
+      if (greater(ring[next].getY(), p.getY())) {
+        if (p.isLeft(line))
+          ++wn;
+      }
+    }
+    else {
+      if (lessEqual(ring[next].getY(), p.getY())) {
+        if (p.isRight(line))
+          --wn;
+      }
+    }
+  }
+
+  return wn;
+}
+
+
+typedef std::vector<std::pair<size_t, size_t>> IndexPairs;
+
+// Pairs of segments (i, j), with i < j, whose first nodes are equal. Nodes are
+// sorted by their x coordinate, so only the nodes close to each one in that
+// order need to be compared
+IndexPairs repeatedPoints(const std::vector<Line2>& segments) {
+  using namespace utils;
+
+  size_t sz = segments.size();
+  std::vector<size_t> order(sz);
+  for (size_t i = 0; i < sz; ++i)
+    order[i] = i;
+
+  std::sort(order.begin(), order.end(), [&segments](size_t a, size_t b) {
+    return segments[a].getA().getX() < segments[b].getA().getX();
+  });
+
+  IndexPairs result;
+  for (size_t i = 0; i < sz; ++i) {
+    const Point2& p = segments[order[i]].getA();
+
+    for (size_t j = i + 1; j < sz && areEqual(segments[order[j]].getA().getX(), p.getX()); ++j) {
+      if (p == segments[order[j]].getA())
+        result.push_back(std::make_pair(std::min(order[i], order[j]), std::max(order[i], order[j])));
+    }
+  }
+
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+// Pairs of non consecutive segments (i, j), with i < j, whose boxes overlap,
+// in increasing order. Only they can satisfy Line2::intersects, which is
+// tested later by testCandidates. The box of each segment is put in the cells of a
+// uniform grid that it covers, and only segments that share a cell are tested.
+// The cells are about as large as the average segment, and the grid has at
+// most 4 cells per segment. Finding the candidates takes O(e log e + c) time,
+// where e is the amount of cells covered by the boxes, which is linear in the
+// amount of segments unless there are diagonal segments much longer than the
+// average, and c is the amount of pairs that share a cell. That is linear in
+// the size of the output for plans whose segments are spread evenly, but
+// still O(n^2) in the worst case, when many segments cover the same cells
+// without intersecting (for example, long parallel walls much closer to each
+// other than the average segment length). Boxes are enlarged by a margin,
+// because the test uses tolerances relative to the length of the segments
+IndexPairs intersectionCandidates(const FloorPlan& plan, const std::vector<Line2>& segments) {
+  using namespace utils;
+
+  size_t sz = segments.size();
+  if (sz == 0)
+    return IndexPairs();
+
+  double min_length = std::numeric_limits<double>::max(), total_length = 0.0;
+
+  for (auto i = segments.begin(); i != segments.end(); ++i) {
+    if (greater(i->length(), 0.0))
+      min_length = std::fmin(min_length, i->length());
+    total_length += i->length();
+  }
+
+  double margin = 2 * DOUBLE_EPSILON + 2 * DOUBLE_EPSILON / min_length;
+
+  std::vector<Rectangle> boxes(sz);
+  double left = std::numeric_limits<double>::max(), bottom = left;
+  double right = -left, top = -left;
+
+  for (size_t i = 0; i < sz; ++i) {
+    Rectangle box = segments[i].boundingBox();
+    boxes[i] = Rectangle(box.getTop() + margin, box.getBottom() - margin,
+                         box.getLeft() - margin, box.getRight() + margin);
+
+    left = std::fmin(left, boxes[i].getLeft());
+    right = std::fmax(right, boxes[i].getRight());
+    bottom = std::fmin(bottom, boxes[i].getBottom());
+    top = std::fmax(top, boxes[i].getTop());
+  }
+
+  // The cell size is the average length of the segments, but large enough
+  // that the grid has at most 4 cells per segment
+  double width = right - left, height = top - bottom;
+  double cell = std::fmax(total_length / sz, std::sqrt(width * height / (4.0 * sz)));
+  cell = std::fmax(cell, 2 * margin);
+
+  size_t columns = std::max<size_t>(1, size_t(std::ceil(width / cell)));
+  size_t rows = std::max<size_t>(1, size_t(std::ceil(height / cell)));
+
+  auto column = [&](double x) {
+    return std::min(columns - 1, size_t(std::fmax(0.0, (x - left) / cell)));
+  };
+  auto row = [&](double y) {
+    return std::min(rows - 1, size_t(std::fmax(0.0, (y - bottom) / cell)));
+  };
+
+  // Cells covered by the box of each segment, as (cell, segment). Boxes are
+  // used instead of the cells crossed by the segment itself, because
+  // Line2::intersects holds for parallel segments whose boxes overlap
+  std::vector<std::pair<size_t, size_t>> entries;
+
+  for (size_t i = 0; i < sz; ++i)
+    for (size_t r = row(boxes[i].getBottom()); r <= row(boxes[i].getTop()); ++r)
+      for (size_t c = column(boxes[i].getLeft()); c <= column(boxes[i].getRight()); ++c)
+        entries.push_back(std::make_pair(r * columns + c, i));
+
+  std::sort(entries.begin(), entries.end());
+
+  // Pairs of segments of the same cell whose boxes overlap. A pair that shares
+  // several cells is found in each of them
+  IndexPairs candidates;
+
+  for (size_t first = 0; first < entries.size();) {
+    size_t last = first + 1;
+    while (last < entries.size() && entries[last].first == entries[first].first)
+      ++last;
+
+    for (size_t k = first; k < last; ++k) {
+      size_t i = entries[k].second;
+
+      for (size_t l = k + 1; l < last; ++l) {
+        size_t j = entries[l].second;
+
+        if (boxes[j].getBottom() <= boxes[i].getTop() && boxes[i].getBottom() <= boxes[j].getTop() &&
+            boxes[j].getLeft() <= boxes[i].getRight() && boxes[i].getLeft() <= boxes[j].getRight() &&
+            j != plan.nextSegment(i) && i != plan.nextSegment(j))
+          candidates.push_back(std::make_pair(i, j));
+      }
+    }
+
+    first = last;
+  }
+
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+  return candidates;
+}
+
+// Tells which of the candidates from 'first' to 'last' intersect. The exact
+// test is the expensive part, so it's done in parallel
+void testCandidates(const std::vector<Line2>& segments, const IndexPairs& candidates, size_t first, size_t last,
+                    std::vector<char>& intersect) {
+  int sz = last - first;
+
+  #pragma omp parallel for schedule(dynamic, 256) shared(segments, candidates, intersect)
+  for (int i = 0; i < sz; ++i)
+    intersect[first + i] = segments[candidates[first + i].first].intersects(segments[candidates[first + i].second]);
+}
+
+} // anonymous namespace
+
+size_t FloorPlan::segmentCount() const {
+  size_t count = m_nodes.size();
+  for (auto i = m_holes.begin(); i != m_holes.end(); ++i)
+    count += i->size();
+
+  return count;
+}
+
+Line2 FloorPlan::getSegmentAt(size_t index) const {
+  if (index < m_nodes.size())
+    return Line2(m_nodes[index], m_nodes[(index + 1) % m_nodes.size()]);
+
+  index -= m_nodes.size();
+  for (auto i = m_holes.begin(); i != m_holes.end(); ++i) {
+    if (index < i->size())
+      return Line2((*i)[index], (*i)[(index + 1) % i->size()]);
+
+    index -= i->size();
+  }
+
+  return Line2();
+}
+
+std::vector<Line2> FloorPlan::getSegments() const {
+  std::vector<Line2> segments;
+  segments.reserve(segmentCount());
+
+  for (size_t i = 0; i < m_nodes.size(); ++i)
+    segments.push_back(Line2(m_nodes[i], m_nodes[(i + 1) % m_nodes.size()]));
+
+  for (auto i = m_holes.begin(); i != m_holes.end(); ++i)
+    for (size_t j = 0; j < i->size(); ++j)
+      segments.push_back(Line2((*i)[j], (*i)[(j + 1) % i->size()]));
+
+  return segments;
+}
+
+size_t FloorPlan::nextSegment(size_t index) const {
+  // Find the ring of the segment, and go back to its first segment after the
+  // last one
+  size_t first = 0, sz = m_nodes.size();
+
+  for (auto i = m_holes.begin(); i != m_holes.end() && index >= first + sz; ++i) {
+    first += sz;
+    sz = i->size();
+  }
+
+  return index + 1 < first + sz? index + 1 : first;
+}
+
 Rectangle FloorPlan::boundingBox() const {
   double min_x = std::numeric_limits<double>::max();
   double min_y = std::numeric_limits<double>::max();
@@ -27,15 +280,11 @@ Rectangle FloorPlan::boundingBox() const {
 }
 
 double FloorPlan::boundaryLength() const {
-  size_t sz_nodes = m_nodes.size();
+  std::vector<Line2> segments = getSegments();
   double len = 0.0;
 
-  for (size_t i = 0; i < sz_nodes; ++i) {
-    Point2 a = m_nodes[i];
-    Point2 b = m_nodes[(i + 1) % sz_nodes];
-
-    len += a.distance(b) / m_triangle_sz;
-  }
+  for (auto i = segments.begin(); i != segments.end(); ++i)
+    len += i->length() / m_triangle_sz;
 
   return len;
 }
@@ -53,6 +302,10 @@ bool FloorPlan::checkErrors(PlanErrorChecker* checker) const {
   if (sz_nodes < 3 && checker->visitInsufficientNodes(sz_nodes))
     return false;
 
+  for (auto i = m_holes.begin(); i != m_holes.end(); ++i)
+    if (i->size() < 3 && checker->visitInsufficientNodes(i->size()))
+      return false;
+
   // Check if the triangle size is correct
   if (lessEqual(m_triangle_sz, 0.0) && checker->visitInvalidTriangleSize(m_triangle_sz))
     return false;
@@ -64,12 +317,11 @@ bool FloorPlan::checkErrors(PlanErrorChecker* checker) const {
 
   checker->visitCheckSegmentsProperties();
 
-  double total = 0.0;
-  for (size_t i = 1; i <= sz_nodes; ++i) {
-    Point2 a = m_nodes[i - 1];
-    Point2 b = m_nodes[i % sz_nodes];
+  std::vector<Line2> segments = getSegments();
+  size_t sz_segments = segments.size();
 
-    Line2 ab(a, b);
+  for (size_t i = 0; i < sz_segments; ++i) {
+    const Line2& ab = segments[i];
     double slope = ab.slope();
 
     // Check if the segment length is divisible by the triangle size
@@ -82,39 +334,87 @@ bool FloorPlan::checkErrors(PlanErrorChecker* checker) const {
         !isInteger(slope / m_triangle_sz) &&
         checker->visitInvalidSegmentSlope(ab))
       return false;
+  }
 
-    // This sum is used to know if points are in CCW order
-    total += (b.getX() - a.getX()) * (a.getY() + b.getY());
+  // Check if the nodes of the holes are nodes of the lattice of the ceiling,
+  // which starts at the lower left corner of the bounding box and has a node
+  // every triangle size. Otherwise the walls of the holes don't meet the
+  // ceiling and floor at their nodes, and the mesh isn't closed
+  if (greater(m_triangle_sz, 0.0) && !m_nodes.empty()) {
+    Point2 origin = boundingBox().getLowerLeft();
+
+    for (size_t i = 0; i < m_holes.size(); ++i) {
+      for (auto p = m_holes[i].begin(); p != m_holes[i].end(); ++p) {
+        if (!isInteger((p->getX() - origin.getX()) / m_triangle_sz) ||
+            !isInteger((p->getY() - origin.getY()) / m_triangle_sz)) {
+          if (checker->visitHoleOffLattice(i))
+            return false;
+          break;
+        }
+      }
+    }
   }
 
   checker->visitCheckPointsOrder();
 
   // Points are not expressed in CCW order
-  if (greaterEqual(total, 0.0) && checker->visitNotCCWOrder())
+  if (greaterEqual(orientationSum(m_nodes), 0.0) && checker->visitNotCCWOrder())
     return false;
 
+  // Points of the holes are not expressed in CW order
+  for (size_t i = 0; i < m_holes.size(); ++i)
+    if (lessEqual(orientationSum(m_holes[i]), 0.0) && checker->visitHoleNotCWOrder(i))
+      return false;
+
   checker->visitCheckRepeatedPoints();
   checker->visitCheckSegmentsIntersections();
 
-  // Check if there are no repeated points or intersecting segments
-  for (size_t i = 0; i < sz_nodes - 1; ++i) {
-    Line2 a(m_nodes[i], m_nodes[i + 1]);
-
-    for (size_t j = i + 1; j < sz_nodes; ++j)
-      if (m_nodes[i] == m_nodes[j] && checker->visitRepeatedPoint(m_nodes[i]))
+  // Check if there are no repeated points or intersecting segments. The first
+  // node of each segment is the node with the same index of all the rings.
+  // Every pair is found first, and then they are visited in the same order as
+  // comparing every pair of segments would: for each segment, the repeated
+  // points and then the intersections with the segments that go after it.
+  // Consecutive segments are not checked, because they always intersect (they
+  // have a point in common)
+  // The candidates to intersect are tested in blocks as they are reached, so
+  // that a checker which aborts doesn't wait for the rest of them
+  IndexPairs repeated = repeatedPoints(segments);
+  IndexPairs candidates = intersectionCandidates(*this, segments);
+  std::vector<char> intersect(candidates.size(), 0);
+
+  auto r = repeated.begin();
+  size_t s = 0, tested = 0;
+
+  for (size_t i = 0; i + 1 < sz_segments; ++i) {
+    for (; r != repeated.end() && r->first == i; ++r)
+      if (checker->visitRepeatedPoint(segments[i].getA()))
         return false;
 
-    // Don't check consecutive segments, because thay always intersect
-    // (they have a point in common)
-    for (size_t j = i + 2; j < sz_nodes; ++j) {
-      if (i != 0 || j < sz_nodes - 1) {
-        Line2 b(m_nodes[j], m_nodes[(j + 1) % sz_nodes]);
-        if (a.intersects(b) && checker->visitIntersectingSegments(a, b))
-          return false;
+    for (; s < candidates.size() && candidates[s].first == i; ++s) {
+      if (s == tested) {
+        tested = std::min(candidates.size(), tested + INTERSECTION_BLOCK_SIZE);
+        testCandidates(segments, candidates, s, tested, intersect);
       }
+
+      if (intersect[s] && checker->visitIntersectingSegments(segments[i], segments[candidates[s].second]))
+        return false;
     }
   }
 
+  // As no segments intersect, a hole is inside the flat and outside the rest of
+  // holes if any of its nodes is
+  for (size_t i = 0; i < m_holes.size(); ++i) {
+    const Point2& p = m_holes[i].front();
+    bool inside = windingNumber(m_nodes, p) != 0;
+
+    for (size_t j = 0; j < m_holes.size() && inside; ++j)
+      if (j != i && windingNumber(m_holes[j], p) != 0)
+        inside = false;
+
+    if (!inside && checker->visitHoleOutside(i))
+      return false;
+  }
+
   return true;
 }
 
@@ -124,59 +424,45 @@ bool FloorPlan::valid() const {
 }
 
 bool FloorPlan::pointInside(const Point2& p) const {
-  using namespace utils;
-
-  int wn = 0;
-  size_t sz_nodes = m_nodes.size();
-
-  for (size_t i = 0; i < sz_nodes; ++i) {
-    size_t next = (i+1) % sz_nodes;
-    Line2 line(m_nodes[i], m_nodes[next]);
-
-    if (lessEqual(m_nodes[i].getY(), p.getY())) {
-      if (greater(m_nodes[next].getY(), p.getY())) {
-        if (p.isLeft(line))
-          ++wn;
-      }
-    }
-    else {
-      if (lessEqual(m_nodes[next].getY(), p.getY())) {
-        if (p.isRight(line))
-          --wn;
-      }
-    }
-  }
+  // Holes are in CW order, so their winding number cancels the one of the
+  // outer boundary
+  int wn = windingNumber(m_nodes, p);
+  for (auto i = m_holes.begin(); i != m_holes.end(); ++i)
+    wn += windingNumber(*i, p);
 
   return wn != 0;
 }
 
 bool FloorPlan::pointInBoundary(const Point2& p) const {
-  size_t sz_nodes = m_nodes.size();
-  for (size_t i = 0; i < sz_nodes; ++i) {
-    Point2 a = m_nodes[i];
-    Point2 b = m_nodes[(i + 1) % sz_nodes];
-
-    if (Line2(a, b).contains(p))
+  std::vector<Line2> segments = getSegments();
+  for (auto i = segments.begin(); i != segments.end(); ++i)
+    if (i->contains(p))
       return true;
-  }
 
   return false;
 }
 
 std::ostream& operator<<(std::ostream& os, const FloorPlan& fp) {
-  std::vector<Point2> nodes = fp.getNodes();
-
-  std::streamsize prec = os.precision();
-  os.precision(15);
+  ArrayView<Point2> nodes = fp.getNodesView();
+  TextWriter text(os);
 
-  os << nodes.size() << '\n';
+  text << nodes.size() << '\n';
   for (auto i = nodes.begin(); i != nodes.end(); ++i)
-    os << *i << '\n';
+    text << *i << '\n';
+
+  text << fp.getHeight() << '\n';
+  text << fp.getTriangleSize() << '\n';
+
+  // Holes go after the properties of the plan, so that files without them are
+  // still valid
+  ArrayView<std::vector<Point2>> holes = fp.getHolesView();
 
-  os << fp.getHeight() << '\n';
-  os << fp.getTriangleSize() << '\n';
-  
-  os.precision(prec);
+  text << holes.size() << '\n';
+  for (auto i = holes.begin(); i != holes.end(); ++i) {
+    text << i->size() << '\n';
+    for (auto j = i->begin(); j != i->end(); ++j)
+      text << *j << '\n';
+  }
 
   return os;
 }
@@ -193,7 +479,29 @@ std::istream& operator>>(std::istream& is, FloorPlan& fp) {
   is >> height;
   is >> tr_sz;
 
+  // The list of holes can only be missing at the end of the input, so that
+  // plans written before holes were supported can be read. Anything else where
+  // the count of holes should be is an error
+  std::vector<std::vector<Point2>> holes;
+  size_t sz_holes = 0;
+
+  if (is && !(is >> sz_holes)) {
+    if (is.eof() && !is.bad())
+      is.clear(std::ios::eofbit);
+  }
+
+  for (size_t i = 0; i < sz_holes && is; ++i) {
+    is >> sz;
+
+    std::vector<Point2> hole(sz);
+    for (auto j = hole.begin(); j != hole.end(); ++j)
+      is >> *j;
+
+    holes.push_back(hole);
+  }
+
   fp.setNodes(nodes);
+  fp.setHoles(holes);
   fp.setHeight(height);
   fp.setTriangleSize(tr_sz);
 
@@ -0,0 +1,201 @@
+#include "FlatMesher/IncrementalFlatMesh.h"
+#include "FlatMesher/LatticeClassifier.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace flat;
+
+namespace {
+
+// Segments are compared exactly, so that the updated mesh is the same that
+// would be obtained by creating it again
+inline bool sameSegment(const Line2& a, const Line2& b) {
+  return a.getA().getX() == b.getA().getX() && a.getA().getY() == b.getA().getY() &&
+         a.getB().getX() == b.getB().getX() && a.getB().getY() == b.getB().getY();
+}
+
+inline bool sameBox(const Rectangle& a, const Rectangle& b) {
+  return a.getLeft() == b.getLeft() && a.getRight() == b.getRight() &&
+         a.getBottom() == b.getBottom() && a.getTop() == b.getTop();
+}
+
+// Moves an index of a wall triangle from the old position of the walls to the
+// new one. Indices out of the wall belong to the next wall of the ring
+inline size_t shiftIndex(size_t index, size_t first, size_t size, size_t own_shift, size_t next_shift) {
+  return index + (index - first < size? own_shift : next_shift);
+}
+
+} // anonymous namespace
+
+IncrementalFlatMesh::IncrementalFlatMesh(const IncrementalFlatMesh& mesh):
+    FlatMesh(mesh), m_previous(mesh.m_previous), m_bands(mesh.m_bands), m_layout(mesh.m_layout) {
+  if (m_plan != NULL)
+    m_plan = &m_previous;
+}
+
+void IncrementalFlatMesh::createFromPlan(const FloorPlan* plan) {
+  m_nodes.clear();
+  m_mesh.clear();
+  m_bands.clear();
+  m_plan = NULL;
+
+  if (plan == NULL || !plan->valid())
+    return;
+
+  m_previous = *plan;
+  m_plan = &m_previous;
+
+  CeilingLattice lattice(m_previous);
+  createBands(lattice, m_bands);
+  m_layout = createMesh(m_bands);
+
+  if (m_plan == NULL)
+    m_bands.clear();
+}
+
+bool IncrementalFlatMesh::updateFromPlan(const FloorPlan* plan) {
+  if (plan == NULL || !canUpdate(*plan)) {
+    createFromPlan(plan);
+    return false;
+  }
+
+  // Find the segments that changed, and the range of heights that they cover
+  // before and after the change. The rows of the lattice outside of that range
+  // aren't crossed by them, so they are classified the same way
+  size_t plan_sz = plan->segmentCount();
+  std::vector<char> changed(plan_sz, 0);
+  double min_y = std::numeric_limits<double>::max(), max_y = -std::numeric_limits<double>::max();
+
+  for (size_t i = 0; i < plan_sz; ++i) {
+    Line2 before = m_previous.getSegmentAt(i), after = plan->getSegmentAt(i);
+    if (sameSegment(before, after))
+      continue;
+
+    changed[i] = 1;
+    min_y = std::min({min_y, before.getA().getY(), before.getB().getY(), after.getA().getY(), after.getB().getY()});
+    max_y = std::max({max_y, before.getA().getY(), before.getB().getY(), after.getA().getY(), after.getB().getY()});
+  }
+
+  if (std::find(changed.begin(), changed.end(), 1) == changed.end())
+    return true;
+
+  m_previous = *plan;
+  CeilingLattice lattice(m_previous);
+
+  // A margin of a row is left at each side, to account for the tolerances used
+  // when the plan isn't part of the lattice
+  min_y -= lattice.delta;
+  max_y += lattice.delta;
+
+  int total_bands = m_bands.size();
+
+  #pragma omp parallel for schedule(dynamic) shared(lattice)
+  for (int i = 0; i < total_bands; ++i) {
+    size_t first_row = i * lattice.band_rows;
+    size_t start_row = first_row > 0? first_row - 1 : first_row;
+    size_t last_row = std::min(first_row + lattice.band_rows, lattice.rows);
+
+    double first_y = lattice.origin.getY() + (start_row * lattice.delta);
+    double last_y = lattice.origin.getY() + ((last_row - 1) * lattice.delta);
+
+    if (last_y >= min_y && first_y <= max_y) {
+      m_bands[i] = CeilingBand();
+      createCeilingBand(lattice, i, m_bands[i]);
+    }
+  }
+
+  std::vector<size_t> band_nodes(total_bands), band_triangles(total_bands);
+  for (int i = 0; i < total_bands; ++i) {
+    band_nodes[i] = m_bands[i].keptNodes();
+    band_triangles[i] = m_bands[i].triangles.size();
+  }
+
+  // The walls of the segments that changed are created again, and the rest are
+  // moved to their new position. Every band of the ceiling and floor is merged
+  // again, because the indices of the walls and the other bands may change
+  MeshLayout mesh_layout = layout(band_nodes, band_triangles);
+  if (!IndexTriangle::canIndex(mesh_layout.total_nodes)) {
+    createFromPlan(plan);
+    return false;
+  }
+
+  std::vector<Point3> old_nodes;
+  std::vector<IndexTriangle> old_mesh;
+
+  old_nodes.swap(m_nodes);
+  old_mesh.swap(m_mesh);
+  m_nodes.resize(mesh_layout.total_nodes);
+  m_mesh.resize(mesh_layout.total_triangles, IndexTriangle(0, 0, 0));
+
+  #pragma omp parallel shared(mesh_layout, old_nodes, old_mesh, changed)
+  {
+    #pragma omp for schedule(dynamic) nowait
+    for (int i = 0; i < (int) plan_sz; ++i) {
+      size_t first = mesh_layout.wall_offsets[i], size = mesh_layout.wall_offsets[i + 1] - first;
+
+      if (changed[i]) {
+        createWall(mesh_layout, i, 0, size / mesh_layout.nodes_z,
+                   m_nodes.data() + first, m_mesh.data() + mesh_layout.wall_triangle_offsets[i]);
+        continue;
+      }
+
+      size_t old_first = m_layout.wall_offsets[i], next = mesh_layout.next_walls[i];
+      size_t own_shift = first - old_first;
+      size_t next_shift = mesh_layout.wall_offsets[next] - m_layout.wall_offsets[next];
+
+      std::copy(old_nodes.begin() + old_first, old_nodes.begin() + old_first + size, m_nodes.begin() + first);
+
+      auto out = m_mesh.begin() + mesh_layout.wall_triangle_offsets[i];
+      for (size_t t = m_layout.wall_triangle_offsets[i]; t < m_layout.wall_triangle_offsets[i + 1]; ++t) {
+        const IndexTriangle& triangle = old_mesh[t];
+        *out++ = IndexTriangle(shiftIndex(triangle.getI(), old_first, size, own_shift, next_shift),
+                               shiftIndex(triangle.getJ(), old_first, size, own_shift, next_shift),
+                               shiftIndex(triangle.getK(), old_first, size, own_shift, next_shift));
+      }
+    }
+
+    #pragma omp for schedule(dynamic)
+    for (int i = 0; i < total_bands; ++i)
+      mergeBand(m_bands[i], i, mesh_layout);
+  }
+
+  m_layout = mesh_layout;
+  return true;
+}
+
+IncrementalFlatMesh& IncrementalFlatMesh::operator=(const IncrementalFlatMesh& mesh) {
+  FlatMesh::operator=(mesh);
+  m_previous = mesh.m_previous;
+  m_bands = mesh.m_bands;
+  m_layout = mesh.m_layout;
+
+  if (m_plan != NULL)
+    m_plan = &m_previous;
+
+  return *this;
+}
+
+bool IncrementalFlatMesh::canUpdate(const FloorPlan& plan) const {
+  // Graded ceilings depend on the whole plan, so they are always created again
+  if (m_plan == NULL || getGradingLevels() > 0 || !plan.valid())
+    return false;
+
+  if (plan.getHeight() != m_previous.getHeight() || plan.getTriangleSize() != m_previous.getTriangleSize() ||
+      !sameBox(plan.boundingBox(), m_previous.boundingBox()))
+    return false;
+
+  // Segments are matched by their index, so every ring must keep its size
+  size_t sz_holes = plan.getHolesView().size();
+
+  if (plan.getNodesView().size() != m_previous.getNodesView().size() || sz_holes != m_previous.getHolesView().size())
+    return false;
+
+  for (size_t i = 0; i < sz_holes; ++i) {
+    if (plan.getHoleAt(i).size() != m_previous.getHoleAt(i).size())
+      return false;
+  }
+
+  // The lattice must be classified the same way before and after the change
+  return LatticeClassifier(plan).valid() == LatticeClassifier(m_previous).valid();
+}
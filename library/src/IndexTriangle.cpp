@@ -4,6 +4,8 @@
 
 using namespace flat;
 
+const size_t IndexTriangle::MAX_INDEX;
+
 IndexTriangle IndexTriangle::offset(size_t index_offset) const {
   return IndexTriangle(m_i + index_offset, m_j + index_offset, m_k + index_offset);
 }
@@ -19,7 +21,14 @@ std::ostream& operator<<(std::ostream& os, const flat::IndexTriangle& triangle)
 
 std::istream& operator>>(std::istream& is, flat::IndexTriangle& triangle) {
   size_t i, j, k;
-  is >> i >> j >> k;
+  if (!(is >> i >> j >> k))
+    return is;
+
+  // Indices that can't be stored make the input invalid
+  if (i > IndexTriangle::MAX_INDEX || j > IndexTriangle::MAX_INDEX || k > IndexTriangle::MAX_INDEX) {
+    is.setstate(std::ios::failbit);
+    return is;
+  }
 
   triangle.setI(i);
   triangle.setJ(j);
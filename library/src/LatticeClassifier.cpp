@@ -0,0 +1,176 @@
+#include "FlatMesher/LatticeClassifier.h"
+#include "FlatMesher/FloorPlan.h"
+#include "FlatMesher/Utils.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace flat;
+
+namespace {
+
+// Integer divisions rounding towards negative and positive infinity. 'd' must
+// be positive
+inline int64_t floorDiv(int64_t n, int64_t d) {
+  return n >= 0? n / d : -((-n + d - 1) / d);
+}
+
+inline int64_t ceilDiv(int64_t n, int64_t d) {
+  return n >= 0? (n + d - 1) / d : -((-n) / d);
+}
+
+// Amount of points of the row, starting from the first one, for which
+// k * divisor < n holds
+inline size_t prefixCount(int64_t n, int64_t divisor, size_t count) {
+  int64_t end = ceilDiv(n, divisor);
+  return end <= 0? 0 : std::min((size_t) end, count);
+}
+
+} // anonymous namespace
+
+const int64_t LatticeClassifier::MAX_COORDINATE;
+
+LatticeClassifier::LatticeClassifier(const FloorPlan& plan): m_valid(false) {
+  double delta = plan.getTriangleSize();
+  if (!utils::greater(delta, 0.0))
+    return;
+
+  std::vector<Line2> segments = plan.getSegments();
+  size_t sz_segments = segments.size();
+  Point2 origin = plan.boundingBox().getLowerLeft();
+
+  // Convert the ends of every segment to grid coordinates, giving up as soon
+  // as one of them is not part of the grid
+  std::vector<Edge> edges(sz_segments);
+
+  for (size_t i = 0; i < sz_segments; ++i) {
+    Point2 a = segments[i].getA(), b = segments[i].getB();
+
+    double a_x = 2.0 * (a.getX() - origin.getX()) / delta;
+    double a_y = 2.0 * (a.getY() - origin.getY()) / delta;
+    double b_x = 2.0 * (b.getX() - origin.getX()) / delta;
+    double b_y = 2.0 * (b.getY() - origin.getY()) / delta;
+
+    if (!utils::isInteger(a_x) || !utils::isInteger(a_y) || !utils::isInteger(b_x) || !utils::isInteger(b_y) ||
+        std::fmax(a_x, b_x) > MAX_COORDINATE || std::fmax(a_y, b_y) > MAX_COORDINATE)
+      return;
+
+    Edge& edge = edges[i];
+    edge.a_x = llround(a_x);
+    edge.a_y = llround(a_y);
+    edge.b_x = llround(b_x);
+    edge.b_y = llround(b_y);
+
+    // Same amount of columns that FlatMesh::createWall creates
+    edge.columns = lround(segments[i].length() / delta);
+  }
+
+  m_edges.swap(edges);
+  m_valid = true;
+}
+
+void LatticeClassifier::classifyRow(int64_t y, int64_t x0, int64_t step, size_t count,
+                                    std::vector<PointLocation>& result, std::vector<size_t>* boundary_edges) const {
+  result.assign(count, PointLocation::OUTSIDE);
+
+  if (boundary_edges)
+    boundary_edges->assign(count, m_edges.size());
+
+  if (count == 0)
+    return;
+
+  // Winding numbers are accumulated as a difference array. The points of the
+  // row at the left of an edge always form a prefix of the row, so its length
+  // is computed with a single division
+  std::vector<int> diff(count + 1, 0);
+
+  for (size_t i = 0; i < m_edges.size(); ++i) {
+    const Edge& edge = m_edges[i];
+    int64_t dx = edge.b_x - edge.a_x, dy = edge.b_y - edge.a_y;
+
+    // Same crossing rules than FloorPlan::pointInside, without tolerances
+    if (edge.a_y <= y) {
+      if (edge.b_y > y) {
+        size_t end = prefixCount(dx * (y - edge.a_y) - (x0 - edge.a_x) * dy, step * dy, count);
+        diff[0] += 1;
+        diff[end] -= 1;
+      }
+    }
+    else if (edge.b_y <= y) {
+      size_t end = prefixCount(-dx * (y - edge.a_y) + (x0 - edge.a_x) * dy, step * -dy, count);
+      diff[0] -= 1;
+      diff[end] += 1;
+    }
+
+    if (y >= std::min(edge.a_y, edge.b_y) && y <= std::max(edge.a_y, edge.b_y))
+      markBoundary(i, y, x0, step, count, result, boundary_edges);
+  }
+
+  int wn = 0;
+  for (size_t i = 0; i < count; ++i) {
+    wn += diff[i];
+
+    if (result[i] != PointLocation::BOUNDARY && wn != 0)
+      result[i] = PointLocation::INSIDE;
+  }
+}
+
+size_t LatticeClassifier::column(size_t edge_idx, int64_t x, int64_t y) const {
+  const Edge& edge = m_edges[edge_idx];
+
+  // The columns of the wall are evenly spaced along the edge, so the position
+  // of the point along any of the axes in which the edge isn't constant gives
+  // the column, rounded to the nearest one
+  int64_t num, den;
+  if (edge.b_x != edge.a_x) {
+    num = (x - edge.a_x) * (int64_t) edge.columns;
+    den = edge.b_x - edge.a_x;
+  }
+  else {
+    num = (y - edge.a_y) * (int64_t) edge.columns;
+    den = edge.b_y - edge.a_y;
+  }
+
+  if (den < 0) {
+    num = -num;
+    den = -den;
+  }
+
+  return floorDiv(2 * num + den, 2 * den);
+}
+
+void LatticeClassifier::markBoundary(size_t edge_idx, int64_t y, int64_t x0, int64_t step, size_t count,
+                                     std::vector<PointLocation>& result, std::vector<size_t>* boundary_edges) const {
+  const Edge& edge = m_edges[edge_idx];
+  int64_t dx = edge.b_x - edge.a_x, dy = edge.b_y - edge.a_y;
+
+  // Range of indices of the row that are part of the edge
+  int64_t first, last;
+
+  if (dy == 0) {
+    first = ceilDiv(std::min(edge.a_x, edge.b_x) - x0, step);
+    last = floorDiv(std::max(edge.a_x, edge.b_x) - x0, step);
+  }
+  else {
+    // The row crosses the edge at a single point, which may not be part of the
+    // grid or of the row
+    int64_t num = dx * (y - edge.a_y);
+    if (num % dy != 0)
+      return;
+
+    int64_t offset = edge.a_x + num / dy - x0;
+    if (offset % step != 0)
+      return;
+
+    first = last = offset / step;
+  }
+
+  first = std::max(first, (int64_t) 0);
+  last = std::min(last, (int64_t) count - 1);
+
+  for (int64_t k = first; k <= last; ++k) {
+    result[k] = PointLocation::BOUNDARY;
+    if (boundary_edges)
+      (*boundary_edges)[k] = edge_idx;
+  }
+}
@@ -0,0 +1,86 @@
+#include "FlatMesher/MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace flat;
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& file_name):
+    m_data(NULL), m_size(0), m_valid(false), m_file(INVALID_HANDLE_VALUE), m_mapping(NULL) {
+  m_file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                       FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (m_file == INVALID_HANDLE_VALUE)
+    return;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(m_file, &size))
+    return;
+
+  m_size = (size_t) size.QuadPart;
+  if (m_size == 0) {
+    m_valid = true;
+    return;
+  }
+
+  m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (m_mapping == NULL)
+    return;
+
+  m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+  m_valid = m_data != NULL;
+}
+
+MappedFile::~MappedFile() {
+  if (m_data != NULL)
+    UnmapViewOfFile(m_data);
+  if (m_mapping != NULL)
+    CloseHandle(m_mapping);
+  if (m_file != INVALID_HANDLE_VALUE)
+    CloseHandle(m_file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& file_name):
+    m_data(NULL), m_size(0), m_valid(false), m_file(NULL), m_mapping(NULL) {
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+
+  struct stat info;
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+    m_size = info.st_size;
+
+    if (m_size == 0)
+      m_valid = true;
+    else {
+      void* data = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (data != MAP_FAILED) {
+        // Files are parsed from the beginning to the end
+        madvise(data, m_size, MADV_SEQUENTIAL);
+
+        m_data = static_cast<const char*>(data);
+        m_valid = true;
+      }
+    }
+  }
+
+  // The mapping stays valid after closing the file
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (m_data != NULL)
+    munmap(const_cast<char*>(m_data), m_size);
+}
+
+#endif
@@ -0,0 +1,126 @@
+#include "FlatMesher/MappedMesh.h"
+#include "FlatMesher/MappedFile.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace flat;
+
+namespace {
+
+inline bool isAligned(const char* p, size_t alignment) {
+  return reinterpret_cast<uintptr_t>(p) % alignment == 0;
+}
+
+inline double loadDouble(const char* data) {
+  uint64_t bits = FMeshHeader::load(data, 8);
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+
+  return value;
+}
+
+} // anonymous namespace
+
+MappedMesh::MappedMesh(const std::string& file_name):
+  m_file(new MappedFile(file_name)), m_data(NULL), m_valid(false), m_zero_copy(false) {
+  if (m_file->valid())
+    load(m_file->data(), m_file->size());
+}
+
+MappedMesh::MappedMesh(const char* data, size_t size):
+  m_data(NULL), m_valid(false), m_zero_copy(false) {
+  load(data, size);
+}
+
+MappedMesh::~MappedMesh() = default;
+
+bool MappedMesh::verify() const {
+  if (!m_valid)
+    return false;
+
+  if (hasChecksum()) {
+    uint64_t checksum = FMeshHeader::checksum(m_data, m_header.checksum_offset);
+    if (checksum != FMeshHeader::load(m_data + m_header.checksum_offset, sizeof(uint64_t)))
+      return false;
+  }
+
+  // Indices are compared as read from the file, so that wide indices that
+  // don't fit in index_t can't pass for valid ones. They are checked in parts,
+  // so that the loop counter can't overflow
+  const char* indices = m_data + m_header.triangles_offset;
+  size_t index_bytes = m_header.indexBytes();
+  size_t total_indices = 3 * m_header.total_triangles;
+  const size_t PART_SIZE = 65536;
+  int total_parts = (total_indices + PART_SIZE - 1) / PART_SIZE;
+  uint64_t total_nodes = m_header.total_nodes;
+  bool valid = true;
+
+  #pragma omp parallel for schedule(static) reduction(&&: valid)
+  for (int p = 0; p < total_parts; ++p) {
+    size_t last = std::min((p + 1) * PART_SIZE, total_indices);
+
+    for (size_t i = p * PART_SIZE; i < last && valid; ++i)
+      valid = FMeshHeader::load(indices + i * index_bytes, index_bytes) < total_nodes;
+  }
+
+  return valid;
+}
+
+void MappedMesh::load(const char* data, size_t size) {
+  m_data = data;
+
+  if (!m_header.read(data, size) || !IndexTriangle::canIndex(m_header.total_nodes))
+    return;
+
+  size_t total_nodes = m_header.total_nodes, total_triangles = m_header.total_triangles;
+  size_t index_bytes = m_header.indexBytes();
+  const char* nodes = data + m_header.nodes_offset;
+  const char* triangles = data + m_header.triangles_offset;
+  const char* groups = data + m_header.groups_offset;
+
+  // Mapped files start at a page, and the arrays are aligned within the file,
+  // so only data given in memory may be misaligned
+  m_zero_copy = FMeshHeader::hostIsLittleEndian() && sizeof(Point3) == 3 * sizeof(double) &&
+                sizeof(IndexTriangle) == 3 * sizeof(index_t) && index_bytes == sizeof(index_t) &&
+                isAligned(nodes, alignof(Point3)) && isAligned(triangles, alignof(IndexTriangle)) &&
+                isAligned(groups, alignof(uint32_t));
+
+  if (m_zero_copy) {
+    m_nodes = ArrayView<Point3>(reinterpret_cast<const Point3*>(nodes), total_nodes);
+    m_mesh = ArrayView<IndexTriangle>(reinterpret_cast<const IndexTriangle*>(triangles), total_triangles);
+    if (hasGroups())
+      m_groups = ArrayView<uint32_t>(reinterpret_cast<const uint32_t*>(groups), total_triangles);
+  }
+  else {
+    m_node_copy.resize(total_nodes);
+    for (size_t i = 0; i < total_nodes; ++i, nodes += 3 * sizeof(double))
+      m_node_copy[i] = Point3(loadDouble(nodes), loadDouble(nodes + sizeof(double)),
+                              loadDouble(nodes + 2 * sizeof(double)));
+
+    // Wide indices that don't fit in index_t can't be copied, so the file is
+    // rejected here instead of waiting for verify
+    m_mesh_copy.assign(total_triangles, IndexTriangle(0, 0, 0));
+    for (size_t i = 0; i < total_triangles; ++i, triangles += 3 * index_bytes) {
+      uint64_t a = FMeshHeader::load(triangles, index_bytes);
+      uint64_t b = FMeshHeader::load(triangles + index_bytes, index_bytes);
+      uint64_t c = FMeshHeader::load(triangles + 2 * index_bytes, index_bytes);
+      if (a > IndexTriangle::MAX_INDEX || b > IndexTriangle::MAX_INDEX || c > IndexTriangle::MAX_INDEX)
+        return;
+
+      m_mesh_copy[i] = IndexTriangle(a, b, c);
+    }
+
+    if (hasGroups()) {
+      m_group_copy.resize(total_triangles);
+      for (size_t i = 0; i < total_triangles; ++i)
+        m_group_copy[i] = (uint32_t) FMeshHeader::load(groups + i * sizeof(uint32_t), sizeof(uint32_t));
+    }
+
+    m_nodes = m_node_copy;
+    m_mesh = m_mesh_copy;
+    m_groups = m_group_copy;
+  }
+
+  m_valid = true;
+}
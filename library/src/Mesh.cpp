@@ -1,4 +1,10 @@
 #include "FlatMesher/Mesh.h"
+#include "FlatMesher/NodeArrays.h"
+#include "FlatMesher/NodeGrid.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
 
 using namespace flat;
 
@@ -6,11 +12,8 @@ std::vector<IndexTriangle> Mesh::getMesh(size_t index_offset) const {
   if (index_offset == 0)
     return m_mesh;
 
-  std::vector<IndexTriangle> copy;
-  copy.reserve(m_mesh.size());
-
-  for (auto i = m_mesh.begin(); i != m_mesh.end(); ++i)
-    copy.push_back(i->offset(index_offset));
+  std::vector<IndexTriangle> copy(m_mesh.size(), IndexTriangle(0, 0, 0));
+  getMeshView(index_offset).copy(0, m_mesh.size(), copy.data());
 
   return copy;
 }
@@ -20,6 +23,11 @@ void Mesh::setMesh(const std::vector<Point3>& nodes, const std::vector<IndexTria
   m_mesh = edges;
 }
 
+void Mesh::setMesh(std::vector<Point3>&& nodes, std::vector<IndexTriangle>&& edges) {
+  m_nodes = std::move(nodes);
+  m_mesh = std::move(edges);
+}
+
 size_t Mesh::addNode(const Point3& node) {
   m_nodes.push_back(node);
   return m_nodes.size() - 1;
@@ -32,13 +40,81 @@ void Mesh::addTriangle(const IndexTriangle& triangle) {
     m_mesh.push_back(triangle);
 }
 
+void Mesh::setNodes(const NodeArrays& nodes) {
+  m_nodes.resize(nodes.size());
+  nodes.toPoints(m_nodes.data());
+}
+
 void Mesh::move(double x, double y, double z) {
-  Point3 translation(x, y, z);
-  for (auto i = m_nodes.begin(); i != m_nodes.end(); ++i)
-    *i = *i + translation;
+  int sz_nodes = m_nodes.size();
+
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < sz_nodes; ++i) {
+    Point3& node = m_nodes[i];
+    node.setX(node.getX() + x);
+    node.setY(node.getY() + y);
+    node.setZ(node.getZ() + z);
+  }
 }
 
 void Mesh::invert() {
   for (auto i = m_mesh.begin(); i != m_mesh.end(); ++i)
     i->invertRotation();
 }
+
+void Mesh::append(const Mesh& mesh) {
+  size_t offset = m_nodes.size();
+  if (!IndexTriangle::canIndex(offset + mesh.m_nodes.size()))
+    return;
+
+  m_nodes.insert(m_nodes.end(), mesh.m_nodes.begin(), mesh.m_nodes.end());
+
+  size_t first = m_mesh.size(), count = mesh.m_mesh.size();
+  m_mesh.resize(first + count, IndexTriangle(0, 0, 0));
+  mesh.getMeshView(offset).copy(0, count, m_mesh.data() + first);
+}
+
+size_t Mesh::weld(double epsilon) {
+  size_t sz_nodes = m_nodes.size();
+
+  // Nodes are looked up in a spatial hash of the ones kept so far, which are
+  // moved to the front of the array
+  NodeGrid grid(epsilon);
+  grid.reserve(sz_nodes);
+
+  std::vector<size_t> remap(sz_nodes);
+  size_t kept = 0;
+
+  for (size_t i = 0; i < sz_nodes; ++i) {
+    size_t equal = grid.find(m_nodes[i]);
+
+    if (equal == std::numeric_limits<size_t>::max()) {
+      grid.insert(m_nodes[i], kept);
+      m_nodes[kept] = m_nodes[i];
+      remap[i] = kept++;
+    }
+    else
+      remap[i] = equal;
+  }
+
+  m_nodes.resize(kept);
+
+  int sz_triangles = m_mesh.size();
+
+  #pragma omp parallel for schedule(static) shared(remap)
+  for (int i = 0; i < sz_triangles; ++i) {
+    const IndexTriangle& t = m_mesh[i];
+    m_mesh[i] = IndexTriangle(remap[t.getI()], remap[t.getJ()], remap[t.getK()]);
+  }
+
+  m_mesh.erase(std::remove_if(m_mesh.begin(), m_mesh.end(), [](const IndexTriangle& t) {
+    return t.getI() == t.getJ() || t.getJ() == t.getK() || t.getK() == t.getI();
+  }), m_mesh.end());
+
+  return sz_nodes - kept;
+}
+
+void Mesh::merge(const Mesh& mesh, double epsilon) {
+  append(mesh);
+  weld(epsilon);
+}
@@ -0,0 +1,391 @@
+#include "FlatMesher/MeshCache.h"
+#include "FlatMesher/FlatMesh.h"
+#include "FlatMesher/FloorPlan.h"
+#include "FlatMesher/IndexTriangle.h"
+#include "FlatMesher/MeshSink.h"
+#include "FlatMesher/Point3.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+using namespace flat;
+
+namespace {
+
+const char ENTRY_MAGIC[8] = {'F', 'M', 'C', 'A', 'C', 'H', 'E', '1'};
+const char* INDEX_FILE_NAME = "index";
+
+template <class T>
+inline void writeValue(std::ostream& os, T value) {
+  os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <class T>
+inline bool readValue(std::istream& is, T& value) {
+  return (bool) is.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+inline void appendValue(std::string& str, uint64_t value) {
+  str.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+inline void appendValue(std::string& str, double value) {
+  // Both zeros must give the same key
+  if (value == 0.0)
+    value = 0.0;
+
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  appendValue(str, bits);
+}
+
+void appendRing(std::string& str, ArrayView<Point2> ring) {
+  appendValue(str, (uint64_t) ring.size());
+  for (auto i = ring.begin(); i != ring.end(); ++i) {
+    appendValue(str, i->getX());
+    appendValue(str, i->getY());
+  }
+}
+
+// Passes the mesh to another sink while writing it into a cache entry. The
+// entry is written to a temporary file, which is renamed when it's complete
+class EntryWriter: public MeshSink {
+public:
+  EntryWriter(MeshSink& sink, const std::string& path, const std::string& key):
+    m_sink(sink), m_path(path), m_tmp_path(path + ".tmp"), m_key(key), m_wide(false), m_size(0) {}
+  virtual ~EntryWriter() = default;
+
+  virtual void onBegin(size_t total_nodes, size_t total_triangles) {
+    m_sink.onBegin(total_nodes, total_triangles);
+
+    // Indices are stored with 32 bits whenever they fit
+    m_wide = total_nodes > std::numeric_limits<uint32_t>::max();
+    m_os.open(m_tmp_path.c_str(), std::ios::binary | std::ios::trunc);
+
+    if (m_os) {
+      m_os.write(ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+      writeValue(m_os, (uint64_t) m_key.size());
+      m_os.write(m_key.data(), m_key.size());
+      writeValue(m_os, (uint64_t) total_nodes);
+      writeValue(m_os, (uint64_t) total_triangles);
+      writeValue(m_os, (uint8_t) (m_wide? 8 : 4));
+    }
+  }
+
+  virtual void onNodes(const Point3* nodes, size_t count) {
+    m_sink.onNodes(nodes, count);
+
+    if (m_os) {
+      std::vector<double> buffer(3 * count);
+      for (size_t i = 0; i < count; ++i) {
+        buffer[3 * i] = nodes[i].getX();
+        buffer[3 * i + 1] = nodes[i].getY();
+        buffer[3 * i + 2] = nodes[i].getZ();
+      }
+
+      m_os.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(double));
+    }
+  }
+
+  virtual void onTriangles(const IndexTriangle* triangles, size_t count) {
+    m_sink.onTriangles(triangles, count);
+
+    if (m_os) {
+      if (m_wide)
+        writeIndices<uint64_t>(triangles, count);
+      else
+        writeIndices<uint32_t>(triangles, count);
+    }
+  }
+
+  virtual void onEnd() {
+    m_sink.onEnd();
+
+    if (m_os) {
+      m_size = m_os.tellp();
+      m_os.close();
+    }
+
+    if (!m_os) {
+      m_size = 0;
+      std::remove(m_tmp_path.c_str());
+      return;
+    }
+
+    std::remove(m_path.c_str());
+    if (std::rename(m_tmp_path.c_str(), m_path.c_str()) != 0) {
+      m_size = 0;
+      std::remove(m_tmp_path.c_str());
+    }
+  }
+
+  // Size of the entry, or 0 if it couldn't be written
+  uint64_t size() const { return m_size; }
+
+private:
+  template <class T>
+  void writeIndices(const IndexTriangle* triangles, size_t count) {
+    std::vector<T> buffer(3 * count);
+    for (size_t i = 0; i < count; ++i) {
+      buffer[3 * i] = triangles[i].getI();
+      buffer[3 * i + 1] = triangles[i].getJ();
+      buffer[3 * i + 2] = triangles[i].getK();
+    }
+
+    m_os.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(T));
+  }
+
+private:
+  MeshSink& m_sink;
+  std::string m_path, m_tmp_path, m_key;
+  std::ofstream m_os;
+  bool m_wide;
+  uint64_t m_size;
+
+};
+
+// Reads the indices of 'count' triangles, which must refer to the nodes of a
+// mesh of 'total_nodes' nodes
+template <class T>
+bool readIndices(std::istream& is, size_t count, uint64_t total_nodes, std::vector<IndexTriangle>& triangles) {
+  std::vector<T> buffer(3 * count);
+  if (!is.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(T)))
+    return false;
+
+  for (size_t i = 0; i < buffer.size(); ++i)
+    if (buffer[i] >= total_nodes)
+      return false;
+
+  triangles.clear();
+  for (size_t i = 0; i < count; ++i)
+    triangles.push_back(IndexTriangle(buffer[3 * i], buffer[3 * i + 1], buffer[3 * i + 2]));
+
+  return true;
+}
+
+} // anonymous namespace
+
+const uint64_t MeshCache::DEFAULT_MAX_SIZE;
+
+MeshCache::MeshCache(const std::string& directory, uint64_t max_size):
+  m_directory(directory), m_max_size(max_size) {}
+
+MeshCache::Result MeshCache::createFromPlan(const FloorPlan* plan, FlatMesh& mesh, MeshSink& sink) const {
+  if (plan == NULL || !plan->valid())
+    return Result::FAILED;
+
+  std::string plan_key = key(*plan, mesh);
+
+  char name[17];
+  std::snprintf(name, sizeof(name), "%016llx", (unsigned long long) hash(plan_key));
+
+  Result result = load(name, plan_key, sink);
+  if (result != Result::CREATED)
+    return result;
+
+  EntryWriter writer(sink, entryPath(name), plan_key);
+  mesh.createFromPlan(plan, writer);
+
+  if (writer.size() > 0)
+    touch(name, writer.size());
+
+  return Result::CREATED;
+}
+
+std::string MeshCache::key(const FloorPlan& plan, const FlatMesh& mesh) {
+  // The memory budget doesn't change the mesh, so it's not part of the key
+  std::string result("FlatMesher mesh 1");
+
+  appendValue(result, plan.getHeight());
+  appendValue(result, plan.getTriangleSize());
+  appendValue(result, (uint64_t) mesh.getGradingLevels());
+
+  appendRing(result, plan.getNodesView());
+
+  ArrayView<std::vector<Point2>> holes = plan.getHolesView();
+  appendValue(result, (uint64_t) holes.size());
+  for (auto i = holes.begin(); i != holes.end(); ++i)
+    appendRing(result, *i);
+
+  return result;
+}
+
+uint64_t MeshCache::hash(const std::string& key) {
+  // 64-bit FNV-1a
+  uint64_t result = 14695981039346656037ULL;
+  for (auto i = key.begin(); i != key.end(); ++i) {
+    result ^= (unsigned char) *i;
+    result *= 1099511628211ULL;
+  }
+
+  return result;
+}
+
+std::string MeshCache::entryPath(const std::string& name) const {
+  if (m_directory.empty())
+    return name;
+
+  char last = m_directory[m_directory.size() - 1];
+  return m_directory + (last == '/' || last == '\\'? "" : "/") + name;
+}
+
+MeshCache::Result MeshCache::load(const std::string& name, const std::string& key, MeshSink& sink) const {
+  std::ifstream is(entryPath(name).c_str(), std::ios::binary);
+  if (!is.is_open())
+    return Result::CREATED;
+
+  // The key is stored in the entry, so that different plans with the same hash
+  // are told apart
+  char magic[sizeof(ENTRY_MAGIC)];
+  uint64_t key_size, total_nodes, total_triangles;
+  uint8_t index_bytes;
+
+  if (!is.read(magic, sizeof(magic)) || std::memcmp(magic, ENTRY_MAGIC, sizeof(magic)) != 0 ||
+      !readValue(is, key_size) || key_size != key.size())
+    return Result::CREATED;
+
+  std::string entry_key(key_size, '\0');
+  if (!is.read(&entry_key[0], key_size) || entry_key != key ||
+      !readValue(is, total_nodes) || !readValue(is, total_triangles) || !readValue(is, index_bytes) ||
+      (index_bytes != 4 && index_bytes != 8) || !IndexTriangle::canIndex(total_nodes))
+    return Result::CREATED;
+
+  // The size of the entry is checked before passing anything to the sink, so
+  // that a truncated entry is treated as missing
+  uint64_t data_start = is.tellg();
+  is.seekg(0, std::ios::end);
+  uint64_t entry_size = is.tellg();
+
+  if (!is || total_nodes > entry_size / (3 * sizeof(double)) || total_triangles > entry_size / (3 * index_bytes) ||
+      entry_size != data_start + total_nodes * 3 * sizeof(double) + total_triangles * 3 * index_bytes)
+    return Result::CREATED;
+
+  is.seekg(data_start);
+  if (!is)
+    return Result::CREATED;
+
+  sink.onBegin(total_nodes, total_triangles);
+
+  // From here on, the sink has received part of the mesh, so a failure can't
+  // be undone. The entry is removed, and the caller is told that the output
+  // is incomplete
+  std::vector<double> buffer;
+  std::vector<Point3> nodes;
+
+  for (uint64_t i = 0; i < total_nodes; i += MeshSink::CHUNK_SIZE) {
+    size_t count = std::min(total_nodes - i, (uint64_t) MeshSink::CHUNK_SIZE);
+    buffer.resize(3 * count);
+
+    if (!is.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(double))) {
+      erase(name);
+      return Result::FAILED;
+    }
+
+    nodes.clear();
+    for (size_t j = 0; j < count; ++j)
+      nodes.push_back(Point3(buffer[3 * j], buffer[3 * j + 1], buffer[3 * j + 2]));
+
+    sink.onNodes(nodes.data(), count);
+  }
+
+  std::vector<IndexTriangle> triangles;
+
+  for (uint64_t i = 0; i < total_triangles; i += MeshSink::CHUNK_SIZE) {
+    size_t count = std::min(total_triangles - i, (uint64_t) MeshSink::CHUNK_SIZE);
+
+    bool valid = index_bytes == 8? readIndices<uint64_t>(is, count, total_nodes, triangles) :
+                                   readIndices<uint32_t>(is, count, total_nodes, triangles);
+    if (!valid) {
+      erase(name);
+      return Result::FAILED;
+    }
+
+    sink.onTriangles(triangles.data(), count);
+  }
+
+  sink.onEnd();
+  touch(name, entry_size);
+
+  return Result::CACHED;
+}
+
+MeshCache::Index MeshCache::readIndex() const {
+  Index result;
+  std::ifstream is(entryPath(INDEX_FILE_NAME).c_str());
+
+  std::string name;
+  uint64_t size;
+
+  while (is >> name >> size)
+    result.push_back(std::make_pair(name, size));
+
+  return result;
+}
+
+void MeshCache::writeIndex(const Index& index) const {
+  std::string path = entryPath(INDEX_FILE_NAME), tmp_path = path + ".tmp";
+
+  {
+    std::ofstream os(tmp_path.c_str(), std::ios::trunc);
+    for (auto i = index.begin(); i != index.end(); ++i)
+      os << i->first << ' ' << i->second << '\n';
+
+    if (!os) {
+      os.close();
+      std::remove(tmp_path.c_str());
+      return;
+    }
+  }
+
+  std::remove(path.c_str());
+  std::rename(tmp_path.c_str(), path.c_str());
+}
+
+void MeshCache::touch(const std::string& name, uint64_t size) const {
+  Index index = readIndex();
+
+  // The entry is moved to the end of the index, as the most recently used
+  uint64_t total = 0;
+  for (auto i = index.begin(); i != index.end();) {
+    if (i->first == name)
+      i = index.erase(i);
+    else
+      total += (i++)->second;
+  }
+
+  // Meshes bigger than the whole cache are not kept, instead of removing every
+  // other mesh to make room for them
+  if (size > m_max_size)
+    std::remove(entryPath(name).c_str());
+  else {
+    index.push_back(std::make_pair(name, size));
+    total += size;
+  }
+
+  // Remove the least recently used entries until the cache fits in its limit
+  Index::iterator first = index.begin();
+  for (; first != index.end() && total > m_max_size; ++first) {
+    std::remove(entryPath(first->first).c_str());
+    total -= first->second;
+  }
+
+  index.erase(index.begin(), first);
+  writeIndex(index);
+}
+
+void MeshCache::erase(const std::string& name) const {
+  std::remove(entryPath(name).c_str());
+
+  Index index = readIndex();
+  for (auto i = index.begin(); i != index.end();) {
+    if (i->first == name)
+      i = index.erase(i);
+    else
+      ++i;
+  }
+
+  writeIndex(index);
+}
@@ -0,0 +1,20 @@
+#include "FlatMesher/MeshFormatter.h"
+#include "FlatMesher/Mesh.h"
+
+#include <fstream>
+
+using namespace flat;
+
+bool MeshFormatter::readMeshFile(const std::string& file_name, Mesh& mesh) const {
+  std::ifstream file(file_name.c_str(), std::ios::binary);
+  if (!file)
+    return false;
+
+  // The mesh is read into a copy, so that it's unchanged when there's an error
+  Mesh result;
+  if (!readMesh(file, result))
+    return false;
+
+  mesh = result;
+  return true;
+}
@@ -0,0 +1,41 @@
+#include "FlatMesher/MeshSink.h"
+#include "FlatMesher/Mesh.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace flat;
+
+const size_t MeshSink::CHUNK_SIZE;
+
+void MeshSink::writeNodes(const Point3* nodes, size_t count) {
+  for (size_t i = 0; i < count; i += CHUNK_SIZE)
+    onNodes(nodes + i, std::min(count - i, CHUNK_SIZE));
+}
+
+void MeshSink::writeTriangles(const IndexTriangle* triangles, size_t count) {
+  for (size_t i = 0; i < count; i += CHUNK_SIZE)
+    onTriangles(triangles + i, std::min(count - i, CHUNK_SIZE));
+}
+
+void MeshSink::writeTriangles(const OffsetTriangleView& triangles) {
+  // The shifted triangles are only created one chunk at a time
+  size_t count = triangles.size();
+  std::vector<IndexTriangle> chunk(std::min(count, CHUNK_SIZE), IndexTriangle(0, 0, 0));
+
+  for (size_t i = 0; i < count; i += CHUNK_SIZE) {
+    size_t chunk_sz = std::min(count - i, CHUNK_SIZE);
+    triangles.copy(i, chunk_sz, chunk.data());
+    onTriangles(chunk.data(), chunk_sz);
+  }
+}
+
+void MeshSink::writeMesh(const Mesh& mesh) {
+  ArrayView<Point3> nodes = mesh.getNodesView();
+  ArrayView<IndexTriangle> triangles = mesh.getMeshView();
+
+  onBegin(nodes.size(), triangles.size());
+  writeNodes(nodes.data(), nodes.size());
+  writeTriangles(triangles.data(), triangles.size());
+  onEnd();
+}
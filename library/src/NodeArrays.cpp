@@ -0,0 +1,235 @@
+#include "FlatMesher/NodeArrays.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+using namespace flat;
+
+const size_t NodeArrays::ALIGNMENT;
+const size_t NodeArrays::BLOCK_SIZE;
+
+NodeArrays::NodeArrays(const std::vector<Point3>& nodes): m_size(0), m_stride(0), m_offset(0) {
+  assign(nodes.data(), nodes.size());
+}
+
+NodeArrays::NodeArrays(const Point3* nodes, size_t count): m_size(0), m_stride(0), m_offset(0) {
+  assign(nodes, count);
+}
+
+NodeArrays::NodeArrays(const NodeArrays& nodes): m_size(0), m_stride(0), m_offset(0) {
+  *this = nodes;
+}
+
+void NodeArrays::resize(size_t size) {
+  // A new buffer is always allocated, because the offset that aligns the
+  // arrays depends on the address of the buffer
+  size_t stride = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  std::vector<double> buffer(3 * stride + ALIGNMENT, 0.0);
+
+  size_t misalignment = (uintptr_t) buffer.data() % (ALIGNMENT * sizeof(double));
+  size_t offset = misalignment == 0? 0 : ALIGNMENT - misalignment / sizeof(double);
+
+  size_t kept = std::min(size, m_size);
+  for (size_t i = 0; i < 3; ++i)
+    std::copy(getX() + i * m_stride, getX() + i * m_stride + kept, buffer.data() + offset + i * stride);
+
+  m_buffer.swap(buffer);
+  m_size = size;
+  m_stride = stride;
+  m_offset = offset;
+}
+
+Point3 NodeArrays::getNodeAt(size_t index) const {
+  return Point3(getX()[index], getY()[index], getZ()[index]);
+}
+
+void NodeArrays::setNodeAt(size_t index, const Point3& node) {
+  getX()[index] = node.getX();
+  getY()[index] = node.getY();
+  getZ()[index] = node.getZ();
+}
+
+void NodeArrays::assign(const Point3* nodes, size_t count) {
+  if (count != m_size)
+    resize(count);
+
+  double* xs = getX();
+  double* ys = getY();
+  double* zs = getZ();
+  int total_blocks = blocks(count);
+
+  #pragma omp parallel for schedule(static)
+  for (int b = 0; b < total_blocks; ++b) {
+    size_t last = std::min((b + 1) * BLOCK_SIZE, count);
+
+    for (size_t i = b * BLOCK_SIZE; i < last; ++i) {
+      xs[i] = nodes[i].getX();
+      ys[i] = nodes[i].getY();
+      zs[i] = nodes[i].getZ();
+    }
+  }
+}
+
+void NodeArrays::toPoints(Point3* nodes) const {
+  const double* xs = getX();
+  const double* ys = getY();
+  const double* zs = getZ();
+  int total_blocks = blocks(m_size);
+
+  #pragma omp parallel for schedule(static)
+  for (int b = 0; b < total_blocks; ++b) {
+    size_t last = std::min((b + 1) * BLOCK_SIZE, m_size);
+
+    for (size_t i = b * BLOCK_SIZE; i < last; ++i)
+      nodes[i] = Point3(xs[i], ys[i], zs[i]);
+  }
+}
+
+std::vector<Point3> NodeArrays::toPoints() const {
+  std::vector<Point3> nodes(m_size);
+  toPoints(nodes.data());
+
+  return nodes;
+}
+
+void NodeArrays::move(double x, double y, double z) {
+  // Each coordinate is a separate array, so every loop is a plain addition of
+  // a constant that is vectorised
+  const double translation[3] = {x, y, z};
+  int total_blocks = blocks(m_size);
+
+  #pragma omp parallel for schedule(static)
+  for (int b = 0; b < total_blocks; ++b) {
+    size_t first = b * BLOCK_SIZE, last = std::min(first + BLOCK_SIZE, m_size);
+
+    for (size_t c = 0; c < 3; ++c) {
+      double* values = getX() + c * m_stride;
+      double delta = translation[c];
+
+      for (size_t i = first; i < last; ++i)
+        values[i] += delta;
+    }
+  }
+}
+
+void NodeArrays::bounds(Point3& lower, Point3& upper) const {
+  if (m_size == 0) {
+    lower = upper = Point3();
+    return;
+  }
+
+  // Each block finds its own bounds, which are then combined in order
+  int total_blocks = blocks(m_size);
+  std::vector<double> block_min(3 * total_blocks), block_max(3 * total_blocks);
+
+  #pragma omp parallel for schedule(static) shared(block_min, block_max)
+  for (int b = 0; b < total_blocks; ++b) {
+    size_t first = b * BLOCK_SIZE, last = std::min(first + BLOCK_SIZE, m_size);
+
+    for (size_t c = 0; c < 3; ++c) {
+      const double* values = getX() + c * m_stride;
+      double min_value = values[first], max_value = values[first];
+
+      for (size_t i = first + 1; i < last; ++i) {
+        min_value = std::min(min_value, values[i]);
+        max_value = std::max(max_value, values[i]);
+      }
+
+      block_min[3 * b + c] = min_value;
+      block_max[3 * b + c] = max_value;
+    }
+  }
+
+  double min_values[3], max_values[3];
+  for (size_t c = 0; c < 3; ++c) {
+    min_values[c] = block_min[c];
+    max_values[c] = block_max[c];
+
+    for (int b = 1; b < total_blocks; ++b) {
+      min_values[c] = std::min(min_values[c], block_min[3 * b + c]);
+      max_values[c] = std::max(max_values[c], block_max[3 * b + c]);
+    }
+  }
+
+  lower = Point3(min_values[0], min_values[1], min_values[2]);
+  upper = Point3(max_values[0], max_values[1], max_values[2]);
+}
+
+void NodeArrays::centroids(const std::vector<IndexTriangle>& triangles, NodeArrays& result) const {
+  size_t sz_triangles = triangles.size();
+  result.resize(sz_triangles);
+
+  const double* xs = getX();
+  const double* ys = getY();
+  const double* zs = getZ();
+  double* cx = result.getX();
+  double* cy = result.getY();
+  double* cz = result.getZ();
+  int total_blocks = blocks(sz_triangles);
+
+  #pragma omp parallel for schedule(static) shared(triangles)
+  for (int b = 0; b < total_blocks; ++b) {
+    size_t last = std::min((b + 1) * BLOCK_SIZE, sz_triangles);
+
+    for (size_t t = b * BLOCK_SIZE; t < last; ++t) {
+      size_t i = triangles[t].getI(), j = triangles[t].getJ(), k = triangles[t].getK();
+
+      cx[t] = (xs[i] + xs[j] + xs[k]) / 3.0;
+      cy[t] = (ys[i] + ys[j] + ys[k]) / 3.0;
+      cz[t] = (zs[i] + zs[j] + zs[k]) / 3.0;
+    }
+  }
+}
+
+void NodeArrays::normals(const std::vector<IndexTriangle>& triangles, NodeArrays& result) const {
+  size_t sz_triangles = triangles.size();
+  result.resize(sz_triangles);
+
+  const double* xs = getX();
+  const double* ys = getY();
+  const double* zs = getZ();
+  double* nx = result.getX();
+  double* ny = result.getY();
+  double* nz = result.getZ();
+  int total_blocks = blocks(sz_triangles);
+
+  // The cross products are written first, and then normalised in a separate
+  // loop over the result, which has no indirect accesses and is vectorised
+  #pragma omp parallel for schedule(static) shared(triangles)
+  for (int b = 0; b < total_blocks; ++b) {
+    size_t first = b * BLOCK_SIZE, last = std::min(first + BLOCK_SIZE, sz_triangles);
+
+    for (size_t t = first; t < last; ++t) {
+      size_t i = triangles[t].getI(), j = triangles[t].getJ(), k = triangles[t].getK();
+
+      double ux = xs[j] - xs[i], uy = ys[j] - ys[i], uz = zs[j] - zs[i];
+      double vx = xs[k] - xs[i], vy = ys[k] - ys[i], vz = zs[k] - zs[i];
+
+      nx[t] = uy * vz - uz * vy;
+      ny[t] = uz * vx - ux * vz;
+      nz[t] = ux * vy - uy * vx;
+    }
+
+    for (size_t t = first; t < last; ++t) {
+      double length = std::sqrt(nx[t] * nx[t] + ny[t] * ny[t] + nz[t] * nz[t]);
+      double scale = length > 0.0? 1.0 / length : 0.0;
+
+      nx[t] *= scale;
+      ny[t] *= scale;
+      nz[t] *= scale;
+    }
+  }
+}
+
+NodeArrays& NodeArrays::operator=(const NodeArrays& nodes) {
+  if (this == &nodes)
+    return *this;
+
+  resize(nodes.m_size);
+  for (size_t i = 0; i < 3; ++i)
+    std::copy(nodes.getX() + i * nodes.m_stride, nodes.getX() + i * nodes.m_stride + m_size,
+              getX() + i * m_stride);
+
+  return *this;
+}
@@ -0,0 +1,92 @@
+#include "FlatMesher/NodeGrid.h"
+
+#include <cmath>
+#include <limits>
+
+using namespace flat;
+
+namespace {
+
+// Size of the cells, relative to the tolerance
+const double CELL_SIZE_FACTOR = 4.0;
+
+} // anonymous namespace
+
+NodeGrid::NodeGrid(double epsilon): m_epsilon(epsilon), m_cell_size(epsilon * CELL_SIZE_FACTOR) {}
+
+void NodeGrid::reserve(size_t nodes) {
+  m_cells.reserve(nodes);
+  m_entries.reserve(nodes);
+}
+
+void NodeGrid::insert(const Point3& node, size_t index) {
+  // Entries of the same cell are linked from the last one inserted
+  uint64_t key = cellKey(cell(node.getX()), cell(node.getY()), cell(node.getZ()));
+  auto head = m_cells.find(key);
+
+  Entry entry = { node, index, std::numeric_limits<size_t>::max() };
+  if (head != m_cells.end()) {
+    entry.next = head->second;
+    head->second = m_entries.size();
+  }
+  else
+    m_cells[key] = m_entries.size();
+
+  m_entries.push_back(entry);
+}
+
+size_t NodeGrid::find(const Point3& node) const {
+  // Only the adjacent cells closer than the tolerance to the node can contain
+  // nodes equal to it, so most nodes are looked up in a single cell
+  int64_t first[3], last[3];
+  double coordinates[3] = { node.getX(), node.getY(), node.getZ() };
+
+  for (int axis = 0; axis < 3; ++axis) {
+    double position = coordinates[axis] / m_cell_size + 0.5;
+    double offset = (position - std::floor(position)) * m_cell_size;
+
+    first[axis] = last[axis] = (int64_t) std::floor(position);
+    if (offset < m_epsilon)
+      --first[axis];
+    if (m_cell_size - offset < m_epsilon)
+      ++last[axis];
+  }
+
+  for (int64_t i = first[0]; i <= last[0]; ++i) {
+    for (int64_t j = first[1]; j <= last[1]; ++j) {
+      for (int64_t k = first[2]; k <= last[2]; ++k) {
+        auto head = m_cells.find(cellKey(i, j, k));
+        if (head == m_cells.end())
+          continue;
+
+        // Different cells may have the same key, so every node is compared
+        for (size_t e = head->second; e != std::numeric_limits<size_t>::max(); e = m_entries[e].next) {
+          const Point3& p = m_entries[e].node;
+
+          if (utils::areEqual(p.getX(), node.getX(), m_epsilon) &&
+              utils::areEqual(p.getY(), node.getY(), m_epsilon) &&
+              utils::areEqual(p.getZ(), node.getZ(), m_epsilon))
+            return m_entries[e].index;
+        }
+      }
+    }
+  }
+
+  return std::numeric_limits<size_t>::max();
+}
+
+int64_t NodeGrid::cell(double coordinate) const {
+  // Cells are centered on the multiples of their size, where the nodes of a
+  // lattice usually are
+  return (int64_t) std::floor(coordinate / m_cell_size + 0.5);
+}
+
+uint64_t NodeGrid::cellKey(int64_t x, int64_t y, int64_t z) {
+  // Nodes of a mesh are usually in a regular lattice, so the coordinates are
+  // mixed well enough for cells at the same distance not to share keys
+  uint64_t key = (uint64_t) x * 0x9E3779B97F4A7C15ULL;
+  key = (key ^ (key >> 32) ^ (uint64_t) y) * 0xC2B2AE3D27D4EB4FULL;
+  key = (key ^ (key >> 29) ^ (uint64_t) z) * 0x165667B19E3779F9ULL;
+
+  return key ^ (key >> 32);
+}
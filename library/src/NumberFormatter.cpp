@@ -0,0 +1,158 @@
+#include "FlatMesher/NumberFormatter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+using namespace flat;
+
+namespace {
+
+// Significant digits written for every double
+const int PRECISION = 15;
+const uint64_t PRECISION_LIMIT = 1000000000000000ULL;
+
+// Powers of 10 that are exactly representable as long doubles, even when they
+// are the same as doubles
+const long double EXACT_POWERS[] = {
+  1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L,
+  1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L
+};
+
+// Lower bounds of the values with each decimal exponent from -4 to 14. Some
+// aren't exact, which is corrected after scaling
+const double EXPONENT_BOUNDS[] = {
+  1e-4, 1e-3, 1e-2, 1e-1, 1e0, 1e1, 1e2, 1e3, 1e4, 1e5,
+  1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14
+};
+
+const char DIGIT_PAIRS[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+// Writes 'value' in the 'digits' characters before 'end'
+void writeDigits(uint64_t value, char* end, int digits) {
+  for (; digits >= 2; digits -= 2) {
+    const char* pair = DIGIT_PAIRS + 2 * (value % 100);
+    value /= 100;
+    *--end = pair[1];
+    *--end = pair[0];
+  }
+
+  if (digits == 1)
+    *--end = char('0' + value % 10);
+}
+
+int countDigits(uint64_t value) {
+  int digits = 1;
+  for (; value >= 10; value /= 10)
+    ++digits;
+
+  return digits;
+}
+
+size_t formatFallback(double value, char* output) {
+  int written = std::snprintf(output, utils::MAX_NUMBER_SIZE, "%.*g", PRECISION, value);
+
+  // The application may have changed the locale of printf, but files always
+  // use a point
+  for (int i = 0; i < written; ++i) {
+    char c = output[i];
+    if (!(c >= '0' && c <= '9') && !(c >= 'a' && c <= 'z') && c != '-' && c != '+')
+      output[i] = '.';
+  }
+
+  return written;
+}
+
+} // anonymous namespace
+
+size_t utils::formatDouble(double value, char* output) {
+  if (!(std::fabs(value) < 1e15) || (value != 0 && std::fabs(value) < 1e-4))
+    return formatFallback(value, output);
+
+  double original = value;
+  char* p = output;
+  if (std::signbit(value)) {
+    *p++ = '-';
+    value = -value;
+  }
+
+  // Integers are written as they are
+  if (value == std::floor(value)) {
+    uint64_t integer = (uint64_t) value;
+    int digits = countDigits(integer);
+    writeDigits(integer, p + digits, digits);
+
+    return p + digits - output;
+  }
+
+  // The value is scaled to have PRECISION digits before the point. The product
+  // of two exact values is rounded once, so its error is below 'margin', and
+  // the rounding to an integer is only ambiguous when the fraction is that
+  // close to 1/2. That is left to the standard library
+  int exponent = int(std::upper_bound(EXPONENT_BOUNDS, EXPONENT_BOUNDS + 19, value) - EXPONENT_BOUNDS) - 5;
+  long double scaled;
+
+  for (;;) {
+    scaled = (long double) value * EXACT_POWERS[PRECISION - 1 - exponent];
+
+    if (scaled >= (long double) PRECISION_LIMIT && exponent < PRECISION - 1)
+      ++exponent;
+    else if (scaled < (long double) (PRECISION_LIMIT / 10) && exponent > -5)
+      --exponent;
+    else
+      break;
+  }
+
+  const long double margin = std::ldexp((long double) 1, 51 - std::numeric_limits<long double>::digits);
+  uint64_t significand = (uint64_t) scaled;
+  long double fraction = scaled - significand;
+
+  if (significand >= PRECISION_LIMIT || significand < PRECISION_LIMIT / 10 ||
+      std::fabs(fraction - 0.5L) < margin)
+    return formatFallback(original, output);
+
+  if (fraction > 0.5L && ++significand == PRECISION_LIMIT) {
+    significand /= 10;
+    ++exponent;
+  }
+
+  // Other exponents need the exponential notation
+  if (exponent < -4 || exponent >= PRECISION)
+    return formatFallback(original, output);
+
+  char digits[PRECISION];
+  writeDigits(significand, digits + PRECISION, PRECISION);
+
+  int significant = PRECISION;
+  while (significant > 1 && digits[significant - 1] == '0')
+    --significant;
+
+  if (exponent >= 0) {
+    int integer_digits = exponent + 1;
+    p = std::copy(digits, digits + integer_digits, p);
+
+    if (significant > integer_digits) {
+      *p++ = '.';
+      p = std::copy(digits + integer_digits, digits + significant, p);
+    }
+  }
+  else {
+    *p++ = '0';
+    *p++ = '.';
+    p = std::fill_n(p, -exponent - 1, '0');
+    p = std::copy(digits, digits + significant, p);
+  }
+
+  return p - output;
+}
+
+size_t utils::formatUnsigned(uint64_t value, char* output) {
+  int digits = countDigits(value);
+  writeDigits(value, output + digits, digits);
+
+  return digits;
+}
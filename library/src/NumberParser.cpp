@@ -0,0 +1,150 @@
+#include "FlatMesher/NumberParser.h"
+
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <string>
+
+using namespace flat;
+
+namespace {
+
+// Powers of 10 that are exactly representable as doubles
+const double EXACT_POWERS[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+const int MAX_EXACT_POWER = 22;
+
+// Mantissas of up to 15 digits are below 2^53, so they are exact as doubles
+const int MAX_EXACT_DIGITS = 15;
+
+inline bool isSpace(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+inline bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+} // anonymous namespace
+
+const char* utils::skipSpaces(const char* begin, const char* end) {
+  while (begin != end && isSpace(*begin))
+    ++begin;
+
+  return begin;
+}
+
+const char* utils::parseDouble(const char* begin, const char* end, double& value) {
+  const char* p = skipSpaces(begin, end);
+  const char* start = p;
+
+  bool negative = false;
+  if (p != end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+
+  // Significant digits are accumulated in 'mantissa', and the position of the
+  // decimal point in 'exponent'. Leading zeros aren't significant
+  uint64_t mantissa = 0;
+  int digits = 0, exponent = 0;
+  bool any_digit = false;
+
+  for (; p != end && isDigit(*p); ++p) {
+    any_digit = true;
+    if (mantissa == 0 && *p == '0')
+      continue;
+
+    if (digits < 19)
+      mantissa = mantissa * 10 + (*p - '0');
+    else
+      ++exponent;
+    ++digits;
+  }
+
+  if (p != end && *p == '.') {
+    for (++p; p != end && isDigit(*p); ++p) {
+      any_digit = true;
+      if (mantissa == 0 && *p == '0') {
+        --exponent;
+        continue;
+      }
+
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        --exponent;
+      }
+      ++digits;
+    }
+  }
+
+  if (!any_digit)
+    return NULL;
+
+  // The exponent is only part of the number if it has digits
+  if (p != end && (*p == 'e' || *p == 'E')) {
+    const char* q = p + 1;
+    bool negative_exp = false;
+
+    if (q != end && (*q == '-' || *q == '+')) {
+      negative_exp = *q == '-';
+      ++q;
+    }
+
+    if (q != end && isDigit(*q)) {
+      int written = 0;
+      for (; q != end && isDigit(*q); ++q) {
+        if (written < 100000)
+          written = written * 10 + (*q - '0');
+      }
+
+      exponent += negative_exp? -written : written;
+      p = q;
+    }
+  }
+
+  if (mantissa == 0) {
+    value = negative? -0.0 : 0.0;
+    return p;
+  }
+
+  if (digits <= MAX_EXACT_DIGITS && exponent >= -MAX_EXACT_POWER && exponent <= MAX_EXACT_POWER) {
+    double result = (double) mantissa;
+    result = exponent < 0? result / EXACT_POWERS[-exponent] : result * EXACT_POWERS[exponent];
+
+    value = negative? -result : result;
+    return p;
+  }
+
+  std::istringstream token(std::string(start, p));
+  token.imbue(std::locale::classic());
+
+  if (!(token >> value))
+    return NULL;
+
+  return p;
+}
+
+const char* utils::parseUnsigned(const char* begin, const char* end, uint64_t& value) {
+  const char* p = skipSpaces(begin, end);
+  if (p != end && *p == '+')
+    ++p;
+
+  if (p == end || !isDigit(*p))
+    return NULL;
+
+  uint64_t result = 0;
+  for (; p != end && isDigit(*p); ++p) {
+    uint64_t digit = *p - '0';
+    if (result > (std::numeric_limits<uint64_t>::max() - digit) / 10)
+      return NULL;
+
+    result = result * 10 + digit;
+  }
+
+  value = result;
+  return p;
+}
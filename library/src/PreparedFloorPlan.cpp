@@ -0,0 +1,90 @@
+#include "FlatMesher/PreparedFloorPlan.h"
+#include "FlatMesher/FloorPlan.h"
+#include "FlatMesher/Utils.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace flat;
+
+namespace {
+
+// Margin added to the vertical extent of each edge, so that every point where
+// the tests with tolerances may give a different result is taken into account
+const double BUCKET_MARGIN = 2 * utils::DOUBLE_EPSILON;
+
+} // anonymous namespace
+
+const size_t PreparedFloorPlan::MAX_BUCKET_SPAN;
+
+PreparedFloorPlan::PreparedFloorPlan(const FloorPlan& plan): m_edges(plan.getSegments()) {
+  Rectangle box = plan.boundingBox();
+  size_t sz_edges = m_edges.size();
+
+  // About one bucket per edge, so that most buckets hold only the edges which
+  // actually cross them
+  size_t sz_buckets = std::max(sz_edges, (size_t) 1);
+  m_bottom = box.getBottom() - BUCKET_MARGIN;
+  m_bucket_height = (box.getHeight() + 2 * BUCKET_MARGIN) / sz_buckets;
+  m_buckets.resize(sz_buckets);
+
+  if (!utils::greater(m_bucket_height, 0.0))
+    m_bucket_height = 1.0;
+
+  for (size_t i = 0; i < sz_edges; ++i) {
+    double a_y = m_edges[i].getA().getY(), b_y = m_edges[i].getB().getY();
+    double first = (std::fmin(a_y, b_y) - BUCKET_MARGIN - m_bottom) / m_bucket_height;
+    double last = (std::fmax(a_y, b_y) + BUCKET_MARGIN - m_bottom) / m_bucket_height;
+
+    size_t first_bucket = std::max(std::floor(first), 0.0);
+    size_t last_bucket = std::min(std::floor(last), (double) sz_buckets - 1);
+
+    if (last_bucket - first_bucket >= MAX_BUCKET_SPAN) {
+      m_long_edges.push_back(i);
+      continue;
+    }
+
+    for (size_t j = first_bucket; j <= last_bucket; ++j)
+      m_buckets[j].push_back(i);
+  }
+}
+
+PointLocation PreparedFloorPlan::classify(const Point2& p) const {
+  using namespace utils;
+
+  // The boundary and the winding number are computed in the same pass over the
+  // edges of the bucket and the long edges. The winding number doesn't depend
+  // on the order of the edges
+  const std::vector<size_t>* lists[2] = { &edgesAt(p.getY()), &m_long_edges };
+  int wn = 0;
+
+  for (int l = 0; l < 2; ++l) {
+    for (auto i = lists[l]->begin(); i != lists[l]->end(); ++i) {
+      const Line2& edge = m_edges[*i];
+      if (edge.contains(p))
+        return PointLocation::BOUNDARY;
+
+      // Same crossing rules than FloorPlan::pointInside
+      if (lessEqual(edge.getA().getY(), p.getY())) {
+        if (greater(edge.getB().getY(), p.getY()) && p.isLeft(edge))
+          ++wn;
+      }
+      else {
+        if (lessEqual(edge.getB().getY(), p.getY()) && p.isRight(edge))
+          --wn;
+      }
+    }
+  }
+
+  return wn != 0? PointLocation::INSIDE : PointLocation::OUTSIDE;
+}
+
+const std::vector<size_t>& PreparedFloorPlan::edgesAt(double y) const {
+  static const std::vector<size_t> NO_EDGES;
+
+  double bucket = std::floor((y - m_bottom) / m_bucket_height);
+  if (bucket < 0.0 || bucket >= m_buckets.size())
+    return NO_EDGES;
+
+  return m_buckets[(size_t) bucket];
+}
@@ -0,0 +1,128 @@
+#include "FlatMesher/ScanlineClassifier.h"
+#include "FlatMesher/FloorPlan.h"
+#include "FlatMesher/Utils.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace flat;
+
+namespace {
+
+// Adds 'value' to the winding number of every point of the row where 'pred'
+// holds. The predicate is known to be monotone along the row (the points are
+// sorted and the sign of the cross product changes only once), so the points
+// where it holds form a prefix or a suffix of the row
+template <typename Predicate>
+void addWinding(const std::vector<double>& xs, int value, Predicate pred, std::vector<int>& diff) {
+  bool first = pred(xs.front());
+  bool last = pred(xs.back());
+
+  if (first && last) {
+    diff.front() += value;
+    diff.back() -= value;
+  }
+  else if (first) {
+    size_t end = std::partition_point(xs.begin(), xs.end(), pred) - xs.begin();
+    diff.front() += value;
+    diff[end] -= value;
+  }
+  else if (last) {
+    size_t begin = std::partition_point(xs.begin(), xs.end(),
+                                        [&pred](double x) { return !pred(x); }) - xs.begin();
+    diff[begin] += value;
+    diff.back() -= value;
+  }
+}
+
+} // anonymous namespace
+
+ScanlineClassifier::ScanlineClassifier(const FloorPlan& plan): m_plan(plan) {}
+
+void ScanlineClassifier::classifyRow(double y, const std::vector<double>& xs, std::vector<PointLocation>& result,
+                                     std::vector<size_t>* boundary_edges) const {
+  using namespace utils;
+
+  size_t sz = xs.size();
+  result.assign(sz, PointLocation::OUTSIDE);
+
+  if (boundary_edges)
+    boundary_edges->assign(sz, m_plan.edgeCount());
+
+  if (sz == 0)
+    return;
+
+  // Winding numbers are accumulated as a difference array, so that each edge
+  // crossing the row only costs a binary search
+  std::vector<int> diff(sz + 1, 0);
+  const std::vector<size_t>* lists[2] = { &m_plan.edgesAt(y), &m_plan.longEdges() };
+
+  for (int l = 0; l < 2; ++l) {
+    for (auto i = lists[l]->begin(); i != lists[l]->end(); ++i) {
+      const Line2& edge = m_plan.getEdgeAt(*i);
+      double a_y = edge.getA().getY(), b_y = edge.getB().getY();
+
+      // Same crossing rules than FloorPlan::pointInside
+      if (lessEqual(a_y, y)) {
+        if (greater(b_y, y))
+          addWinding(xs, 1, [&](double x) { return Point2(x, y).isLeft(edge); }, diff);
+      }
+      else {
+        if (lessEqual(b_y, y))
+          addWinding(xs, -1, [&](double x) { return Point2(x, y).isRight(edge); }, diff);
+      }
+
+      // Points can only lie on the edge if the row crosses its vertical extent
+      if (greaterEqual(y, std::fmin(a_y, b_y)) && lessEqual(y, std::fmax(a_y, b_y)))
+        markBoundary(*i, y, xs, result, boundary_edges);
+    }
+  }
+
+  int wn = 0;
+  for (size_t i = 0; i < sz; ++i) {
+    wn += diff[i];
+
+    if (result[i] != PointLocation::BOUNDARY && wn != 0)
+      result[i] = PointLocation::INSIDE;
+  }
+}
+
+void ScanlineClassifier::markBoundary(size_t edge_idx, double y, const std::vector<double>& xs,
+                                      std::vector<PointLocation>& result, std::vector<size_t>* boundary_edges) const {
+  using namespace utils;
+
+  const Line2& edge = m_plan.getEdgeAt(edge_idx);
+
+  // We compute a range of x coordinates that is guaranteed to contain every
+  // point of the row that is part of the edge, and then we use the exact test
+  // only for the points of the row inside that range
+  Point2 a = edge.getA(), b = edge.getB();
+  double min_x = std::fmin(a.getX(), b.getX()) - 2 * DOUBLE_EPSILON;
+  double max_x = std::fmax(a.getX(), b.getX()) + 2 * DOUBLE_EPSILON;
+
+  if (!areEqual(a.getX(), b.getX())) {
+    double m = edge.slope();
+
+    if (std::abs(m) > DOUBLE_EPSILON) {
+      double x = a.getX() + (y - a.getY()) / m;
+      double tolerance = 2 * DOUBLE_EPSILON / std::abs(m) + 2 * DOUBLE_EPSILON;
+
+      min_x = std::fmax(min_x, x - tolerance);
+      max_x = std::fmin(max_x, x + tolerance);
+    }
+  }
+
+  for (auto i = std::lower_bound(xs.begin(), xs.end(), min_x); i != xs.end() && *i <= max_x; ++i) {
+    if (edge.contains(Point2(*i, y))) {
+      result[i - xs.begin()] = PointLocation::BOUNDARY;
+
+      // The edges of the bucket and the long edges are visited separately, so
+      // the last edge is the one with the largest index
+      if (boundary_edges) {
+        size_t& last = (*boundary_edges)[i - xs.begin()];
+        if (last == m_plan.edgeCount() || last < edge_idx)
+          last = edge_idx;
+      }
+    }
+  }
+}
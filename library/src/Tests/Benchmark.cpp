@@ -0,0 +1,545 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <streambuf>
+#include <vector>
+
+#include <FlatMesher/BemgenMeshFormatter.h>
+#include <FlatMesher/FMeshFormatter.h>
+#include <FlatMesher/FlatMesh.h>
+#include <FlatMesher/FloorPlan.h>
+#include <FlatMesher/Line2.h>
+#include <FlatMesher/LatticeClassifier.h>
+#include <FlatMesher/MappedMesh.h>
+#include <FlatMesher/NodeArrays.h>
+#include <FlatMesher/PlanErrorChecker.h>
+#include <FlatMesher/PreparedFloorPlan.h>
+#include <FlatMesher/ScanlineClassifier.h>
+#include <FlatMesher/VTUMeshFormatter.h>
+
+typedef std::chrono::steady_clock bench_clock;
+
+double elapsed(bench_clock::time_point start) {
+  return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+// Creates a valid staircase-shaped plan with 2 * steps + 2 segments
+flat::FloorPlan staircasePlan(size_t steps, double triangle_sz) {
+  std::vector<flat::Point2> nodes;
+
+  nodes.push_back(flat::Point2(0, 0));
+  for (size_t i = 0; i < steps; ++i) {
+    nodes.push_back(flat::Point2((i + 1) * triangle_sz, i * triangle_sz));
+    nodes.push_back(flat::Point2((i + 1) * triangle_sz, (i + 1) * triangle_sz));
+  }
+  nodes.push_back(flat::Point2(0, steps * triangle_sz));
+
+  flat::FloorPlan plan;
+  plan.setNodes(nodes);
+  plan.setHeight(triangle_sz);
+  plan.setTriangleSize(triangle_sz);
+
+  return plan;
+}
+
+// Creates a plan whose nodes are random points of a grid, so that it has lots
+// of intersecting segments and repeated points
+flat::FloorPlan randomPlan(size_t nodes, size_t grid_sz, double triangle_sz) {
+  std::srand(nodes);
+
+  std::vector<flat::Point2> points;
+  for (size_t i = 0; i < nodes; ++i)
+    points.push_back(flat::Point2((std::rand() % grid_sz) * triangle_sz, (std::rand() % grid_sz) * triangle_sz));
+
+  flat::FloorPlan plan;
+  plan.setNodes(points);
+  plan.setHeight(triangle_sz);
+  plan.setTriangleSize(triangle_sz);
+
+  return plan;
+}
+
+// Records the repeated points and intersecting segments found, without ever
+// aborting the check
+class RecordingChecker: public flat::PlanErrorChecker {
+public:
+  virtual bool visitInsufficientNodes(size_t) { return false; }
+  virtual bool visitInvalidTriangleSize(double) { return false; }
+  virtual bool visitInvalidHeight(double) { return false; }
+  virtual bool visitInvalidSegmentLength(const flat::Line2&) { return false; }
+  virtual bool visitInvalidSegmentSlope(const flat::Line2&) { return false; }
+  virtual bool visitNotCCWOrder() { return false; }
+  virtual bool visitHoleNotCWOrder(size_t) { return false; }
+  virtual bool visitHoleOffLattice(size_t) { return false; }
+  virtual bool visitHoleOutside(size_t) { return false; }
+
+  virtual bool visitRepeatedPoint(const flat::Point2& point) {
+    found.push_back(flat::Line2(point, point));
+    return false;
+  }
+
+  virtual bool visitIntersectingSegments(const flat::Line2& first, const flat::Line2& second) {
+    found.push_back(first);
+    found.push_back(second);
+    return false;
+  }
+
+  std::vector<flat::Line2> found;
+};
+
+// Same checks of repeated points and intersecting segments that
+// FloorPlan::checkErrors did by comparing every pair of segments
+void pairwiseChecks(const flat::FloorPlan& plan, flat::PlanErrorChecker& checker) {
+  std::vector<flat::Line2> segments = plan.getSegments();
+  size_t sz_segments = segments.size();
+
+  for (size_t i = 0; i + 1 < sz_segments; ++i) {
+    const flat::Line2& a = segments[i];
+
+    for (size_t j = i + 1; j < sz_segments; ++j)
+      if (a.getA() == segments[j].getA())
+        checker.visitRepeatedPoint(a.getA());
+
+    for (size_t j = i + 1; j < sz_segments; ++j) {
+      if (j != plan.nextSegment(i) && i != plan.nextSegment(j)) {
+        const flat::Line2& b = segments[j];
+        if (a.intersects(b))
+          checker.visitIntersectingSegments(a, b);
+      }
+    }
+  }
+}
+
+// Discards everything written to it, counting the amount of bytes
+class CountingBuffer: public std::streambuf {
+public:
+  CountingBuffer(): bytes(0) {}
+
+  size_t bytes;
+
+protected:
+  virtual int overflow(int c) {
+    ++bytes;
+    return c;
+  }
+
+  virtual std::streamsize xsputn(const char*, std::streamsize n) {
+    bytes += n;
+    return n;
+  }
+};
+
+// Amount of benchmarks whose results differ from the reference ones, which
+// makes the program fail
+int differences = 0;
+
+bool check(bool equal) {
+  if (!equal)
+    ++differences;
+
+  return equal;
+}
+
+// Benchmarks
+void benchmarkClassifier(size_t steps);
+void benchmarkValidation(const flat::FloorPlan& plan);
+void benchmarkNodes(size_t side);
+void benchmarkVTU(size_t side);
+void benchmarkVTULoad(size_t side);
+void benchmarkBemgenLoad(size_t side);
+void benchmarkParallelText(size_t side);
+void benchmarkFMeshLoad(size_t side);
+
+int main(int argc, char* argv[]) {
+  for (size_t steps = 50; steps <= 400; steps *= 2)
+    benchmarkClassifier(steps);
+
+  for (size_t steps = 250; steps <= 4000; steps *= 2)
+    benchmarkValidation(staircasePlan(steps, 0.5));
+
+  for (size_t nodes = 250; nodes <= 2000; nodes *= 2)
+    benchmarkValidation(randomPlan(nodes, 100, 0.5));
+
+  for (size_t side = 500; side <= 2000; side *= 2)
+    benchmarkNodes(side);
+
+  for (size_t side = 500; side <= 2000; side *= 2)
+    benchmarkVTU(side);
+
+  for (size_t side = 500; side <= 2000; side *= 2)
+    benchmarkVTULoad(side);
+
+  for (size_t side = 500; side <= 2000; side *= 2)
+    benchmarkBemgenLoad(side);
+
+  for (size_t side = 500; side <= 2000; side *= 2)
+    benchmarkParallelText(side);
+
+  for (size_t side = 500; side <= 2000; side *= 2)
+    benchmarkFMeshLoad(side);
+
+  return differences == 0? 0 : 1;
+}
+
+void benchmarkClassifier(size_t steps) {
+  flat::FloorPlan plan = staircasePlan(steps, 0.5);
+  flat::Rectangle box = plan.boundingBox();
+
+  double delta = plan.getTriangleSize();
+  size_t height = lround(box.getHeight() / delta);
+  size_t width = lround(box.getWidth() / delta);
+
+  std::vector<double> xs(width + 1);
+  for (size_t ix = 0; ix <= width; ++ix)
+    xs[ix] = box.getLeft() + (ix * delta);
+
+  std::vector<std::vector<flat::PointLocation>> expected(height + 1);
+
+  bench_clock::time_point start = bench_clock::now();
+  for (size_t iy = 0; iy <= height; ++iy) {
+    double y = box.getBottom() + (iy * delta);
+
+    for (size_t ix = 0; ix <= width; ++ix) {
+      flat::Point2 p(xs[ix], y);
+
+      if (plan.pointInBoundary(p))
+        expected[iy].push_back(flat::PointLocation::BOUNDARY);
+      else if (plan.pointInside(p))
+        expected[iy].push_back(flat::PointLocation::INSIDE);
+      else
+        expected[iy].push_back(flat::PointLocation::OUTSIDE);
+    }
+  }
+  double per_point = elapsed(start);
+
+  bool equal = true;
+  flat::PreparedFloorPlan prepared(plan);
+
+  start = bench_clock::now();
+  for (size_t iy = 0; iy <= height; ++iy) {
+    double y = box.getBottom() + (iy * delta);
+
+    for (size_t ix = 0; ix <= width; ++ix)
+      equal = equal && prepared.classify(flat::Point2(xs[ix], y)) == expected[iy][ix];
+  }
+  double fused = elapsed(start);
+
+  flat::ScanlineClassifier classifier(plan);
+  std::vector<flat::PointLocation> row;
+
+  start = bench_clock::now();
+  for (size_t iy = 0; iy <= height; ++iy) {
+    classifier.classifyRow(box.getBottom() + (iy * delta), xs, row);
+    equal = equal && row == expected[iy];
+  }
+  double scanline = elapsed(start);
+
+  flat::LatticeClassifier lattice(plan);
+
+  start = bench_clock::now();
+  for (size_t iy = 0; iy <= height; ++iy) {
+    lattice.classifyRow(2 * iy, 0, 2, width + 1, row);
+    equal = equal && row == expected[iy];
+  }
+  double exact = elapsed(start);
+
+  std::cout << "Edges: " << plan.getNodes().size()
+            << "\tPer point: " << per_point << "s"
+            << "\tPrepared: " << fused << "s"
+            << "\tScanline: " << scanline << "s"
+            << "\tLattice: " << exact << "s"
+            << "\tSpeedup: " << per_point / scanline << "x / " << per_point / exact << "x"
+            << (check(equal)? "" : "\tRESULTS DIFFER!") << '\n';
+}
+
+void benchmarkValidation(const flat::FloorPlan& plan) {
+  RecordingChecker pairwise;
+
+  bench_clock::time_point start = bench_clock::now();
+  pairwiseChecks(plan, pairwise);
+  double pairwise_time = elapsed(start);
+
+  RecordingChecker checker;
+
+  start = bench_clock::now();
+  plan.checkErrors(&checker);
+  double check_time = elapsed(start);
+
+  // valid() aborts at the first problem
+  start = bench_clock::now();
+  bool valid = plan.valid();
+  double valid_time = elapsed(start);
+
+  std::cout << "Edges: " << plan.segmentCount()
+            << "\tProblems: " << pairwise.found.size()
+            << "\tPairwise: " << pairwise_time << "s"
+            << "\tcheckErrors: " << check_time << "s"
+            << "\tvalid(): " << valid_time << "s"
+            << "\tSpeedup: " << pairwise_time / check_time << "x"
+            << (check(pairwise.found == checker.found && valid == checker.found.empty())? "" : "\tRESULTS DIFFER!") << '\n';
+}
+
+void benchmarkNodes(size_t side) {
+  flat::FloorPlan plan;
+  plan.setNodes({flat::Point2(0, 0), flat::Point2(side, 0), flat::Point2(side, side), flat::Point2(0, side)});
+  plan.setHeight(1.0);
+  plan.setTriangleSize(1.0);
+
+  flat::FlatMesh mesh;
+  mesh.createFromPlan(&plan);
+
+  std::vector<flat::Point3> nodes = mesh.getNodes();
+  std::vector<flat::IndexTriangle> triangles = mesh.getMesh();
+  flat::Point3 translation(0.5, -0.25, 1.0);
+
+  // Node operations over an array of Point3, the way Mesh::move used to be
+  bench_clock::time_point start = bench_clock::now();
+  for (auto i = nodes.begin(); i != nodes.end(); ++i)
+    *i = *i + translation;
+
+  flat::Point3 lower = nodes[0], upper = nodes[0];
+  for (auto i = nodes.begin(); i != nodes.end(); ++i) {
+    lower = flat::Point3(std::min(lower.getX(), i->getX()), std::min(lower.getY(), i->getY()),
+                         std::min(lower.getZ(), i->getZ()));
+    upper = flat::Point3(std::max(upper.getX(), i->getX()), std::max(upper.getY(), i->getY()),
+                         std::max(upper.getZ(), i->getZ()));
+  }
+
+  std::vector<flat::Point3> centroids, normals;
+  for (auto t = triangles.begin(); t != triangles.end(); ++t) {
+    const flat::Point3& a = nodes[t->getI()];
+    const flat::Point3& b = nodes[t->getJ()];
+    const flat::Point3& c = nodes[t->getK()];
+    flat::Point3 u = b - a, v = c - a;
+    flat::Point3 n(u.getY() * v.getZ() - u.getZ() * v.getY(), u.getZ() * v.getX() - u.getX() * v.getZ(),
+                   u.getX() * v.getY() - u.getY() * v.getX());
+    double length = n.distance(flat::Point3());
+
+    centroids.push_back((a + b + c) / 3.0);
+    normals.push_back(length > 0.0? n / length : flat::Point3());
+  }
+  double points = elapsed(start);
+
+  start = bench_clock::now();
+  flat::NodeArrays arrays = mesh.getNodeArrays();
+  double conversion = elapsed(start);
+
+  flat::Point3 soa_lower, soa_upper;
+  flat::NodeArrays soa_centroids, soa_normals;
+
+  start = bench_clock::now();
+  arrays.move(translation.getX(), translation.getY(), translation.getZ());
+  arrays.bounds(soa_lower, soa_upper);
+  arrays.centroids(triangles, soa_centroids);
+  arrays.normals(triangles, soa_normals);
+  double soa = elapsed(start);
+
+  bool equal = soa_lower == lower && soa_upper == upper && arrays.toPoints() == nodes &&
+               soa_centroids.toPoints() == centroids && soa_normals.toPoints() == normals;
+
+  std::cout << "Nodes: " << nodes.size()
+            << "\tPoint3: " << points << "s"
+            << "\tNodeArrays: " << soa << "s (+" << conversion << "s converting)"
+            << "\tSpeedup: " << points / soa << "x (" << points / (soa + conversion) << "x converting)"
+            << (check(equal)? "" : "\tRESULTS DIFFER!") << '\n';
+}
+
+void benchmarkVTU(size_t side) {
+  flat::FloorPlan plan;
+  plan.setNodes({flat::Point2(0, 0), flat::Point2(side, 0), flat::Point2(side, side), flat::Point2(0, side)});
+  plan.setHeight(1.0);
+  plan.setTriangleSize(1.0);
+
+  flat::FlatMesh mesh;
+  mesh.createFromPlan(&plan);
+
+  const char* names[] = {"ASCII", "Base64", "Binary", "Base64+zlib", "Binary+zlib"};
+  flat::VTUEncoding encodings[] = {flat::VTUEncoding::ASCII, flat::VTUEncoding::BASE64, flat::VTUEncoding::APPENDED,
+                                   flat::VTUEncoding::BASE64, flat::VTUEncoding::APPENDED};
+  bool compressed[] = {false, false, false, true, true};
+
+  std::cout << "Triangles: " << mesh.getMeshView().size();
+
+  for (int i = 0; i < 5; ++i) {
+    CountingBuffer buffer;
+    std::ostream os(&buffer);
+    flat::VTUMeshFormatter formatter(encodings[i], compressed[i]);
+
+    bench_clock::time_point start = bench_clock::now();
+    formatter.writeMesh(os, mesh);
+    double time = elapsed(start);
+
+    std::cout << '\t' << names[i] << ": " << time << "s " << buffer.bytes / (1024 * 1024) << "MB";
+  }
+
+  std::cout << '\n';
+}
+
+void benchmarkVTULoad(size_t side) {
+  flat::FloorPlan plan;
+  plan.setNodes({flat::Point2(0, 0), flat::Point2(side, 0), flat::Point2(side, side), flat::Point2(0, side)});
+  plan.setHeight(1.0);
+  plan.setTriangleSize(1.0);
+
+  flat::FlatMesh mesh;
+  mesh.createFromPlan(&plan);
+
+  const char* names[] = {"ASCII", "Base64", "Binary", "Base64+zlib", "Binary+zlib"};
+  flat::VTUEncoding encodings[] = {flat::VTUEncoding::ASCII, flat::VTUEncoding::BASE64, flat::VTUEncoding::APPENDED,
+                                   flat::VTUEncoding::BASE64, flat::VTUEncoding::APPENDED};
+  bool compressed[] = {false, false, false, true, true};
+  const char* file_name = "benchmark.vtu";
+
+  std::cout << "Triangles: " << mesh.getMeshView().size();
+
+  for (int i = 0; i < 5; ++i) {
+    flat::VTUMeshFormatter formatter(encodings[i], compressed[i]);
+    {
+      std::ofstream os(file_name, std::ios::binary);
+      formatter.writeMesh(os, mesh);
+    }
+
+    flat::Mesh loaded;
+
+    bench_clock::time_point start = bench_clock::now();
+    bool valid = formatter.readMeshFile(file_name, loaded);
+    double time = elapsed(start);
+
+    bool equal = valid && loaded.getNodesView().size() == mesh.getNodesView().size() &&
+                 loaded.getMeshView().size() == mesh.getMeshView().size();
+    for (size_t j = 0; equal && j < loaded.getNodesView().size(); ++j)
+      equal = loaded.getNodesView()[j] == mesh.getNodesView()[j];
+
+    std::cout << '\t' << names[i] << ": " << time << "s " << (check(equal)? "equal" : "DIFFERENT");
+  }
+
+  std::remove(file_name);
+  std::cout << '\n';
+}
+
+void benchmarkBemgenLoad(size_t side) {
+  flat::FloorPlan plan;
+  plan.setNodes({flat::Point2(0, 0), flat::Point2(side, 0), flat::Point2(side, side), flat::Point2(0, side)});
+  plan.setHeight(1.0);
+  plan.setTriangleSize(1.0);
+
+  flat::FlatMesh mesh;
+  mesh.createFromPlan(&plan);
+
+  flat::BemgenMeshFormatter formatter;
+  const char* file_name = "benchmark.bemgen";
+  {
+    std::ofstream os(file_name);
+    formatter.writeMesh(os, mesh);
+  }
+
+  // Extraction of every value from a stream, as the reader used to do
+  bench_clock::time_point start = bench_clock::now();
+  std::ifstream is(file_name);
+  size_t sp_dim, nodes_el, total_nodes, total_triangles;
+  is >> sp_dim >> nodes_el >> total_nodes;
+
+  std::vector<flat::Point3> nodes(total_nodes);
+  for (size_t i = 0; i < total_nodes; ++i)
+    is >> nodes[i];
+
+  is >> total_triangles;
+  std::vector<flat::IndexTriangle> triangles(total_triangles, flat::IndexTriangle(0, 0, 0));
+  for (size_t i = 0; i < total_triangles; ++i)
+    is >> triangles[i];
+  double extraction = elapsed(start);
+
+  flat::Mesh loaded;
+
+  start = bench_clock::now();
+  bool equal = formatter.readMeshFile(file_name, loaded);
+  double mapped = elapsed(start);
+
+  equal = equal && loaded.getNodesView().size() == nodes.size() && loaded.getMeshView().size() == triangles.size();
+  for (size_t i = 0; equal && i < nodes.size(); ++i)
+    equal = loaded.getNodesView()[i] == nodes[i];
+
+  std::remove(file_name);
+  std::cout << "Triangles: " << triangles.size() << "\tExtraction: " << extraction << "s\tMapped: " << mapped << "s "
+            << (check(equal)? "equal" : "DIFFERENT") << '\n';
+}
+
+void benchmarkParallelText(size_t side) {
+  flat::FloorPlan plan;
+  plan.setNodes({flat::Point2(0, 0), flat::Point2(side, 0), flat::Point2(side, side), flat::Point2(0, side)});
+  plan.setHeight(1.0);
+  plan.setTriangleSize(1.0);
+
+  flat::FlatMesh mesh;
+  mesh.createFromPlan(&plan);
+
+  std::cout << "Triangles: " << mesh.getMeshView().size();
+
+  for (int threads = 1; threads <= 8; threads *= 2) {
+    CountingBuffer vtu_buffer, bemgen_buffer;
+    std::ostream vtu_os(&vtu_buffer), bemgen_os(&bemgen_buffer);
+
+    flat::VTUMeshFormatter vtu;
+    flat::BemgenMeshFormatter bemgen;
+    vtu.setThreads(threads);
+    bemgen.setThreads(threads);
+
+    bench_clock::time_point start = bench_clock::now();
+    vtu.writeMesh(vtu_os, mesh);
+    double vtu_time = elapsed(start);
+
+    start = bench_clock::now();
+    bemgen.writeMesh(bemgen_os, mesh);
+    double bemgen_time = elapsed(start);
+
+    std::cout << "\t" << threads << " threads: VTU " << vtu_time << "s Bemgen " << bemgen_time << 's';
+  }
+
+  std::cout << '\n';
+}
+
+void benchmarkFMeshLoad(size_t side) {
+  flat::FloorPlan plan;
+  plan.setNodes({flat::Point2(0, 0), flat::Point2(side, 0), flat::Point2(side, side), flat::Point2(0, side)});
+  plan.setHeight(1.0);
+  plan.setTriangleSize(1.0);
+
+  flat::FlatMesh mesh;
+  mesh.createFromPlan(&plan);
+
+  const char* file_name = "benchmark.fmesh";
+  {
+    std::ofstream os(file_name, std::ios::binary);
+    flat::FMeshFormatter().writeMesh(os, mesh);
+  }
+
+  std::cout << "Triangles: " << mesh.getMeshView().size();
+
+  // Mapping only reads the header, verifying reads the whole file, and reading
+  // into a Mesh copies it too
+  bench_clock::time_point start = bench_clock::now();
+  flat::MappedMesh mapped(file_name);
+  double map_time = elapsed(start);
+
+  start = bench_clock::now();
+  bool valid = mapped.verify();
+  double verify_time = elapsed(start);
+
+  bool equal = valid && mapped.getNodesView().size() == mesh.getNodesView().size() &&
+               mapped.getMeshView().size() == mesh.getMeshView().size();
+  for (size_t j = 0; equal && j < mapped.getNodesView().size(); ++j)
+    equal = mapped.getNodesView()[j] == mesh.getNodesView()[j];
+
+  flat::Mesh loaded;
+  start = bench_clock::now();
+  flat::FMeshFormatter().readMeshFile(file_name, loaded);
+  double read_time = elapsed(start);
+
+  std::cout << "\tMap: " << map_time << "s (" << (mapped.isZeroCopy()? "zero-copy" : "copied") << ")"
+            << "\tVerify: " << verify_time << "s\tRead: " << read_time << "s " << (check(equal)? "equal" : "DIFFERENT") << '\n';
+
+  std::remove(file_name);
+}
@@ -1,33 +1,150 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
 
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include <FlatMesher/AbortPlanErrorChecker.h>
+#include <FlatMesher/Building.h>
+#include <FlatMesher/BemgenMeshFormatter.h>
+#include <FlatMesher/BuildingMesh.h>
 #include <FlatMesher/FloorPlan.h>
 #include <FlatMesher/FlatMesh.h>
+#include <FlatMesher/FMeshFormatter.h>
+#include <FlatMesher/FMeshSink.h>
+#include <FlatMesher/IncrementalFlatMesh.h>
+#include <FlatMesher/MappedMesh.h>
+#include <FlatMesher/MeshCache.h>
+#include <FlatMesher/MeshSink.h>
+#include <FlatMesher/NodeGrid.h>
+#include <FlatMesher/NumberFormatter.h>
+#include <FlatMesher/PreparedFloorPlan.h>
+#include <FlatMesher/ScanlineClassifier.h>
+#include <FlatMesher/VTUMeshFormatter.h>
+#include <FlatMesher/VTUMeshSink.h>
+
+int failed_tests = 0;
 
 void runTest(bool(*test_func)(), const char* test_name) {
-  if (!test_func())
+  if (!test_func()) {
     std::cerr << "Test: " << test_name << " FAILED!\n";
+    ++failed_tests;
+  }
 }
 
-// Global variables
-const char* flat1 = "test/test1.flat";
-const char* flat1_out = "test/test1_gen.flat";
-const char* mesh1 = "test/mesh1.txt";
-const char* mesh1_out = "test/mesh1_gen.txt";
+// Global variables. Input files are read from the test directory, which can be
+// given as the first argument, and output files are written to the current one
+std::string test_dir = "test/";
+std::string flat1;
+const char* flat1_out = "test1_gen.flat";
+const char* cache_dir = "test_cache";
+
+// Helpers
+flat::FloorPlan rectanglePlan(double x, double y, double width, double depth, double height, double triangle_sz);
+bool closedSurface(const flat::Mesh& mesh);
 
 // Tests
 bool testReadWriteFloorPlan();
 bool testIsValidFloorPlan();
 bool testPointsInside();
 bool testMeshCreation();
+bool testBuildingSlabs();
+bool testBuildingAlignment();
+bool testHoleMeshing();
+bool testHoleLattice();
+bool testReadWriteHoles();
+bool testGradingLevels();
+bool testIncrementalMesh();
+bool testMeshCache();
+bool testNodeWelding();
+bool testLongEdges();
+bool testVTURoundTrip();
+bool testVTUCorruption();
+bool testBemgenReadWrite();
+bool testNumberFormatting();
+bool testParallelText();
+bool testFMeshReadWrite();
 
 int main(int argc, char* argv[]) {
+  if (argc > 1)
+    test_dir = argv[1];
+  flat1 = test_dir + "test1.flat";
+
   runTest(testReadWriteFloorPlan, "Read/Write Input File");
   runTest(testIsValidFloorPlan, "Floor Plan Validity");
   runTest(testPointsInside, "Points Inside Test");
   runTest(testMeshCreation, "Mesh Creation");
+  runTest(testBuildingSlabs, "Building Shared Slabs");
+  runTest(testBuildingAlignment, "Building Lattice Alignment");
+  runTest(testHoleMeshing, "Hole Meshing");
+  runTest(testHoleLattice, "Hole Lattice");
+  runTest(testReadWriteHoles, "Read/Write Holes And Storeys");
+  runTest(testGradingLevels, "Grading Levels Limit");
+  runTest(testIncrementalMesh, "Incremental Mesh Update");
+  runTest(testMeshCache, "Mesh Cache");
+  runTest(testNodeWelding, "Node Welding");
+  runTest(testLongEdges, "Classification With Long Edges");
+  runTest(testVTURoundTrip, "VTU Write/Read");
+  runTest(testVTUCorruption, "VTU Truncated And Trailing Data");
+  runTest(testBemgenReadWrite, "Bemgen Write/Read");
+  runTest(testNumberFormatting, "Number Formatting");
+  runTest(testParallelText, "Parallel Text Output");
+  runTest(testFMeshReadWrite, "FMesh Write/Read");
+
+  return failed_tests == 0? 0 : 1;
+}
+
+// Square hole in clockwise order, with its lower left corner at (x, y)
+std::vector<flat::Point2> squareHole(double x, double y, double side) {
+  return {flat::Point2(x, y), flat::Point2(x, y + side), flat::Point2(x + side, y + side), flat::Point2(x + side, y)};
+}
+
+// Rectangle with its lower left corner at (x, y)
+flat::FloorPlan rectanglePlan(double x, double y, double width, double depth, double height, double triangle_sz) {
+  flat::FloorPlan plan;
+  plan.setNodes({flat::Point2(x, y), flat::Point2(x + width, y), flat::Point2(x + width, y + depth),
+                 flat::Point2(x, y + depth)});
+  plan.setHeight(height);
+  plan.setTriangleSize(triangle_sz);
 
-  return 0;
+  return plan;
+}
+
+// Tells if every edge of the mesh is shared by exactly two triangles, which go
+// through it in opposite directions, so that the mesh encloses a volume
+bool closedSurface(const flat::Mesh& mesh) {
+  std::vector<std::pair<size_t, size_t>> edges;
+  flat::ArrayView<flat::IndexTriangle> triangles = mesh.getMeshView();
+
+  for (size_t i = 0; i < triangles.size(); ++i) {
+    const flat::IndexTriangle& t = triangles[i];
+    edges.push_back(std::make_pair(t.getI(), t.getJ()));
+    edges.push_back(std::make_pair(t.getJ(), t.getK()));
+    edges.push_back(std::make_pair(t.getK(), t.getI()));
+  }
+
+  std::sort(edges.begin(), edges.end());
+  if (edges.empty() || std::adjacent_find(edges.begin(), edges.end()) != edges.end())
+    return false;
+
+  for (size_t i = 0; i < edges.size(); ++i)
+    if (!std::binary_search(edges.begin(), edges.end(), std::make_pair(edges[i].second, edges[i].first)))
+      return false;
+
+  return true;
 }
 
 bool testReadWriteFloorPlan() {
@@ -79,7 +196,10 @@ bool testIsValidFloorPlan() {
     in >> plan;
     in.close();
 
-    std::cout << (plan.valid()? "Valid" : "Invalid") << " plan\n";
+    if (!plan.valid()) {
+      std::cerr << "The plan is not valid\n";
+      return false;
+    }
   }
   else {
     std::cerr << "Error trying to open the file\n";
@@ -138,30 +258,776 @@ bool testMeshCreation() {
     flat::FlatMesh mesh;
     mesh.createFromPlan(&plan);
 
-    std::ifstream in_mesh(mesh1);
-    if (in_mesh.is_open()) {
-      flat::FlatMesh mesh1;
+    if (mesh.empty() || !closedSurface(mesh)) {
+      std::cerr << "The mesh is not a closed surface\n";
+      return false;
+    }
+  }
+  else {
+    std::cerr << "Error trying to open the input file\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool testBuildingSlabs() {
+  flat::FloorPlan plan = rectanglePlan(0, 0, 4, 3, 1, 0.5);
+  flat::FlatMesh storey;
+  storey.createFromPlan(&plan);
+
+  // The ceiling is made of the nodes and triangles at the top of the storey
+  std::vector<flat::Point3> nodes = storey.getNodes();
+  size_t ceiling_nodes = 0, ceiling_triangles = 0;
+
+  for (size_t i = 0; i < nodes.size(); ++i)
+    if (nodes[i].getZ() == plan.getHeight())
+      ++ceiling_nodes;
+
+  flat::ArrayView<flat::IndexTriangle> triangles = storey.getMeshView();
+  for (size_t i = 0; i < triangles.size(); ++i)
+    if (nodes[triangles[i].getI()].getZ() == plan.getHeight() &&
+        nodes[triangles[i].getJ()].getZ() == plan.getHeight() &&
+        nodes[triangles[i].getK()].getZ() == plan.getHeight())
+      ++ceiling_triangles;
+
+  // Storeys that share a slab share its nodes and keep its triangles once
+  flat::Building building;
+  building.addStorey(plan, 0);
+  building.addStorey(plan, plan.getHeight());
+
+  flat::BuildingMesh mesh;
+  mesh.createFromBuilding(&building);
+
+  if (mesh.empty() || mesh.getNodesView().size() != 2 * nodes.size() - ceiling_nodes ||
+      mesh.getMeshView().size() != 2 * triangles.size() - ceiling_triangles) {
+    std::cerr << "The slab between both storeys is not shared\n";
+    return false;
+  }
+
+  std::vector<std::vector<size_t>> node_sets;
+  for (size_t i = 0; i < mesh.getMeshView().size(); ++i) {
+    const flat::IndexTriangle& t = mesh.getMeshView()[i];
+    std::vector<size_t> set = {t.getI(), t.getJ(), t.getK()};
+    std::sort(set.begin(), set.end());
+    node_sets.push_back(set);
+  }
+
+  std::sort(node_sets.begin(), node_sets.end());
+  if (std::adjacent_find(node_sets.begin(), node_sets.end()) != node_sets.end()) {
+    std::cerr << "The mesh has repeated triangles\n";
+    return false;
+  }
+
+  // Storeys apart don't share anything
+  building.clear();
+  building.addStorey(plan, 0);
+  building.addStorey(plan, 2 * plan.getHeight());
+  mesh.createFromBuilding(&building);
+
+  if (mesh.getNodesView().size() != 2 * nodes.size() || mesh.getMeshView().size() != 2 * triangles.size()) {
+    std::cerr << "Separate storeys share nodes\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool testBuildingAlignment() {
+  flat::Building building;
+  building.addStorey(rectanglePlan(0, 0, 4, 3, 1, 0.5), 0);
+  building.addStorey(rectanglePlan(1, 0.5, 2, 2, 1, 0.5), 1);
+
+  if (!building.valid()) {
+    std::cerr << "Storeys a whole amount of triangles apart are rejected\n";
+    return false;
+  }
+
+  // Moving the upper storey by half a triangle puts its lattice between the
+  // nodes of the slab
+  building.clear();
+  building.addStorey(rectanglePlan(0, 0, 4, 3, 1, 0.5), 0);
+  building.addStorey(rectanglePlan(1.25, 0.5, 2, 2, 1, 0.5), 1);
+
+  flat::BuildingMesh mesh;
+  mesh.createFromBuilding(&building);
+
+  if (building.valid() || !mesh.empty()) {
+    std::cerr << "Storeys with misaligned lattices are accepted\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool testHoleMeshing() {
+  flat::FloorPlan plan = rectanglePlan(0, 0, 6, 4, 1, 0.5);
+  plan.addHole(squareHole(1, 1, 1));
+  plan.addHole(squareHole(3.5, 1.5, 1.5));
+
+  flat::FlatMesh mesh;
+  mesh.createFromPlan(&plan);
+
+  if (!plan.valid() || mesh.empty() || !closedSurface(mesh)) {
+    std::cerr << "The mesh of a plan with holes is not a closed surface\n";
+    return false;
+  }
+
+  // The holes have walls and no ceiling, so the mesh has more triangles than
+  // the plan without them
+  flat::FloorPlan solid = rectanglePlan(0, 0, 6, 4, 1, 0.5);
+  flat::FlatMesh solid_mesh;
+  solid_mesh.createFromPlan(&solid);
+
+  for (size_t i = 0; i < mesh.getNodesView().size(); ++i) {
+    const flat::Point3& node = mesh.getNodesView()[i];
+    if (node.getX() > 1 && node.getX() < 2 && node.getY() > 1 && node.getY() < 2) {
+      std::cerr << "The mesh has nodes inside a hole\n";
+      return false;
+    }
+  }
+
+  if (mesh.getMeshView().size() == solid_mesh.getMeshView().size()) {
+    std::cerr << "The holes are not meshed\n";
+    return false;
+  }
+
+  return true;
+}
+
+// Aborts at the first error, recording if it was a hole off the lattice
+class HoleLatticeChecker: public flat::AbortPlanErrorChecker {
+public:
+  HoleLatticeChecker(): hole(-1) {}
+
+  virtual bool visitHoleOffLattice(size_t index) {
+    hole = (int) index;
+    return true;
+  }
+
+  int hole;
+};
+
+bool testHoleLattice() {
+  // The lattice starts at the lower left corner of the bounding box, so a hole
+  // can be off the lattice even with every coordinate a multiple of the
+  // triangle size
+  flat::FloorPlan plan = rectanglePlan(0.25, 0, 4, 3, 1, 0.5);
+  plan.addHole(squareHole(1.25, 1, 1));
+
+  HoleLatticeChecker checker;
+  if (!plan.checkErrors(&checker) || checker.hole != -1) {
+    std::cerr << "A hole on the lattice is rejected\n";
+    return false;
+  }
+
+  // Moved by half a triangle, the walls of the hole don't meet the ceiling
+  plan.setHoles({squareHole(1.25, 1, 1), squareHole(2.5, 1.25, 1)});
+  if (plan.checkErrors(&checker) || checker.hole != 1 || plan.valid()) {
+    std::cerr << "A hole off the lattice is accepted\n";
+    return false;
+  }
+
+  plan.setHoles({squareHole(1, 1, 1)});
+  if (plan.valid()) {
+    std::cerr << "A hole off the lattice is accepted\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool testReadWriteHoles() {
+  flat::FloorPlan plan = rectanglePlan(0, 0, 6, 4, 1, 0.5);
+  plan.addHole(squareHole(1, 1, 1));
+
+  flat::FloorPlan solid = rectanglePlan(0, 0, 4, 3, 1, 0.5);
+
+  flat::Building building;
+  building.addStorey(solid, 0);
+  building.addStorey(plan, 1);
+  building.addStorey(solid, 2);
+
+  std::stringstream stream;
+  stream << building;
+
+  flat::Building copy;
+  if (!(stream >> copy) || copy.getStoreyCount() != 3) {
+    std::cerr << "The building could not be read back\n";
+    return false;
+  }
+
+  for (size_t i = 0; i < 3; ++i) {
+    const flat::FloorPlan& a = building.getPlanAt(i);
+    const flat::FloorPlan& b = copy.getPlanAt(i);
+
+    if (a.getNodes() != b.getNodes() || a.getHoles() != b.getHoles() || a.getHeight() != b.getHeight() ||
+        a.getTriangleSize() != b.getTriangleSize() || building.getElevationAt(i) != copy.getElevationAt(i)) {
+      std::cerr << "The storey " << i << " is not read back as it was written\n";
+      return false;
+    }
+  }
+
+  // A plan without its count of holes can only be the last thing read
+  std::stringstream old_plan("4\n0 0\n4 0\n4 3\n0 3\n1\n0.5\n");
+  flat::FloorPlan read;
+  if (!(old_plan >> read) || read.getNodes() != solid.getNodes() || !read.getHoles().empty()) {
+    std::cerr << "A plan without the count of holes is not read\n";
+    return false;
+  }
+
+  std::stringstream storeys("2\nstorey 0\n4\n0 0\n4 0\n4 3\n0 3\n1\n0.5\nstorey 1\n" +
+                            std::string("4\n0 0\n4 0\n4 3\n0 3\n1\n0.5\n0\n"));
+  if (storeys >> copy) {
+    std::cerr << "A storey without the count of holes is read\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool testGradingLevels() {
+  // The lattice has 16 x 16 squares, so blocks can only be merged 4 times
+  flat::FloorPlan plan = rectanglePlan(0, 0, 8, 8, 1, 0.5);
+  flat::FlatMesh graded, huge;
+  graded.setGradingLevels(4);
+  huge.setGradingLevels(1000);
+
+  if (huge.getGradingLevels() != flat::FlatMesh::MAX_GRADING_LEVELS) {
+    std::cerr << "The grading levels are not limited\n";
+    return false;
+  }
+
+  graded.createFromPlan(&plan);
+  huge.createFromPlan(&plan);
+
+  if (huge.empty() || !closedSurface(huge) ||
+      huge.getMeshView().size() != graded.getMeshView().size()) {
+    std::cerr << "Levels larger than the plan change the mesh\n";
+    return false;
+  }
+
+  return true;
+}
+
+// Tells if both meshes have the same nodes and triangles, in the same order
+bool sameMesh(const flat::Mesh& mesh1, const flat::Mesh& mesh2) {
+  flat::ArrayView<flat::Point3> nodes1 = mesh1.getNodesView(), nodes2 = mesh2.getNodesView();
+  flat::ArrayView<flat::IndexTriangle> triangles1 = mesh1.getMeshView(), triangles2 = mesh2.getMeshView();
+
+  if (nodes1.size() != nodes2.size() || triangles1.size() != triangles2.size())
+    return false;
+
+  for (size_t i = 0; i < nodes1.size(); ++i)
+    if (!(nodes1[i] == nodes2[i]))
+      return false;
+
+  for (size_t i = 0; i < triangles1.size(); ++i)
+    if (triangles1[i].getI() != triangles2[i].getI() || triangles1[i].getJ() != triangles2[i].getJ() ||
+        triangles1[i].getK() != triangles2[i].getK())
+      return false;
+
+  return true;
+}
+
+bool testIncrementalMesh() {
+  flat::FloorPlan plan;
+  plan.setNodes({flat::Point2(0, 0), flat::Point2(8, 0), flat::Point2(8, 6), flat::Point2(4, 6),
+                 flat::Point2(4, 3), flat::Point2(0, 3)});
+  plan.setHeight(1);
+  plan.setTriangleSize(0.5);
+
+  flat::IncrementalFlatMesh incremental;
+  incremental.createFromPlan(&plan);
+
+  // Moving the inner wall keeps the bounding box, so only part of the mesh is
+  // created again, and it must be the same mesh as a full rebuild
+  std::vector<flat::Point2> nodes = plan.getNodes();
+  nodes[3] = flat::Point2(5, 6);
+  nodes[4] = flat::Point2(5, 3);
+  plan.setNodes(nodes);
+
+  if (!plan.valid() || !incremental.updateFromPlan(&plan)) {
+    std::cerr << "The mesh was not updated incrementally\n";
+    return false;
+  }
+
+  flat::FlatMesh rebuilt;
+  rebuilt.createFromPlan(&plan);
+
+  if (!sameMesh(incremental, rebuilt) || !closedSurface(incremental)) {
+    std::cerr << "The updated mesh differs from the mesh created again\n";
+    return false;
+  }
+
+  return true;
+}
+
+// Stores the mesh passed to it
+class MeshRecorder: public flat::MeshSink {
+public:
+  virtual void onBegin(size_t, size_t) { nodes.clear(); triangles.clear(); }
+  virtual void onNodes(const flat::Point3* n, size_t count) { nodes.insert(nodes.end(), n, n + count); }
+  virtual void onTriangles(const flat::IndexTriangle* t, size_t count) { triangles.insert(triangles.end(), t, t + count); }
+  virtual void onEnd() {}
+
+  bool sameMesh(const flat::Mesh& mesh) const {
+    flat::Mesh recorded;
+    recorded.setMesh(nodes, triangles);
+    return ::sameMesh(recorded, mesh);
+  }
+
+  std::vector<flat::Point3> nodes;
+  std::vector<flat::IndexTriangle> triangles;
+};
 
-      in_mesh >> mesh1;
-      in_mesh.close();
+// Path of the cache entry of 'plan', which is removed so that the cache starts
+// without it
+std::string cacheEntry(const flat::FloorPlan& plan, const flat::FlatMesh& mesh) {
+  char name[17];
+  std::snprintf(name, sizeof(name), "%016llx", (unsigned long long) flat::MeshCache::hash(flat::MeshCache::key(plan, mesh)));
 
-      std::ofstream out_mesh(mesh1_out);
-      if (out_mesh.is_open()) {
-        out_mesh << mesh1;
-        out_mesh.close();
+  std::string path = std::string(cache_dir) + "/" + name;
+  std::remove(path.c_str());
+  return path;
+}
+
+bool fileExists(const std::string& path) {
+  return std::ifstream(path.c_str()).is_open();
+}
+
+bool testMeshCache() {
+#ifdef _WIN32
+  _mkdir(cache_dir);
+#else
+  mkdir(cache_dir, 0755);
+#endif
+  std::remove((std::string(cache_dir) + "/index").c_str());
+
+  flat::FloorPlan plan1 = rectanglePlan(0, 0, 4, 3, 1, 0.5), plan2 = rectanglePlan(0, 0, 5, 3, 1, 0.5);
+  flat::FlatMesh mesh1, mesh2;
+  mesh1.createFromPlan(&plan1);
+  mesh2.createFromPlan(&plan2);
+
+  flat::FlatMesh mesh;
+  std::string entry1 = cacheEntry(plan1, mesh), entry2 = cacheEntry(plan2, mesh);
+  flat::MeshCache cache(cache_dir);
+  MeshRecorder recorder;
+
+  // A miss creates the mesh and stores it, and a hit reads the same mesh
+  if (cache.createFromPlan(&plan1, mesh, recorder) != flat::MeshCache::Result::CREATED || !recorder.sameMesh(mesh1) ||
+      cache.createFromPlan(&plan1, mesh, recorder) != flat::MeshCache::Result::CACHED || !recorder.sameMesh(mesh1)) {
+    std::cerr << "The cached mesh differs from the created one\n";
+    return false;
+  }
+
+  // Each entry fits alone, so adding the second one evicts the first one
+  std::ifstream is(entry1.c_str(), std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+  is.close();
+  cache.setMaxSize(data.size() + data.size() / 2);
+
+  if (cache.createFromPlan(&plan2, mesh, recorder) != flat::MeshCache::Result::CREATED || !recorder.sameMesh(mesh2) ||
+      fileExists(entry1) || !fileExists(entry2)) {
+    std::cerr << "The least recently used mesh was not evicted\n";
+    return false;
+  }
+  cache.setMaxSize(flat::MeshCache::DEFAULT_MAX_SIZE);
+
+  // A truncated entry is treated as missing, and the mesh is created again
+  std::ofstream(entry1.c_str(), std::ios::binary).write(data.data(), data.size() - 1);
+
+  if (cache.createFromPlan(&plan1, mesh, recorder) != flat::MeshCache::Result::CREATED || !recorder.sameMesh(mesh1) ||
+      cache.createFromPlan(&plan1, mesh, recorder) != flat::MeshCache::Result::CACHED) {
+    std::cerr << "A truncated cache entry was not created again\n";
+    return false;
+  }
+
+  // An entry of the right size with a triangle out of range is only found to
+  // be corrupt while it's read, so it fails and it's removed
+  std::fill(data.end() - 4, data.end(), '\xff');
+  std::ofstream(entry1.c_str(), std::ios::binary).write(data.data(), data.size());
+
+  if (cache.createFromPlan(&plan1, mesh, recorder) != flat::MeshCache::Result::FAILED || fileExists(entry1)) {
+    std::cerr << "A corrupt cache entry was not removed\n";
+    return false;
+  }
+
+  std::remove(entry2.c_str());
+  std::remove((std::string(cache_dir) + "/index").c_str());
+
+  return true;
+}
+
+bool testNodeWelding() {
+  // Nodes are found within the tolerance in every direction, also across the
+  // borders of the cells of the grid, and not further away
+  const double epsilon = 0.001;
+  flat::NodeGrid grid(epsilon);
+
+  for (size_t i = 0; i < 1000; ++i)
+    grid.insert(flat::Point3(i * 0.0137, i * 0.0071, -(i * 0.0093)), i);
+
+  for (size_t i = 0; i < 1000; ++i) {
+    for (int dir = 0; dir < 8; ++dir) {
+      double dx = dir & 1? epsilon : -epsilon, dy = dir & 2? epsilon : -epsilon, dz = dir & 4? epsilon : -epsilon;
+      flat::Point3 node(i * 0.0137, i * 0.0071, -(i * 0.0093));
+
+      if (grid.find(node + flat::Point3(0.9 * dx, 0.9 * dy, 0.9 * dz)) != i ||
+          grid.find(node + flat::Point3(2 * dx, 0, 0)) != std::numeric_limits<size_t>::max()) {
+        std::cerr << "The node grid doesn't find the nodes within the tolerance\n";
+        return false;
+      }
+    }
+  }
+
+  // Merging a mesh with itself keeps its nodes, and every triangle twice
+  flat::FloorPlan plan = rectanglePlan(0, 0, 4, 3, 1, 0.5);
+  flat::FlatMesh mesh;
+  mesh.createFromPlan(&plan);
+
+  flat::Mesh merged(mesh);
+  merged.merge(mesh);
+
+  if (merged.getNodesView().size() != mesh.getNodesView().size() ||
+      merged.getMeshView().size() != 2 * mesh.getMeshView().size()) {
+    std::cerr << "The nodes of merged meshes are not welded\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool testLongEdges() {
+  // Comb whose teeth span every bucket of the prepared plan, so that their
+  // edges are kept apart from the buckets
+  const int teeth = 50;
+  const double height = 20;
+  std::vector<flat::Point2> nodes = {flat::Point2(0, 0), flat::Point2(2 * teeth, 0)};
+
+  for (int j = teeth; j > 0; --j) {
+    nodes.push_back(flat::Point2(2 * j, height));
+    nodes.push_back(flat::Point2(2 * j - 1, height));
+    nodes.push_back(flat::Point2(2 * j - 1, 1));
+    nodes.push_back(flat::Point2(2 * j - 2, 1));
+  }
+
+  flat::FloorPlan plan;
+  plan.setNodes(nodes);
+  plan.setHeight(1);
+  plan.setTriangleSize(0.5);
+
+  flat::PreparedFloorPlan prepared(plan);
+  flat::ScanlineClassifier classifier(plan);
+
+  if (prepared.longEdges().empty()) {
+    std::cerr << "The comb has no long edges\n";
+    return false;
+  }
+
+  // Every point is classified as FloorPlan does, and points of the boundary
+  // are assigned to the last edge that contains them
+  std::vector<double> xs;
+  for (double x = -1; x <= 2 * teeth + 1; x += 0.25)
+    xs.push_back(x);
+
+  std::vector<flat::PointLocation> row;
+  std::vector<size_t> boundary_edges;
+
+  for (double y = -1; y <= height + 1; y += 0.25) {
+    classifier.classifyRow(y, xs, row, &boundary_edges);
+
+    for (size_t i = 0; i < xs.size(); ++i) {
+      flat::Point2 p(xs[i], y);
+      flat::PointLocation expected = plan.pointInBoundary(p)? flat::PointLocation::BOUNDARY :
+                                     plan.pointInside(p)? flat::PointLocation::INSIDE : flat::PointLocation::OUTSIDE;
+
+      size_t last = plan.segmentCount();
+      for (size_t k = 0; k < plan.segmentCount(); ++k)
+        if (plan.getSegmentAt(k).contains(p))
+          last = k;
+
+      if (prepared.classify(p) != expected || row[i] != expected || boundary_edges[i] != last) {
+        std::cerr << "The point (" << xs[i] << ", " << y << ") is classified wrong\n";
+        return false;
       }
-      else {
-        std::cerr << "Error trying to open the output file\n";
+    }
+  }
+
+  return true;
+}
+
+bool testVTURoundTrip() {
+  // Coordinates that aren't exact in binary, which must be read back the same
+  flat::FloorPlan plan = rectanglePlan(0.1, 0.3, 3, 2, 0.7, 0.1);
+  flat::FlatMesh mesh;
+  mesh.createFromPlan(&plan);
+
+  if (mesh.empty()) {
+    std::cerr << "The mesh to write is empty\n";
+    return false;
+  }
+
+  const flat::VTUEncoding encodings[] = {flat::VTUEncoding::ASCII, flat::VTUEncoding::BASE64,
+                                         flat::VTUEncoding::APPENDED};
+
+  for (int e = 0; e < 3; ++e) {
+    for (int compressed = 0; compressed < 2; ++compressed) {
+      // Written at once by the formatter, and as it's created by the sink
+      flat::VTUMeshFormatter formatter(encodings[e], compressed);
+      std::stringstream formatted, streamed;
+      formatter.writeMesh(formatted, mesh);
+
+      flat::FlatMesh sink_mesh;
+      flat::VTUMeshSink sink(streamed, encodings[e], compressed);
+      sink_mesh.createFromPlan(&plan, sink);
+
+      flat::Mesh read_formatted, read_streamed;
+      if (!formatter.readMesh(formatted, read_formatted) || !formatter.readMesh(streamed, read_streamed) ||
+          !sameMesh(read_formatted, mesh) || !sameMesh(read_streamed, mesh)) {
+        std::cerr << "The VTU mesh with encoding " << e << (compressed? " and compression" : "")
+                  << " is not read back the same\n";
         return false;
       }
     }
-    else {
-      std::cerr << "Error trying to open the input file\n";
+  }
+
+  return true;
+}
+
+// Tells if 'formatter' reads a mesh from 'data', through a stream
+bool readsMesh(const flat::MeshFormatter& formatter, const std::string& data) {
+  std::istringstream is(data);
+  flat::Mesh mesh;
+  return (bool) formatter.readMesh(is, mesh);
+}
+
+bool testVTUCorruption() {
+  flat::FloorPlan plan = rectanglePlan(0, 0, 3, 2, 1, 0.5);
+  flat::FlatMesh mesh;
+  mesh.createFromPlan(&plan);
+
+  const flat::VTUEncoding encodings[] = {flat::VTUEncoding::ASCII, flat::VTUEncoding::BASE64,
+                                         flat::VTUEncoding::APPENDED};
+  const char* file_name = "test_gen.vtu";
+
+  for (int e = 0; e < 3; ++e) {
+    for (int compressed = 0; compressed < 2; ++compressed) {
+      flat::VTUMeshFormatter formatter(encodings[e], compressed);
+      std::ostringstream os;
+      formatter.writeMesh(os, mesh);
+      std::string data = os.str();
+
+      // Whitespace may follow the end of the file, but nothing else
+      if (!readsMesh(formatter, data + "  \n") || readsMesh(formatter, data + "x") ||
+          readsMesh(formatter, data + "</VTKFile>")) {
+        std::cerr << "The VTU file with encoding " << e << " accepts data after its end\n";
+        return false;
+      }
+
+      // The last character is a line break, so the file is cut from the one
+      // before it
+      size_t cuts[] = {2, 12, 30, data.size() / 2};
+      for (size_t c = 0; c < 4; ++c) {
+        if (readsMesh(formatter, data.substr(0, data.size() - cuts[c]))) {
+          std::cerr << "The VTU file with encoding " << e << " is read when truncated\n";
+          return false;
+        }
+      }
+
+      // Files are read from memory maps, and failures keep the mesh unchanged
+      std::ofstream(file_name, std::ios::binary).write(data.data(), data.size() - 2);
+      flat::Mesh read_mesh(mesh);
+
+      if (formatter.readMeshFile(file_name, read_mesh) || !sameMesh(read_mesh, mesh)) {
+        std::cerr << "The truncated VTU file changes the mesh\n";
+        return false;
+      }
+
+      std::ofstream(file_name, std::ios::binary).write(data.data(), data.size());
+      read_mesh = flat::Mesh();
+
+      if (!formatter.readMeshFile(file_name, read_mesh) || !sameMesh(read_mesh, mesh)) {
+        std::cerr << "The VTU file is not read back the same\n";
+        return false;
+      }
+    }
+  }
+
+  std::remove(file_name);
+  return true;
+}
+
+bool testBemgenReadWrite() {
+  // Large enough to be split in several chunks when it's read from a file
+  flat::FloorPlan plan = rectanglePlan(0.1, 0.3, 20, 20, 0.7, 0.1);
+  flat::FlatMesh mesh;
+  mesh.createFromPlan(&plan);
+
+  flat::BemgenMeshFormatter formatter;
+  std::ostringstream os;
+  formatter.writeMesh(os, mesh);
+  std::string data = os.str();
+
+  std::istringstream is(data);
+  flat::Mesh read_mesh;
+
+  if (mesh.empty() || !formatter.readMesh(is, read_mesh) || !sameMesh(read_mesh, mesh)) {
+    std::cerr << "The Bemgen mesh is not read back the same\n";
+    return false;
+  }
+
+  // Whitespace may follow the last triangle, but no other tokens
+  if (!readsMesh(formatter, data + " \n\n") || readsMesh(formatter, data + " 7") ||
+      readsMesh(formatter, data + "1 2 3\n")) {
+    std::cerr << "The Bemgen file accepts tokens after the last triangle\n";
+    return false;
+  }
+
+  // Cut at the end of a token, so that no number is just made shorter
+  std::string trimmed = data.substr(0, data.find_last_not_of(" \n") + 1);
+  size_t cuts[] = {2, 5, trimmed.size() / 2};
+
+  for (size_t c = 0; c < 3; ++c) {
+    if (readsMesh(formatter, trimmed.substr(0, trimmed.find_last_of(" \n", trimmed.size() - cuts[c])))) {
+      std::cerr << "The Bemgen file is read when truncated\n";
       return false;
     }
   }
-  else {
-    std::cerr << "Error trying to open the input file\n";
+
+  // The file is parsed in parallel chunks from a memory map
+  const char* file_name = "test_gen.txt";
+  std::ofstream(file_name, std::ios::binary).write(data.data(), data.size());
+  read_mesh = flat::Mesh();
+  bool read = formatter.readMeshFile(file_name, read_mesh);
+  std::remove(file_name);
+
+  if (!read || !sameMesh(read_mesh, mesh)) {
+    std::cerr << "The Bemgen file is not read back the same\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool testNumberFormatting() {
+  // Doubles must be written as printf writes them, both the ones converted by
+  // the fast path and the ones left to the standard library
+  std::vector<double> values = {0.0, -0.0, 1.0, -1.0, 0.1, 0.5, 2.675, 1e15, 1e16, 123456789012345.6,
+                                999999999999999.9, 1e-5, 1e-300, 1e300, 4.9e-324, -3.25, 0.7 * 3,
+                                HUGE_VAL, -HUGE_VAL};
+  std::srand(1);
+  for (int i = 0; i < 100000; ++i)
+    values.push_back((std::rand() - RAND_MAX / 2) * std::pow(10.0, std::rand() % 30 - 15) / RAND_MAX);
+
+  char expected[64], output[flat::utils::MAX_NUMBER_SIZE];
+
+  for (auto i = values.begin(); i != values.end(); ++i) {
+    std::snprintf(expected, sizeof(expected), "%.15g", *i);
+    size_t sz = flat::utils::formatDouble(*i, output);
+
+    if (std::string(output, sz) != expected) {
+      std::cerr << "The double " << expected << " is written as " << std::string(output, sz) << '\n';
+      return false;
+    }
+  }
+
+  uint64_t integers[] = {0, 7, 10, 4294967295ULL, 4294967296ULL, 18446744073709551615ULL};
+  for (size_t i = 0; i < 6; ++i) {
+    std::snprintf(expected, sizeof(expected), "%llu", (unsigned long long) integers[i]);
+    size_t sz = flat::utils::formatUnsigned(integers[i], output);
+
+    if (std::string(output, sz) != expected) {
+      std::cerr << "The integer " << expected << " is written as " << std::string(output, sz) << '\n';
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool testParallelText() {
+  // Text meshes are the same whatever the amount of threads that format them
+  flat::FloorPlan plan = rectanglePlan(0.1, 0.3, 20, 20, 0.7, 0.1);
+  flat::FlatMesh mesh;
+  mesh.createFromPlan(&plan);
+
+  flat::BemgenMeshFormatter bemgen;
+  flat::VTUMeshFormatter vtu;
+  std::string bemgen_single, vtu_single;
+
+  for (int threads = 1; threads <= 8; threads *= 2) {
+    std::ostringstream bemgen_os, vtu_os;
+    bemgen.setThreads(threads);
+    vtu.setThreads(threads);
+    bemgen.writeMesh(bemgen_os, mesh);
+    vtu.writeMesh(vtu_os, mesh);
+
+    if (threads == 1) {
+      bemgen_single = bemgen_os.str();
+      vtu_single = vtu_os.str();
+    }
+    else if (bemgen_os.str() != bemgen_single || vtu_os.str() != vtu_single) {
+      std::cerr << "The text written with " << threads << " threads differs\n";
+      return false;
+    }
+  }
+
+  return !bemgen_single.empty() && !vtu_single.empty();
+}
+
+bool testFMeshReadWrite() {
+  flat::FloorPlan plan = rectanglePlan(0.1, 0.3, 3, 2, 0.7, 0.1);
+  flat::FlatMesh mesh;
+  mesh.createFromPlan(&plan);
+
+  // Written at once by the formatter, with the group of each triangle, and as
+  // it's created by the sink
+  std::vector<uint32_t> groups(mesh.getMeshView().size());
+  for (size_t i = 0; i < groups.size(); ++i)
+    groups[i] = i % 3;
+
+  flat::FMeshFormatter formatter;
+  std::ostringstream formatted, streamed;
+  formatter.writeMesh(formatted, mesh, groups);
+
+  flat::FlatMesh sink_mesh;
+  flat::FMeshSink sink(streamed);
+  sink_mesh.createFromPlan(&plan, sink);
+
+  std::string data = formatted.str();
+  std::istringstream formatted_is(data), streamed_is(streamed.str());
+  flat::Mesh read_formatted, read_streamed;
+  flat::MappedMesh mapped(data.data(), data.size());
+
+  if (mesh.empty() || !formatter.readMesh(formatted_is, read_formatted) ||
+      !formatter.readMesh(streamed_is, read_streamed) || !sameMesh(read_formatted, mesh) ||
+      !sameMesh(read_streamed, mesh) || !mapped.valid() || !mapped.verify() ||
+      mapped.getGroupsView().toVector() != groups) {
+    std::cerr << "The fmesh file is not read back the same\n";
+    return false;
+  }
+
+  // Truncated files, trailing data and changes caught by the checksum are
+  // rejected
+  std::string changed = data;
+  changed[mapped.getHeader().nodes_offset] ^= 1;
+
+  if (readsMesh(formatter, data.substr(0, data.size() - 1)) || readsMesh(formatter, data.substr(0, data.size() / 2)) ||
+      readsMesh(formatter, data + '\0') || readsMesh(formatter, changed)) {
+    std::cerr << "A damaged fmesh file is read\n";
+    return false;
+  }
+
+  // Files are mapped in memory
+  const char* file_name = "test_gen.fmesh";
+  std::ofstream(file_name, std::ios::binary).write(data.data(), data.size());
+  flat::Mesh read_file;
+  bool read = formatter.readMeshFile(file_name, read_file);
+  std::remove(file_name);
+
+  if (!read || !sameMesh(read_file, mesh)) {
+    std::cerr << "The fmesh file is not read back the same from disk\n";
     return false;
   }
 
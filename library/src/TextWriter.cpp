@@ -0,0 +1,103 @@
+#include "FlatMesher/TextWriter.h"
+#include "FlatMesher/IndexTriangle.h"
+#include "FlatMesher/Point2.h"
+#include "FlatMesher/Point3.h"
+
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace flat;
+
+const size_t TextWriter::BUFFER_SIZE;
+const size_t TextWriter::INITIAL_BUFFER_SIZE;
+const size_t TextWriter::PART_SIZE;
+
+void TextWriter::flush() {
+  if (m_os == NULL)
+    return;
+
+  if (m_used > 0)
+    m_os->write(m_buffer.data(), m_used);
+
+  m_used = 0;
+}
+
+void TextWriter::write(const char* text, size_t sz) {
+  if (m_os != NULL && sz >= INITIAL_BUFFER_SIZE) {
+    flush();
+    m_os->write(text, sz);
+    return;
+  }
+
+  std::memcpy(reserve(sz), text, sz);
+  m_used += sz;
+}
+
+void TextWriter::writeParallel(size_t count, int threads, const RangeFormat& format) {
+  int total_parts = (count + PART_SIZE - 1) / PART_SIZE;
+
+#ifdef _OPENMP
+  if (threads <= 0)
+    threads = omp_get_max_threads();
+#endif
+
+  if (threads <= 1 || total_parts <= 1) {
+    format(*this, 0, count);
+    return;
+  }
+
+  // Each thread formats its parts into its own writer, and the ordered section
+  // writes them one after another, while the other threads keep formatting
+  // the next ones. The text already in this writer goes first
+  flush();
+
+  #pragma omp parallel num_threads(threads)
+  {
+    TextWriter part;
+
+    #pragma omp for ordered schedule(static, 1)
+    for (int p = 0; p < total_parts; ++p) {
+      size_t first = p * PART_SIZE, last = std::min(first + PART_SIZE, count);
+
+      part.clear();
+      format(part, first, last);
+
+      #pragma omp ordered
+      write(part.data(), part.size());
+    }
+  }
+}
+
+void TextWriter::grow(size_t bytes) {
+  // The buffer starts small, so that short texts don't allocate all of it, and
+  // doubles until it reaches BUFFER_SIZE. From then on, it's written when full
+  size_t sz = std::max(m_buffer.size(), INITIAL_BUFFER_SIZE);
+  while (sz < m_used + bytes && sz < BUFFER_SIZE)
+    sz *= 2;
+
+  if (sz < m_used + bytes) {
+    if (m_os != NULL) {
+      flush();
+      sz = std::max(sz, bytes);
+    }
+    else
+      sz = std::max(2 * sz, m_used + bytes);
+  }
+
+  m_buffer.resize(sz);
+}
+
+TextWriter& TextWriter::operator<<(const Point2& p) {
+  return *this << p.getX() << ' ' << p.getY();
+}
+
+TextWriter& TextWriter::operator<<(const Point3& p) {
+  return *this << p.getX() << ' ' << p.getY() << ' ' << p.getZ();
+}
+
+TextWriter& TextWriter::operator<<(const IndexTriangle& triangle) {
+  return *this << triangle.getI() << ' ' << triangle.getJ() << ' ' << triangle.getK();
+}
@@ -1,60 +1,739 @@
 #include "FlatMesher/VTUMeshFormatter.h"
+#include "FlatMesher/VTUMeshSink.h"
+#include "FlatMesher/MappedFile.h"
 #include "FlatMesher/Mesh.h"
+#include "FlatMesher/NumberParser.h"
 
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
 #include <vector>
 
+#ifdef FLATMESHER_ZLIB
+#include <zlib.h>
+#endif
+
 using namespace flat;
 
-std::ostream& VTUMeshFormatter::writeMesh(std::ostream& os, const Mesh& mesh) const {
-  std::vector<Point3> nodes = mesh.getNodes();
-  std::vector<IndexTriangle> triangles = mesh.getMesh();
+namespace {
+
+// Types of the values of a DataArray, with the size of each value in bytes
+enum class ValueType {
+  INVALID,
+  INT8, UINT8, INT16, UINT16, INT32, UINT32, INT64, UINT64,
+  FLOAT32, FLOAT64
+};
+
+ValueType valueType(const std::string& name) {
+  static const char* const NAMES[] = {"Int8", "UInt8", "Int16", "UInt16", "Int32", "UInt32", "Int64", "UInt64",
+                                      "Float32", "Float64"};
+
+  for (int i = 0; i < 10; ++i)
+    if (name == NAMES[i])
+      return ValueType(i + 1);
+
+  return ValueType::INVALID;
+}
+
+size_t valueSize(ValueType type) {
+  switch (type) {
+  case ValueType::INT8: case ValueType::UINT8: return 1;
+  case ValueType::INT16: case ValueType::UINT16: return 2;
+  case ValueType::INT32: case ValueType::UINT32: case ValueType::FLOAT32: return 4;
+  case ValueType::INT64: case ValueType::UINT64: case ValueType::FLOAT64: return 8;
+  default: return 0;
+  }
+}
+
+// Tag of the XML, with its attributes. Only the tags before the appended data
+// are read
+struct Tag {
+  std::string name;
+  std::vector<std::pair<std::string, std::string>> attributes;
+  bool closing, empty;
+
+  std::string attribute(const char* key, const char* default_value = "") const {
+    for (auto i = attributes.begin(); i != attributes.end(); ++i)
+      if (i->first == key)
+        return i->second;
+
+    return default_value;
+  }
+};
+
+// DataArray of the file. 'payload' is the text between its tags, and 'offset'
+// the position of its data in the appended section
+struct DataArray {
+  DataArray(): type(ValueType::INVALID), offset(0), payload_begin(NULL), payload_end(NULL), found(false) {}
+
+  ValueType type;
+  std::string format;
+  uint64_t offset;
+  const char* payload_begin;
+  const char* payload_end;
+  bool found;
+};
+
+// Everything read from the XML that is needed to decode the arrays
+struct FileLayout {
+  FileLayout(): header_size(4), swap(false), compressed(false), appended_begin(NULL), appended_end(NULL),
+                appended_base64(false), total_nodes(0), total_cells(0) {}
+
+  size_t header_size;
+  bool swap, compressed;
+  const char* appended_begin;
+  const char* appended_end;
+  bool appended_base64;
+  uint64_t total_nodes, total_cells;
+  DataArray points, connectivity, offsets, types;
+};
+
+// Reads the tag that starts at 'p', which points to a '<'. Returns the position
+// after it, or NULL if it's not well formed
+const char* readTag(const char* p, const char* end, Tag& tag) {
+  tag.name.clear();
+  tag.attributes.clear();
+  tag.closing = tag.empty = false;
+
+  ++p;
+  if (p != end && *p == '/') {
+    tag.closing = true;
+    ++p;
+  }
+
+  const char* name = p;
+  while (p != end && *p != '>' && *p != '/' && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t')
+    ++p;
+  tag.name.assign(name, p);
+
+  for (;;) {
+    p = utils::skipSpaces(p, end);
+    if (p == end)
+      return NULL;
+
+    if (*p == '>')
+      return p + 1;
+
+    if (*p == '/' || *p == '?') {
+      tag.empty = *p == '/';
+      ++p;
+      continue;
+    }
+
+    const char* key = p;
+    while (p != end && *p != '=' && *p != '>' && *p != ' ')
+      ++p;
+    std::string key_str(key, p);
+
+    p = utils::skipSpaces(p, end);
+    if (p == end || *p != '=')
+      return NULL;
+
+    p = utils::skipSpaces(p + 1, end);
+    if (p == end || (*p != '"' && *p != '\''))
+      return NULL;
+
+    char quote = *p++;
+    const char* value = p;
+    while (p != end && *p != quote)
+      ++p;
+    if (p == end)
+      return NULL;
+
+    tag.attributes.push_back(std::make_pair(key_str, std::string(value, p)));
+    ++p;
+  }
+}
+
+inline bool isSpace(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+// Position of the closing tag 'name' that ends the text before 'end', apart
+// from whitespace, or NULL if there isn't one
+const char* closingTagBefore(const char* begin, const char* end, const std::string& name) {
+  while (end != begin && isSpace(end[-1]))
+    --end;
+
+  std::string tag = "</" + name + ">";
+  if ((size_t) (end - begin) < tag.size() || std::memcmp(end - tag.size(), tag.data(), tag.size()) != 0)
+    return NULL;
+
+  return end - tag.size();
+}
+
+// Single pass over the XML, which stops at the beginning of the appended data.
+// Tags must be nested correctly and the file must be complete, so that
+// truncated files are rejected: it must end with </VTKFile>, or with
+// </AppendedData> and </VTKFile> after the appended data
+bool readLayout(const char* data, const char* end, FileLayout& layout) {
+  enum class Section { NONE, POINTS, CELLS };
+  Section section = Section::NONE;
+  bool vtk_file = false, grid = false;
+  int pieces = 0;
+
+  // Tags opened and not closed yet
+  std::vector<std::string> open;
+
+  auto complete = [&]() {
+    return vtk_file && grid && pieces == 1 && layout.points.found && layout.connectivity.found;
+  };
 
-  std::streamsize prec = os.precision();
-  os.precision(15);
+  const char* p = data;
+  Tag tag;
 
-  os << "<?xml version=\"1.0\"?>\n"
-     << "<VTKFile type=\"UnstructuredGrid\" version=\"0.1\">\n"
-     << "  <UnstructuredGrid>\n"
-     << "    <Piece NumberOfPoints=\"" << nodes.size() << "\" NumberOfCells=\"" << triangles.size() << "\">\n"
-     << "      <Points>\n"
-     << "        <DataArray type=\"Float32\" Name=\"points\" NumberOfComponents=\"3\" format=\"ascii\">\n";
+  while ((p = std::find(p, end, '<')) != end) {
+    if (end - p >= 4 && std::memcmp(p, "<!--", 4) == 0) {
+      const char* comment_end = std::search(p, end, "-->", "-->" + 3);
+      if (comment_end == end)
+        return false;
 
-  for (auto i = nodes.begin(); i != nodes.end(); ++i)
-    os << "          " << *i << '\n';
+      p = comment_end + 3;
+      continue;
+    }
 
-  os << "        </DataArray>\n"
-     << "      </Points>\n"
-     << "      <Cells>\n"
-     << "        <DataArray type=\"Int32\" Name=\"connectivity\" format=\"ascii\">\n";
+    p = readTag(p, end, tag);
+    if (p == NULL)
+      return false;
 
-  for (auto i = triangles.begin(); i != triangles.end(); ++i)
-    os << "          " << *i << '\n';
+    if (tag.closing) {
+      if (open.empty() || open.back() != tag.name)
+        return false;
+      open.pop_back();
 
-  os << "        </DataArray>\n"
-     << "        <DataArray type=\"Int32\" Name=\"offsets\" format=\"ascii\">\n";
+      // Only whitespace may follow the root
+      if (open.empty())
+        return utils::skipSpaces(p, end) == end && complete();
 
-  for (size_t i = 1; i <= triangles.size(); ++i)
-    os << "          " << 3 * i << '\n';
+      if (tag.name == "Points" || tag.name == "Cells")
+        section = Section::NONE;
+      continue;
+    }
 
-  os << "        </DataArray>\n"
-     << "        <DataArray type=\"UInt8\" Name=\"types\" format=\"ascii\">\n";
+    // The XML declaration comes before the root, and isn't closed
+    if (tag.name.empty() || tag.name[0] == '?') {
+      if (!open.empty() || tag.name != "?xml")
+        return false;
+      continue;
+    }
+    if (!tag.empty)
+      open.push_back(tag.name);
 
-  for (size_t i = 0; i < triangles.size(); ++i)
-    os << "          5\n";
+    if (tag.name == "VTKFile") {
+      if (open.size() != 1 || tag.attribute("type") != "UnstructuredGrid")
+        return false;
 
-  os << "        </DataArray>\n"
-     << "      </Cells>\n"
-     << "    </Piece>\n"
-     << "  </UnstructuredGrid>\n"
-     << "</VTKFile>\n";
+      vtk_file = true;
+      layout.header_size = tag.attribute("header_type", "UInt32") == "UInt64"? 8 : 4;
 
-  os.precision(prec);
+      uint16_t probe = 1;
+      unsigned char first;
+      std::memcpy(&first, &probe, 1);
+      std::string host_order = first == 1? "LittleEndian" : "BigEndian";
+      layout.swap = tag.attribute("byte_order", host_order.c_str()) != host_order;
+
+      std::string compressor = tag.attribute("compressor");
+      if (!compressor.empty() && compressor != "vtkZLibDataCompressor")
+        return false;
+      layout.compressed = !compressor.empty();
+    }
+    else if (tag.name == "UnstructuredGrid")
+      grid = true;
+    else if (tag.name == "Piece") {
+      // Only files with a single piece are supported
+      if (++pieces > 1)
+        return false;
+
+      std::string nodes = tag.attribute("NumberOfPoints"), cells = tag.attribute("NumberOfCells");
+      const char* nodes_end = nodes.data() + nodes.size();
+      const char* cells_end = cells.data() + cells.size();
+
+      if (utils::parseUnsigned(nodes.data(), nodes_end, layout.total_nodes) != nodes_end ||
+          utils::parseUnsigned(cells.data(), cells_end, layout.total_cells) != cells_end)
+        return false;
+    }
+    else if (tag.name == "Points")
+      section = Section::POINTS;
+    else if (tag.name == "Cells")
+      section = Section::CELLS;
+    else if (tag.name == "DataArray") {
+      DataArray* array = NULL;
+      std::string name = tag.attribute("Name");
+
+      if (section == Section::POINTS && !layout.points.found)
+        array = &layout.points;
+      else if (section == Section::CELLS && name == "connectivity")
+        array = &layout.connectivity;
+      else if (section == Section::CELLS && name == "offsets")
+        array = &layout.offsets;
+      else if (section == Section::CELLS && name == "types")
+        array = &layout.types;
+
+      const char* payload_end = p;
+      if (!tag.empty) {
+        payload_end = std::find(p, end, '<');
+        if (payload_end == end)
+          return false;
+      }
+
+      if (array != NULL) {
+        array->found = true;
+        array->type = valueType(tag.attribute("type"));
+        array->format = tag.attribute("format");
+        array->payload_begin = p;
+        array->payload_end = payload_end;
+
+        std::string offset = tag.attribute("offset", "0");
+        const char* offset_end = offset.data() + offset.size();
+        if (utils::parseUnsigned(offset.data(), offset_end, array->offset) != offset_end)
+          return false;
+
+        if (array->type == ValueType::INVALID)
+          return false;
+      }
+
+      p = payload_end;
+    }
+    else if (tag.name == "AppendedData") {
+      // Everything after the '_' is data, which may contain any character, so
+      // the closing tags are looked for from the end of the file
+      const char* file_end = closingTagBefore(p, end, "VTKFile");
+      const char* data_end = file_end == NULL? NULL : closingTagBefore(p, file_end, "AppendedData");
+      if (open.size() != 2 || data_end == NULL)
+        return false;
+
+      const char* underscore = std::find(p, data_end, '_');
+      if (underscore == data_end)
+        return false;
+
+      std::string encoding = tag.attribute("encoding", "raw");
+      if (encoding != "raw" && encoding != "base64")
+        return false;
+
+      layout.appended_base64 = encoding == "base64";
+      layout.appended_begin = underscore + 1;
+      layout.appended_end = data_end;
+      return complete();
+    }
+  }
+
+  // The root wasn't closed
+  return false;
+}
+
+inline void swapBytes(char* value, size_t size) {
+  std::reverse(value, value + size);
+}
+
+// Reads 'count' integers of 'size' bytes from 'data'
+bool readHeader(const char* data, size_t count, size_t size, bool swap, std::vector<uint64_t>& header) {
+  header.resize(count);
+
+  for (size_t i = 0; i < count; ++i) {
+    char value[8];
+    std::memcpy(value, data + i * size, size);
+    if (swap)
+      swapBytes(value, size);
+
+    if (size == 8)
+      std::memcpy(&header[i], value, 8);
+    else {
+      uint32_t value32;
+      std::memcpy(&value32, value, 4);
+      header[i] = value32;
+    }
+  }
+
+  return true;
+}
+
+// Decodes the next 'chars' base64 characters after 'begin', skipping any
+// whitespace, appending the bytes to 'output'. Returns the position after the
+// last character decoded, or NULL if there aren't enough valid characters
+const char* decodeBase64(const char* begin, const char* end, size_t chars, std::vector<char>& output) {
+  struct Table {
+    signed char digits[256];
+
+    Table() {
+      const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+      std::memset(digits, -1, sizeof(digits));
+      for (int i = 0; i < 64; ++i)
+        digits[(unsigned char) alphabet[i]] = i;
+    }
+  };
+  static const Table table;
+
+  // The bytes are written in place, and the unused ones removed at the end
+  size_t written = output.size();
+  output.resize(written + (chars + 3) / 4 * 3);
+  unsigned char* out = reinterpret_cast<unsigned char*>(output.data());
+
+  unsigned char group[4];
+  size_t group_sz = 0, padding = 0;
+  const char* p = begin;
+
+  while (chars > 0) {
+    // Groups of 4 digits without whitespace or padding are the common case
+    if (group_sz == 0 && chars >= 4 && end - p >= 4) {
+      signed char a = table.digits[(unsigned char) p[0]], b = table.digits[(unsigned char) p[1]];
+      signed char c = table.digits[(unsigned char) p[2]], d = table.digits[(unsigned char) p[3]];
+
+      if ((a | b | c | d) >= 0) {
+        out[written] = (unsigned char) ((a << 2) | (b >> 4));
+        out[written + 1] = (unsigned char) ((b << 4) | (c >> 2));
+        out[written + 2] = (unsigned char) ((c << 6) | d);
+        written += 3;
+        p += 4;
+        chars -= 4;
+        continue;
+      }
+    }
+
+    p = utils::skipSpaces(p, end);
+    if (p == end)
+      return NULL;
+
+    char c = *p++;
+    --chars;
+
+    if (c == '=') {
+      group[group_sz++] = 0;
+      ++padding;
+    }
+    else {
+      signed char digit = table.digits[(unsigned char) c];
+      if (digit < 0 || padding > 0)
+        return NULL;
+      group[group_sz++] = digit;
+    }
+
+    if (group_sz == 4) {
+      unsigned char bytes[3] = {(unsigned char) ((group[0] << 2) | (group[1] >> 4)),
+                                (unsigned char) ((group[1] << 4) | (group[2] >> 2)),
+                                (unsigned char) ((group[2] << 6) | group[3])};
+
+      size_t count = 3 - std::min(padding, (size_t) 2);
+      std::memcpy(out + written, bytes, count);
+      written += count;
+      group_sz = 0;
+      padding = 0;
+    }
+  }
+
+  output.resize(written);
+  return group_sz == 0? p : NULL;
+}
+
+// Amount of base64 characters that encode 'bytes' bytes
+inline size_t base64Chars(uint64_t bytes) {
+  return (bytes + 2) / 3 * 4;
+}
+
+// Decompresses the blocks described by 'header', which follow it in 'data'
+bool decompress(const std::vector<uint64_t>& header, const char* data, size_t size, std::vector<char>& output) {
+#ifdef FLATMESHER_ZLIB
+  uint64_t blocks = header[0], block_size = header[1], last_size = header[2];
+  uint64_t total = blocks == 0? 0 : (blocks - 1) * block_size + (last_size == 0? block_size : last_size);
+
+  output.resize(total);
+  uint64_t input = 0;
+
+  for (uint64_t i = 0; i < blocks; ++i) {
+    uint64_t compressed_size = header[3 + i];
+    uLongf expected = (i + 1 == blocks && last_size != 0)? last_size : block_size;
+    uLongf written = expected;
+
+    if (input + compressed_size > size ||
+        uncompress(reinterpret_cast<Bytef*>(output.data() + i * block_size), &written,
+                   reinterpret_cast<const Bytef*>(data + input), compressed_size) != Z_OK || written != expected)
+      return false;
+
+    input += compressed_size;
+  }
+
+  return true;
+#else
+  (void) header;
+  (void) data;
+  (void) size;
+  (void) output;
+  return false;
+#endif
+}
+
+// Binary contents of an array, after removing the header and decompressing
+// it. Uncompressed raw appended data isn't copied, and 'data' points into the
+// file; otherwise it points to 'buffer'
+bool binaryData(const FileLayout& layout, const DataArray& array, std::vector<char>& buffer,
+                const char*& data, uint64_t& size) {
+  size_t hs = layout.header_size;
+  std::vector<uint64_t> header;
+  buffer.clear();
+
+  if (array.format == "appended" && !layout.appended_base64) {
+    if (layout.appended_begin == NULL || array.offset > (uint64_t) (layout.appended_end - layout.appended_begin))
+      return false;
+
+    const char* p = layout.appended_begin + array.offset;
+    uint64_t available = layout.appended_end - p;
+
+    if (!layout.compressed) {
+      if (available < hs)
+        return false;
+
+      readHeader(p, 1, hs, layout.swap, header);
+      if (header[0] > available - hs)
+        return false;
+
+      data = p + hs;
+      size = header[0];
+      return true;
+    }
+
+    if (available < 3 * hs)
+      return false;
+    readHeader(p, 1, hs, layout.swap, header);
+
+    uint64_t header_bytes = (3 + header[0]) * hs;
+    if (header_bytes > available)
+      return false;
+    readHeader(p, 3 + header[0], hs, layout.swap, header);
+
+    if (!decompress(header, p + header_bytes, available - header_bytes, buffer))
+      return false;
+
+    data = buffer.data();
+    size = buffer.size();
+    return true;
+  }
+
+  // Base64 data, either inline or appended
+  const char* begin;
+  const char* end;
+
+  if (array.format == "binary") {
+    begin = array.payload_begin;
+    end = array.payload_end;
+  }
+  else if (array.format == "appended" && layout.appended_begin != NULL &&
+           array.offset <= (uint64_t) (layout.appended_end - layout.appended_begin)) {
+    begin = layout.appended_begin + array.offset;
+    end = layout.appended_end;
+  }
+  else
+    return false;
+
+  if (!layout.compressed) {
+    // The header is encoded together with the data
+    std::vector<char> prefix;
+    if (decodeBase64(begin, end, base64Chars(hs), prefix) == NULL || prefix.size() < hs)
+      return false;
+
+    readHeader(prefix.data(), 1, hs, layout.swap, header);
+    if (decodeBase64(begin, end, base64Chars(hs + header[0]), buffer) == NULL || buffer.size() < hs + header[0])
+      return false;
+
+    data = buffer.data() + hs;
+    size = header[0];
+    return true;
+  }
+
+  // The header of compressed data is encoded on its own
+  std::vector<char> header_bytes;
+  if (decodeBase64(begin, end, base64Chars(3 * hs), header_bytes) == NULL)
+    return false;
+
+  readHeader(header_bytes.data(), 1, hs, layout.swap, header);
+  uint64_t header_size = (3 + header[0]) * hs;
+
+  header_bytes.clear();
+  const char* p = decodeBase64(begin, end, base64Chars(header_size), header_bytes);
+  if (p == NULL || header_bytes.size() < header_size)
+    return false;
+
+  readHeader(header_bytes.data(), 3 + header[0], hs, layout.swap, header);
+
+  uint64_t compressed_size = 0;
+  for (size_t i = 3; i < header.size(); ++i)
+    compressed_size += header[i];
+
+  std::vector<char> compressed;
+  if (decodeBase64(p, end, base64Chars(compressed_size), compressed) == NULL ||
+      !decompress(header, compressed.data(), compressed.size(), buffer))
+    return false;
+
+  data = buffer.data();
+  size = buffer.size();
+  return true;
+}
+
+// Value 'index' of binary data of type 'type', converted to T
+template <typename T>
+T binaryValue(const char* data, size_t index, ValueType type, bool swap) {
+  size_t size = valueSize(type);
+  char bytes[8];
+  std::memcpy(bytes, data + index * size, size);
+  if (swap)
+    swapBytes(bytes, size);
+
+  switch (type) {
+  case ValueType::INT8: { int8_t v; std::memcpy(&v, bytes, 1); return (T) v; }
+  case ValueType::UINT8: { uint8_t v; std::memcpy(&v, bytes, 1); return (T) v; }
+  case ValueType::INT16: { int16_t v; std::memcpy(&v, bytes, 2); return (T) v; }
+  case ValueType::UINT16: { uint16_t v; std::memcpy(&v, bytes, 2); return (T) v; }
+  case ValueType::INT32: { int32_t v; std::memcpy(&v, bytes, 4); return (T) v; }
+  case ValueType::UINT32: { uint32_t v; std::memcpy(&v, bytes, 4); return (T) v; }
+  case ValueType::INT64: { int64_t v; std::memcpy(&v, bytes, 8); return (T) v; }
+  case ValueType::UINT64: { uint64_t v; std::memcpy(&v, bytes, 8); return (T) v; }
+  case ValueType::FLOAT32: { float v; std::memcpy(&v, bytes, 4); return (T) v; }
+  default: { double v; std::memcpy(&v, bytes, 8); return (T) v; }
+  }
+}
+
+inline const char* parseValue(const char* begin, const char* end, double& value) {
+  return utils::parseDouble(begin, end, value);
+}
+
+inline const char* parseValue(const char* begin, const char* end, uint64_t& value) {
+  return utils::parseUnsigned(begin, end, value);
+}
+
+// Reads the 'count' values of an array, passing each one to 'output' with its
+// index. Values are converted to T, which is double or uint64_t
+template <typename T, typename Output>
+bool readArray(const FileLayout& layout, const DataArray& array, uint64_t count, Output output) {
+  if (array.format == "ascii") {
+    const char* p = array.payload_begin;
+
+    for (uint64_t i = 0; i < count; ++i) {
+      T value;
+      p = parseValue(p, array.payload_end, value);
+      if (p == NULL)
+        return false;
+
+      output(i, value);
+    }
+
+    return utils::skipSpaces(p, array.payload_end) == array.payload_end;
+  }
+
+  std::vector<char> buffer;
+  const char* data;
+  uint64_t size;
+
+  if (!binaryData(layout, array, buffer, data, size) || size != count * valueSize(array.type))
+    return false;
+
+  for (uint64_t i = 0; i < count; ++i)
+    output(i, binaryValue<T>(data, i, array.type, layout.swap));
+
+  return true;
+}
+
+// Signed integer arrays are read as uint64_t, so negative values become huge
+// and are rejected by the range checks
+bool parseMesh(const char* data, size_t size, std::vector<Point3>& nodes, std::vector<IndexTriangle>& triangles) {
+  FileLayout layout;
+  if (!readLayout(data, data + size, layout))
+    return false;
+
+  uint64_t total_nodes = layout.total_nodes, total_cells = layout.total_cells;
+  if (!IndexTriangle::canIndex(total_nodes))
+    return false;
+
+  nodes.assign(total_nodes, Point3());
+  triangles.assign(total_cells, IndexTriangle(0, 0, 0));
+
+  bool valid_points = readArray<double>(layout, layout.points, 3 * total_nodes, [&nodes](uint64_t i, double value) {
+    Point3& node = nodes[i / 3];
+    switch (i % 3) {
+    case 0: node.setX(value); break;
+    case 1: node.setY(value); break;
+    default: node.setZ(value); break;
+    }
+  });
+
+  if (!valid_points)
+    return false;
+
+  // Every cell must be a triangle, so the connectivity has 3 indices per cell
+  bool valid_indices = true;
+  bool valid_connectivity = readArray<uint64_t>(layout, layout.connectivity, 3 * total_cells,
+                                                [&](uint64_t i, uint64_t value) {
+    if (value >= total_nodes) {
+      valid_indices = false;
+      return;
+    }
+
+    IndexTriangle& triangle = triangles[i / 3];
+    switch (i % 3) {
+    case 0: triangle.setI(value); break;
+    case 1: triangle.setJ(value); break;
+    default: triangle.setK(value); break;
+    }
+  });
+
+  if (!valid_connectivity || !valid_indices)
+    return false;
+
+  bool valid_cells = true;
+
+  if (layout.offsets.found &&
+      !readArray<uint64_t>(layout, layout.offsets, total_cells, [&valid_cells](uint64_t i, uint64_t value) {
+        valid_cells = valid_cells && value == 3 * (i + 1);
+      }))
+    return false;
+
+  // VTK_TRIANGLE
+  if (layout.types.found &&
+      !readArray<uint64_t>(layout, layout.types, total_cells, [&valid_cells](uint64_t, uint64_t value) {
+        valid_cells = valid_cells && value == 5;
+      }))
+    return false;
+
+  return valid_cells;
+}
+
+} // anonymous namespace
+
+std::ostream& VTUMeshFormatter::writeMesh(std::ostream& os, const Mesh& mesh) const {
+  VTUMeshSink sink(os, m_encoding, m_compressed);
+  sink.setThreads(m_threads);
+  sink.writeMesh(mesh);
 
   return os;
 }
 
 std::istream& VTUMeshFormatter::readMesh(std::istream& is, Mesh& mesh) const {
-  // Not implemented
-  is.setstate(std::ios::failbit);
+  // The whole stream is read at once, and parsed in memory the same way as a
+  // mapped file
+  std::vector<char> data;
+  char chunk[65536];
+
+  while (is.read(chunk, sizeof(chunk)) || is.gcount() > 0)
+    data.insert(data.end(), chunk, chunk + is.gcount());
+
+  is.clear(std::ios::eofbit);
+
+  if (!readMesh(data.data(), data.size(), mesh))
+    is.setstate(std::ios::failbit);
+
   return is;
 }
+
+bool VTUMeshFormatter::readMeshFile(const std::string& file_name, Mesh& mesh) const {
+  MappedFile file(file_name);
+  return file.valid() && readMesh(file.data(), file.size(), mesh);
+}
+
+bool VTUMeshFormatter::readMesh(const char* data, size_t size, Mesh& mesh) {
+  std::vector<Point3> nodes;
+  std::vector<IndexTriangle> triangles;
+
+  if (!parseMesh(data, size, nodes, triangles))
+    return false;
+
+  mesh.setMesh(std::move(nodes), std::move(triangles));
+  return true;
+}
@@ -0,0 +1,476 @@
+#include "FlatMesher/VTUMeshSink.h"
+#include "FlatMesher/IndexTriangle.h"
+#include "FlatMesher/Point3.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#ifdef FLATMESHER_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace flat;
+
+namespace {
+
+const char BASE64_DIGITS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Binary arrays are written in the byte order of the machine, which is stated
+// in the header of the file
+const char* byteOrder() {
+  uint16_t value = 1;
+  unsigned char first;
+  std::memcpy(&first, &value, 1);
+
+  return first == 1? "LittleEndian" : "BigEndian";
+}
+
+// Writes 'count' triangles as integers of type T to 'output'
+template <typename T>
+void triangleIndices(const IndexTriangle* triangles, size_t count, std::vector<T>& output) {
+  output.resize(3 * count);
+
+  for (size_t i = 0; i < count; ++i) {
+    output[3 * i] = (T) triangles[i].getI();
+    output[3 * i + 1] = (T) triangles[i].getJ();
+    output[3 * i + 2] = (T) triangles[i].getK();
+  }
+}
+
+// Writes the offsets of the triangles from 'first' to 'first' + 'count' - 1 as
+// integers of type T to 'output'
+template <typename T>
+void triangleOffsets(size_t first, size_t count, std::vector<T>& output) {
+  output.resize(count);
+
+  for (size_t i = 0; i < count; ++i)
+    output[i] = (T) (3 * (first + i + 1));
+}
+
+} // anonymous namespace
+
+const size_t VTUMeshSink::COMPRESSION_BLOCK_SIZE;
+
+VTUMeshSink::VTUMeshSink(std::ostream& os, VTUEncoding encoding, bool compressed):
+  m_os(os), m_total_nodes(0), m_total_triangles(0), m_triangles_begun(false),
+  m_encoding(encoding), m_compressed(compressed && encoding != VTUEncoding::ASCII && compressionAvailable()),
+  m_index_bytes(4), m_offset_bytes(4), m_array(POINTS), m_array_bytes(0), m_base64_carry_sz(0), m_text(os) {}
+
+bool VTUMeshSink::compressionAvailable() {
+#ifdef FLATMESHER_ZLIB
+  return true;
+#else
+  return false;
+#endif
+}
+
+void VTUMeshSink::onBegin(size_t total_nodes, size_t total_triangles) {
+  m_total_nodes = total_nodes;
+  m_total_triangles = total_triangles;
+  m_triangles_begun = false;
+
+  if (m_encoding == VTUEncoding::ASCII) {
+    m_text << "<?xml version=\"1.0\"?>\n"
+           << "<VTKFile type=\"UnstructuredGrid\" version=\"0.1\">\n"
+           << "  <UnstructuredGrid>\n"
+           << "    <Piece NumberOfPoints=\"" << total_nodes << "\" NumberOfCells=\"" << total_triangles << "\">\n"
+           << "      <Points>\n"
+           << "        <DataArray type=\"Float32\" Name=\"points\" NumberOfComponents=\"3\" format=\"ascii\">\n";
+    return;
+  }
+
+  // 32-bit integers are used whenever they are enough
+  m_index_bytes = total_nodes <= (size_t) std::numeric_limits<int32_t>::max()? 4 : 8;
+  m_offset_bytes = 3 * total_triangles <= (size_t) std::numeric_limits<int32_t>::max()? 4 : 8;
+
+  if (m_encoding == VTUEncoding::BASE64) {
+    writeHeader();
+    writeDataArray(POINTS, 0);
+  }
+  else if (!m_compressed) {
+    // The size of every uncompressed array is already known, so the appended
+    // data can start right away
+    uint64_t offsets[TOTAL_ARRAYS];
+    offsets[0] = 0;
+    for (int i = 1; i < TOTAL_ARRAYS; ++i)
+      offsets[i] = offsets[i - 1] + sizeof(uint64_t) + arrayBytes(Array(i - 1));
+
+    writeAppendedXML(offsets);
+  }
+
+  beginArray(POINTS);
+}
+
+void VTUMeshSink::onNodes(const Point3* nodes, size_t count) {
+  if (m_encoding == VTUEncoding::ASCII) {
+    m_text.writeParallel(count, m_threads, [nodes](TextWriter& text, size_t first, size_t last) {
+      for (size_t i = first; i < last; ++i)
+        text << "          " << nodes[i] << '\n';
+    });
+    return;
+  }
+
+  std::vector<double> coordinates(3 * count);
+  for (size_t i = 0; i < count; ++i) {
+    coordinates[3 * i] = nodes[i].getX();
+    coordinates[3 * i + 1] = nodes[i].getY();
+    coordinates[3 * i + 2] = nodes[i].getZ();
+  }
+
+  writeArray(coordinates.data(), coordinates.size() * sizeof(double));
+}
+
+void VTUMeshSink::onTriangles(const IndexTriangle* triangles, size_t count) {
+  beginTriangles();
+
+  if (m_encoding == VTUEncoding::ASCII) {
+    m_text.writeParallel(count, m_threads, [triangles](TextWriter& text, size_t first, size_t last) {
+      for (size_t i = first; i < last; ++i)
+        text << "          " << triangles[i] << '\n';
+    });
+    return;
+  }
+
+  if (m_index_bytes == 4) {
+    std::vector<int32_t> indices;
+    triangleIndices(triangles, count, indices);
+    writeArray(indices.data(), indices.size() * sizeof(int32_t));
+  }
+  else {
+    std::vector<int64_t> indices;
+    triangleIndices(triangles, count, indices);
+    writeArray(indices.data(), indices.size() * sizeof(int64_t));
+  }
+}
+
+void VTUMeshSink::onEnd() {
+  beginTriangles();
+
+  if (m_encoding == VTUEncoding::ASCII) {
+    // Offsets and types only depend on the amount of triangles, so they don't
+    // need the triangles to be kept
+    m_text << "        </DataArray>\n"
+           << "        <DataArray type=\"Int32\" Name=\"offsets\" format=\"ascii\">\n";
+
+    m_text.writeParallel(m_total_triangles, m_threads, [](TextWriter& text, size_t first, size_t last) {
+      for (size_t i = first + 1; i <= last; ++i)
+        text << "          " << 3 * i << '\n';
+    });
+
+    m_text << "        </DataArray>\n"
+           << "        <DataArray type=\"UInt8\" Name=\"types\" format=\"ascii\">\n";
+
+    for (size_t i = 0; i < m_total_triangles; ++i)
+      m_text << "          5\n";
+
+    m_text << "        </DataArray>\n"
+           << "      </Cells>\n"
+           << "    </Piece>\n"
+           << "  </UnstructuredGrid>\n"
+           << "</VTKFile>\n";
+
+    m_text.flush();
+    return;
+  }
+
+  endArray();
+
+  if (m_encoding == VTUEncoding::BASE64) {
+    m_os << "\n        </DataArray>\n";
+    writeDataArray(OFFSETS, 0);
+  }
+
+  beginArray(OFFSETS);
+  writeOffsets();
+  endArray();
+
+  if (m_encoding == VTUEncoding::BASE64) {
+    m_os << "\n        </DataArray>\n";
+    writeDataArray(TYPES, 0);
+  }
+
+  beginArray(TYPES);
+  writeTypes();
+  endArray();
+
+  if (m_encoding == VTUEncoding::BASE64) {
+    m_os << "\n        </DataArray>\n"
+         << "      </Cells>\n"
+         << "    </Piece>\n"
+         << "  </UnstructuredGrid>\n"
+         << "</VTKFile>\n";
+  }
+  else {
+    // Compressed arrays are only written now that their sizes are known
+    if (m_compressed) {
+      uint64_t offsets[TOTAL_ARRAYS];
+      offsets[0] = 0;
+      for (int i = 1; i < TOTAL_ARRAYS; ++i)
+        offsets[i] = offsets[i - 1] + m_appended[i - 1].size();
+
+      writeAppendedXML(offsets);
+      for (int i = 0; i < TOTAL_ARRAYS; ++i) {
+        m_os.write(m_appended[i].data(), m_appended[i].size());
+        std::string().swap(m_appended[i]);
+      }
+    }
+
+    m_os << "\n  </AppendedData>\n"
+         << "</VTKFile>\n";
+  }
+}
+
+void VTUMeshSink::beginTriangles() {
+  if (m_triangles_begun)
+    return;
+
+  m_triangles_begun = true;
+
+  if (m_encoding == VTUEncoding::ASCII) {
+    m_text << "        </DataArray>\n"
+           << "      </Points>\n"
+           << "      <Cells>\n"
+           << "        <DataArray type=\"Int32\" Name=\"connectivity\" format=\"ascii\">\n";
+    return;
+  }
+
+  endArray();
+
+  if (m_encoding == VTUEncoding::BASE64) {
+    m_os << "\n        </DataArray>\n"
+         << "      </Points>\n"
+         << "      <Cells>\n";
+    writeDataArray(CONNECTIVITY, 0);
+  }
+
+  beginArray(CONNECTIVITY);
+}
+
+void VTUMeshSink::writeHeader() {
+  m_os << "<?xml version=\"1.0\"?>\n"
+       << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"" << byteOrder()
+       << "\" header_type=\"UInt64\"" << (m_compressed? " compressor=\"vtkZLibDataCompressor\"" : "") << ">\n"
+       << "  <UnstructuredGrid>\n"
+       << "    <Piece NumberOfPoints=\"" << m_total_nodes << "\" NumberOfCells=\"" << m_total_triangles << "\">\n"
+       << "      <Points>\n";
+}
+
+void VTUMeshSink::writeDataArray(Array array, uint64_t offset) {
+  static const char* const NAMES[TOTAL_ARRAYS] = {"points", "connectivity", "offsets", "types"};
+
+  const char* type = "UInt8";
+  if (array == POINTS)
+    type = "Float64";
+  else if (array == CONNECTIVITY)
+    type = m_index_bytes == 4? "Int32" : "Int64";
+  else if (array == OFFSETS)
+    type = m_offset_bytes == 4? "Int32" : "Int64";
+
+  m_os << "        <DataArray type=\"" << type << "\" Name=\"" << NAMES[array] << '"'
+       << (array == POINTS? " NumberOfComponents=\"3\"" : "");
+
+  if (m_encoding == VTUEncoding::BASE64)
+    m_os << " format=\"binary\">\n          ";
+  else
+    m_os << " format=\"appended\" offset=\"" << offset << "\"/>\n";
+}
+
+void VTUMeshSink::writeAppendedXML(const uint64_t* offsets) {
+  writeHeader();
+  writeDataArray(POINTS, offsets[POINTS]);
+
+  m_os << "      </Points>\n"
+       << "      <Cells>\n";
+
+  writeDataArray(CONNECTIVITY, offsets[CONNECTIVITY]);
+  writeDataArray(OFFSETS, offsets[OFFSETS]);
+  writeDataArray(TYPES, offsets[TYPES]);
+
+  m_os << "      </Cells>\n"
+       << "    </Piece>\n"
+       << "  </UnstructuredGrid>\n"
+       << "  <AppendedData encoding=\"raw\">\n"
+       << "   _";
+}
+
+uint64_t VTUMeshSink::arrayBytes(Array array) const {
+  switch (array) {
+  case POINTS:
+    return (uint64_t) m_total_nodes * 3 * sizeof(double);
+  case CONNECTIVITY:
+    return (uint64_t) m_total_triangles * 3 * m_index_bytes;
+  case OFFSETS:
+    return (uint64_t) m_total_triangles * m_offset_bytes;
+  default:
+    return m_total_triangles;
+  }
+}
+
+void VTUMeshSink::beginArray(Array array) {
+  m_array = array;
+  m_array_bytes = 0;
+  m_block.clear();
+  m_compressed_data.clear();
+  m_block_sizes.clear();
+  m_base64_carry_sz = 0;
+
+  // Uncompressed arrays start with their size, encoded together with the data
+  if (!m_compressed) {
+    uint64_t header = arrayBytes(array);
+    emit(&header, sizeof(header));
+  }
+}
+
+void VTUMeshSink::writeArray(const void* data, size_t bytes) {
+  m_array_bytes += bytes;
+
+  if (!m_compressed) {
+    emit(data, bytes);
+    return;
+  }
+
+  const char* input = static_cast<const char*>(data);
+  while (bytes > 0) {
+    size_t taken = std::min(bytes, COMPRESSION_BLOCK_SIZE - m_block.size());
+    m_block.insert(m_block.end(), input, input + taken);
+
+    input += taken;
+    bytes -= taken;
+
+    if (m_block.size() == COMPRESSION_BLOCK_SIZE)
+      compressBlock();
+  }
+}
+
+void VTUMeshSink::endArray() {
+  if (!m_compressed) {
+    if (m_encoding == VTUEncoding::BASE64)
+      encodeBase64(NULL, 0, true);
+    return;
+  }
+
+  if (!m_block.empty())
+    compressBlock();
+
+  // Header of vtkZLibDataCompressor: amount of blocks, size of the blocks, size
+  // of the last block if it's partial, and the compressed size of each block
+  std::vector<uint64_t> header;
+  header.push_back(m_block_sizes.size());
+  header.push_back(COMPRESSION_BLOCK_SIZE);
+  header.push_back(m_array_bytes % COMPRESSION_BLOCK_SIZE);
+  header.insert(header.end(), m_block_sizes.begin(), m_block_sizes.end());
+
+  // Compressed base64 data has the header encoded on its own
+  if (m_encoding == VTUEncoding::BASE64) {
+    encodeBase64(header.data(), header.size() * sizeof(uint64_t), true);
+    encodeBase64(m_compressed_data.data(), m_compressed_data.size(), true);
+  }
+  else {
+    std::string& output = m_appended[m_array];
+    output.assign(reinterpret_cast<const char*>(header.data()), header.size() * sizeof(uint64_t));
+    output.append(m_compressed_data.data(), m_compressed_data.size());
+  }
+
+  std::vector<char>().swap(m_compressed_data);
+}
+
+void VTUMeshSink::writeOffsets() {
+  for (size_t i = 0; i < m_total_triangles; i += CHUNK_SIZE) {
+    size_t count = std::min(m_total_triangles - i, CHUNK_SIZE);
+
+    if (m_offset_bytes == 4) {
+      std::vector<int32_t> offsets;
+      triangleOffsets(i, count, offsets);
+      writeArray(offsets.data(), offsets.size() * sizeof(int32_t));
+    }
+    else {
+      std::vector<int64_t> offsets;
+      triangleOffsets(i, count, offsets);
+      writeArray(offsets.data(), offsets.size() * sizeof(int64_t));
+    }
+  }
+}
+
+void VTUMeshSink::writeTypes() {
+  // Every cell is a VTK_TRIANGLE
+  std::vector<uint8_t> types(std::min(m_total_triangles, CHUNK_SIZE), 5);
+
+  for (size_t i = 0; i < m_total_triangles; i += CHUNK_SIZE)
+    writeArray(types.data(), std::min(m_total_triangles - i, CHUNK_SIZE));
+}
+
+void VTUMeshSink::compressBlock() {
+#ifdef FLATMESHER_ZLIB
+  // The fastest level compresses the arrays of a mesh almost as much as the
+  // default one, in a fraction of the time
+  size_t first = m_compressed_data.size();
+  uLongf compressed_sz = compressBound(m_block.size());
+
+  m_compressed_data.resize(first + compressed_sz);
+  compress2(reinterpret_cast<Bytef*>(m_compressed_data.data() + first), &compressed_sz,
+            reinterpret_cast<const Bytef*>(m_block.data()), m_block.size(), Z_BEST_SPEED);
+
+  m_compressed_data.resize(first + compressed_sz);
+  m_block_sizes.push_back(compressed_sz);
+#endif
+
+  m_block.clear();
+}
+
+void VTUMeshSink::emit(const void* data, size_t bytes) {
+  if (m_encoding == VTUEncoding::BASE64)
+    encodeBase64(data, bytes, false);
+  else
+    m_os.write(static_cast<const char*>(data), bytes);
+}
+
+void VTUMeshSink::encodeBase64(const void* data, size_t bytes, bool flush) {
+  const unsigned char* input = static_cast<const unsigned char*>(data);
+  std::string output;
+  output.reserve((m_base64_carry_sz + bytes) / 3 * 4 + 4);
+
+  // Complete the group left by the previous call first
+  size_t i = 0;
+  while (m_base64_carry_sz > 0 && m_base64_carry_sz < 3 && i < bytes)
+    m_base64_carry[m_base64_carry_sz++] = input[i++];
+
+  unsigned char group[3];
+
+  for (;;) {
+    if (m_base64_carry_sz == 3) {
+      std::memcpy(group, m_base64_carry, 3);
+      m_base64_carry_sz = 0;
+    }
+    else if (m_base64_carry_sz == 0 && i + 3 <= bytes) {
+      std::memcpy(group, input + i, 3);
+      i += 3;
+    }
+    else
+      break;
+
+    output += BASE64_DIGITS[group[0] >> 2];
+    output += BASE64_DIGITS[((group[0] & 0x03) << 4) | (group[1] >> 4)];
+    output += BASE64_DIGITS[((group[1] & 0x0f) << 2) | (group[2] >> 6)];
+    output += BASE64_DIGITS[group[2] & 0x3f];
+  }
+
+  while (i < bytes)
+    m_base64_carry[m_base64_carry_sz++] = input[i++];
+
+  // The last bytes are padded with zeros and marked with '='
+  if (flush && m_base64_carry_sz > 0) {
+    size_t group_sz = m_base64_carry_sz;
+    std::memset(group, 0, 3);
+    std::memcpy(group, m_base64_carry, group_sz);
+
+    output += BASE64_DIGITS[group[0] >> 2];
+    output += BASE64_DIGITS[((group[0] & 0x03) << 4) | (group[1] >> 4)];
+    output += group_sz > 1? BASE64_DIGITS[((group[1] & 0x0f) << 2) | (group[2] >> 6)] : '=';
+    output += '=';
+
+    m_base64_carry_sz = 0;
+  }
+
+  m_os.write(output.data(), output.size());
+}